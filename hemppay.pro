@@ -59,7 +59,27 @@ SOURCES += \
     src/recurring.cpp \
     src/requestdialog.cpp \
     src/memoedit.cpp \
-    src/viewalladdresses.cpp
+    src/viewalladdresses.cpp \
+    src/txexporter.cpp \
+    src/txstore.cpp \
+    src/addressregistry.cpp \
+    src/amount.cpp \
+    src/displayformat.cpp \
+    src/recordlog.cpp \
+    src/walletstore.cpp \
+    src/walletstate.cpp \
+    src/trace.cpp \
+    src/stallwatchdog.cpp \
+    src/walletsnapshot.cpp \
+    src/walletdiff.cpp \
+    src/addresslistmodel.cpp \
+    src/labelcompleter.cpp \
+    src/addressvalidator.cpp \
+    src/paymenturi.cpp \
+    src/qrsheet.cpp \
+    src/addresspool.cpp \
+    src/invoicestore.cpp \
+    src/payoutengine.cpp
 
 HEADERS += \
     src/mainwindow.h \
@@ -86,7 +106,27 @@ HEADERS += \
     src/recurring.h \
     src/requestdialog.h \
     src/memoedit.h \
-    src/viewalladdresses.h
+    src/viewalladdresses.h \
+    src/txexporter.h \
+    src/txstore.h \
+    src/addressregistry.h \
+    src/amount.h \
+    src/displayformat.h \
+    src/recordlog.h \
+    src/walletstore.h \
+    src/walletstate.h \
+    src/trace.h \
+    src/stallwatchdog.h \
+    src/walletsnapshot.h \
+    src/walletdiff.h \
+    src/addresslistmodel.h \
+    src/labelcompleter.h \
+    src/addressvalidator.h \
+    src/paymenturi.h \
+    src/qrsheet.h \
+    src/addresspool.h \
+    src/invoicestore.h \
+    src/payoutengine.h
 
 FORMS += \
     src/mainwindow.ui \
@@ -25,6 +25,7 @@
 #include <climits>
 #include <cstddef>
 #include <cstdlib>
+#include <initializer_list>
 #include <sstream>
 #include <stdexcept>
 #include <utility>
@@ -33,12 +34,94 @@
 
 using std::int8_t;
 using std::uint8_t;
+using std::uint64_t;
 using std::size_t;
 using std::vector;
 
 
 namespace qrcodegen {
 
+namespace {
+
+// Packed rows are at most 3 words, since the largest QR Code is 177 modules wide
+constexpr int MAX_ROW_WORDS = 3;
+
+// Rows of the eight mask patterns, as XOR patterns over a full 192-bit row. Every pattern
+// repeats itself every 12 rows (and columns), so 12 rows of each are enough for any size.
+// cols[m][x % 12] is the column x of mask m, with the module at y in bit y.
+struct MaskPatterns {
+	uint64_t rows[8][12][MAX_ROW_WORDS];
+	uint64_t cols[8][12][MAX_ROW_WORDS];
+	
+	MaskPatterns() :
+			rows(),
+			cols() {
+		for (int m = 0; m < 8; m++) {
+			for (int i = 0; i < 12; i++) {
+				for (int j = 0; j < MAX_ROW_WORDS * 64; j++) {
+					if (invert(m, j, i))
+						rows[m][i][j >> 6] |= uint64_t(1) << (j & 63);
+					if (invert(m, i, j))
+						cols[m][i][j >> 6] |= uint64_t(1) << (j & 63);
+				}
+			}
+		}
+	}
+	
+	static bool invert(int mask, int x, int y) {
+		switch (mask) {
+			case 0:  return (x + y) % 2 == 0;
+			case 1:  return y % 2 == 0;
+			case 2:  return x % 3 == 0;
+			case 3:  return (x + y) % 3 == 0;
+			case 4:  return (x / 3 + y / 2) % 2 == 0;
+			case 5:  return x * y % 2 + x * y % 3 == 0;
+			case 6:  return (x * y % 2 + x * y % 3) % 2 == 0;
+			case 7:  return ((x + y) % 2 + x * y % 3) % 2 == 0;
+			default:  throw std::logic_error("Assertion error");
+		}
+	}
+};
+
+const MaskPatterns &getMaskPatterns() {
+	static const MaskPatterns patterns;
+	return patterns;
+}
+
+int popcount(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// out = in shifted towards bit 0 by k (0 < k < 64), so that bit x of out is bit x + k of in
+void shiftDown(const uint64_t *in, uint64_t *out, int words, int k) {
+	for (int i = 0; i < words; i++)
+		out[i] = (in[i] >> k) | (i + 1 < words ? in[i + 1] << (64 - k) : 0);
+}
+
+// out = in shifted away from bit 0 by one, so that bit x of out is bit x - 1 of in
+void shiftUpOne(const uint64_t *in, uint64_t *out, int words) {
+	for (int i = 0; i < words; i++)
+		out[i] = (in[i] << 1) | (i > 0 ? in[i - 1] >> 63 : 0);
+}
+
+// Word i of a row with just the bits below n set
+uint64_t bitsBelow(int n, int i) {
+	if (n <= i * 64)
+		return 0;
+	if (n >= (i + 1) * 64)
+		return ~uint64_t(0);
+	return (uint64_t(1) << (n - i * 64)) - 1;
+}
+
+}
+
 int QrCode::getFormatBits(Ecc ecl) {
 	switch (ecl) {
 		case Ecc::LOW     :  return 1;
@@ -128,8 +211,17 @@ QrCode::QrCode(int ver, Ecc ecl, const vector<uint8_t> &dataCodewords, int mask)
 	if (mask < -1 || mask > 7)
 		throw std::domain_error("Mask value out of range");
 	size = ver * 4 + 17;
-	modules    = vector<vector<bool> >(size, vector<bool>(size));  // Initially all white
-	isFunction = vector<vector<bool> >(size, vector<bool>(size));
+	rowWords = (size + 63) / 64;
+	modules     = vector<uint64_t>(size * rowWords);  // Initially all white
+	modulesT    = vector<uint64_t>(size * rowWords);
+	isFunction  = vector<uint64_t>(size * rowWords);
+	isFunctionT = vector<uint64_t>(size * rowWords);
+	
+	// The unused bits at the end of each row count as function modules, so masking never touches them
+	for (int i = 0; i < size; i++) {
+		isFunction .at((i + 1) * rowWords - 1) = ~bitsBelow(size, rowWords - 1);
+		isFunctionT.at((i + 1) * rowWords - 1) = ~bitsBelow(size, rowWords - 1);
+	}
 	
 	// Compute ECC, draw modules, do masking
 	drawFunctionPatterns();
@@ -138,6 +230,10 @@ QrCode::QrCode(int ver, Ecc ecl, const vector<uint8_t> &dataCodewords, int mask)
 	this->mask = handleConstructorMasking(mask);
 	isFunction.clear();
 	isFunction.shrink_to_fit();
+	isFunctionT.clear();
+	isFunctionT.shrink_to_fit();
+	modulesT.clear();
+	modulesT.shrink_to_fit();
 }
 
 
@@ -295,13 +391,24 @@ void QrCode::drawAlignmentPattern(int x, int y) {
 
 
 void QrCode::setFunctionModule(int x, int y, bool isBlack) {
-	modules.at(y).at(x) = isBlack;
-	isFunction.at(y).at(x) = true;
+	setModule(x, y, isBlack);
+	isFunction .at(y * rowWords + (x >> 6)) |= uint64_t(1) << (x & 63);
+	isFunctionT.at(x * rowWords + (y >> 6)) |= uint64_t(1) << (y & 63);
 }
 
 
 bool QrCode::module(int x, int y) const {
-	return modules.at(y).at(x);
+	return ((modules[y * rowWords + (x >> 6)] >> (x & 63)) & 1) != 0;
+}
+
+
+void QrCode::setModule(int x, int y, bool isBlack) {
+	uint64_t &word  = modules .at(y * rowWords + (x >> 6));
+	uint64_t &wordT = modulesT.at(x * rowWords + (y >> 6));
+	uint64_t bit  = uint64_t(1) << (x & 63);
+	uint64_t bitT = uint64_t(1) << (y & 63);
+	word  = isBlack ? (word  | bit ) : (word  & ~bit );
+	wordT = isBlack ? (wordT | bitT) : (wordT & ~bitT);
 }
 
 
@@ -358,8 +465,9 @@ void QrCode::drawCodewords(const vector<uint8_t> &data) {
 				int x = right - j;  // Actual x coordinate
 				bool upward = ((right + 1) & 2) == 0;
 				int y = upward ? size - 1 - vert : vert;  // Actual y coordinate
-				if (!isFunction.at(y).at(x) && i < data.size() * 8) {
-					modules.at(y).at(x) = getBit(data.at(i >> 3), 7 - static_cast<int>(i & 7));
+				bool isFunc = ((isFunction.at(y * rowWords + (x >> 6)) >> (x & 63)) & 1) != 0;
+				if (!isFunc && i < data.size() * 8) {
+					setModule(x, y, getBit(data.at(i >> 3), 7 - static_cast<int>(i & 7)));
 					i++;
 				}
 				// If this QR Code has any remainder bits (0 to 7), they were assigned as
@@ -375,22 +483,18 @@ void QrCode::drawCodewords(const vector<uint8_t> &data) {
 void QrCode::applyMask(int mask) {
 	if (mask < 0 || mask > 7)
 		throw std::domain_error("Mask value out of range");
+	const MaskPatterns &patterns = getMaskPatterns();
+	
+	// XOR whole words of the pattern into the rows and the columns, except over function modules
 	for (int y = 0; y < size; y++) {
-		for (int x = 0; x < size; x++) {
-			bool invert;
-			switch (mask) {
-				case 0:  invert = (x + y) % 2 == 0;                    break;
-				case 1:  invert = y % 2 == 0;                          break;
-				case 2:  invert = x % 3 == 0;                          break;
-				case 3:  invert = (x + y) % 3 == 0;                    break;
-				case 4:  invert = (x / 3 + y / 2) % 2 == 0;            break;
-				case 5:  invert = x * y % 2 + x * y % 3 == 0;          break;
-				case 6:  invert = (x * y % 2 + x * y % 3) % 2 == 0;    break;
-				case 7:  invert = ((x + y) % 2 + x * y % 3) % 2 == 0;  break;
-				default:  throw std::logic_error("Assertion error");
-			}
-			modules.at(y).at(x) = modules.at(y).at(x) ^ (invert & !isFunction.at(y).at(x));
-		}
+		const uint64_t *pattern = patterns.rows[mask][y % 12];
+		for (int i = 0; i < rowWords; i++)
+			modules[y * rowWords + i] ^= pattern[i] & ~isFunction[y * rowWords + i];
+	}
+	for (int x = 0; x < size; x++) {
+		const uint64_t *pattern = patterns.cols[mask][x % 12];
+		for (int i = 0; i < rowWords; i++)
+			modulesT[x * rowWords + i] ^= pattern[i] & ~isFunctionT[x * rowWords + i];
 	}
 }
 
@@ -420,75 +524,33 @@ int QrCode::handleConstructorMasking(int mask) {
 long QrCode::getPenaltyScore() const {
 	long result = 0;
 	
-	// Adjacent modules in row having same color
-	for (int y = 0; y < size; y++) {
-		bool colorX = false;
-		for (int x = 0, runX = -1; x < size; x++) {
-			if (x == 0 || module(x, y) != colorX) {
-				colorX = module(x, y);
-				runX = 1;
-			} else {
-				runX++;
-				if (runX == 5)
-					result += PENALTY_N1;
-				else if (runX > 5)
-					result++;
-			}
-		}
-	}
-	// Adjacent modules in column having same color
-	for (int x = 0; x < size; x++) {
-		bool colorY = false;
-		for (int y = 0, runY = -1; y < size; y++) {
-			if (y == 0 || module(x, y) != colorY) {
-				colorY = module(x, y);
-				runY = 1;
-			} else {
-				runY++;
-				if (runY == 5)
-					result += PENALTY_N1;
-				else if (runY > 5)
-					result++;
-			}
-		}
-	}
+	// Adjacent modules in row having same color, and finder-like pattern in rows
+	for (int y = 0; y < size; y++)
+		result += getLinePenalty(&modules[y * rowWords]);
+	// Adjacent modules in column having same color, and finder-like pattern in columns
+	for (int x = 0; x < size; x++)
+		result += getLinePenalty(&modulesT[x * rowWords]);
 	
-	// 2*2 blocks of modules having same color
+	// 2*2 blocks of modules having same color. Bit x of same is set when the modules at x
+	// in both rows match, and bit x of sameX when the modules at x and x + 1 of the top row do.
 	for (int y = 0; y < size - 1; y++) {
-		for (int x = 0; x < size - 1; x++) {
-			bool  color = module(x, y);
-			if (  color == module(x + 1, y) &&
-			      color == module(x, y + 1) &&
-			      color == module(x + 1, y + 1))
-				result += PENALTY_N2;
-		}
-	}
-	
-	// Finder-like pattern in rows
-	for (int y = 0; y < size; y++) {
-		for (int x = 0, bits = 0; x < size; x++) {
-			bits = ((bits << 1) & 0x7FF) | (module(x, y) ? 1 : 0);
-			if (x >= 10 && (bits == 0x05D || bits == 0x5D0))  // Needs 11 bits accumulated
-				result += PENALTY_N3;
-		}
-	}
-	// Finder-like pattern in columns
-	for (int x = 0; x < size; x++) {
-		for (int y = 0, bits = 0; y < size; y++) {
-			bits = ((bits << 1) & 0x7FF) | (module(x, y) ? 1 : 0);
-			if (y >= 10 && (bits == 0x05D || bits == 0x5D0))  // Needs 11 bits accumulated
-				result += PENALTY_N3;
+		const uint64_t *top    = &modules[ y      * rowWords];
+		const uint64_t *bottom = &modules[(y + 1) * rowWords];
+		uint64_t same[MAX_ROW_WORDS], sameNext[MAX_ROW_WORDS], next[MAX_ROW_WORDS];
+		for (int i = 0; i < rowWords; i++)
+			same[i] = ~(top[i] ^ bottom[i]);
+		shiftDown(same, sameNext, rowWords, 1);
+		shiftDown(top, next, rowWords, 1);
+		for (int i = 0; i < rowWords; i++) {
+			uint64_t sameX = ~(top[i] ^ next[i]);
+			result += PENALTY_N2 * popcount(same[i] & sameNext[i] & sameX & bitsBelow(size - 1, i));
 		}
 	}
 	
 	// Balance of black and white modules
 	int black = 0;
-	for (const vector<bool> &row : modules) {
-		for (bool color : row) {
-			if (color)
-				black++;
-		}
-	}
+	for (uint64_t word : modules)
+		black += popcount(word);
 	int total = size * size;  // Note that size is odd, so black/total != 1/2
 	// Compute the smallest integer k >= 0 such that (45-5k)% <= black/total <= (55+5k)%
 	int k = static_cast<int>((std::abs(black * 20L - total * 10L) + total - 1) / total) - 1;
@@ -497,6 +559,46 @@ long QrCode::getPenaltyScore() const {
 }
 
 
+long QrCode::getLinePenalty(const uint64_t *line) const {
+	long result = 0;
+	
+	// shifted[k] has the module at x + k in bit x
+	uint64_t shifted[11][MAX_ROW_WORDS];
+	for (int i = 0; i < rowWords; i++)
+		shifted[0][i] = line[i];
+	for (int k = 1; k < 11; k++)
+		shiftDown(line, shifted[k], rowWords, k);
+	
+	// Bit x of same is set when the modules at x and x + 1 have the same color, and bit x of
+	// window when the modules at x to x + 4 all do. A run of n >= 5 modules has n - 4 windows,
+	// and scores PENALTY_N1 + (n - 5), which is its windows plus PENALTY_N1 - 1 once per run.
+	uint64_t same[MAX_ROW_WORDS], sameBefore[MAX_ROW_WORDS];
+	for (int i = 0; i < rowWords; i++)
+		same[i] = ~(shifted[0][i] ^ shifted[1][i]) & bitsBelow(size - 1, i);
+	shiftUpOne(same, sameBefore, rowWords);
+	
+	uint64_t sameNext[4][MAX_ROW_WORDS];
+	for (int k = 1; k < 4; k++)
+		shiftDown(same, sameNext[k], rowWords, k);
+	for (int i = 0; i < rowWords; i++) {
+		uint64_t window = same[i] & sameNext[1][i] & sameNext[2][i] & sameNext[3][i];
+		uint64_t runStart = window & ~sameBefore[i];
+		result += popcount(window) + (PENALTY_N1 - 1) * popcount(runStart);
+	}
+	
+	// Finder-like pattern: 11 modules matching 0x05D or 0x5D0, first module in the highest bit
+	for (int pattern : {0x05D, 0x5D0}) {
+		for (int i = 0; i < rowWords; i++) {
+			uint64_t match = bitsBelow(size - 10, i);
+			for (int k = 0; k < 11; k++)
+				match &= getBit(pattern, 10 - k) ? shifted[k][i] : ~shifted[k][i];
+			result += PENALTY_N3 * popcount(match);
+		}
+	}
+	return result;
+}
+
+
 vector<int> QrCode::getAlignmentPatternPositions() const {
 	if (version == 1)
 		return vector<int>();
@@ -126,14 +126,23 @@ class QrCode final {
 	 * the resulting object still has a mask value between 0 and 7. */
 	private: int mask;
 	
-	// Private grids of modules/pixels, with dimensions of size*size:
+	// Private grids of modules/pixels, with dimensions of size*size. Each row is packed into
+	// rowWords 64-bit words, with the module at x in bit (x % 64) of word (x / 64):
+	
+	// The number of 64-bit words in one packed row, between 1 and 3 (inclusive).
+	private: int rowWords;
 	
 	// The modules of this QR Code (false = white, true = black).
 	// Immutable after constructor finishes. Accessed through getModule().
-	private: std::vector<std::vector<bool> > modules;
+	private: std::vector<std::uint64_t> modules;
 	
 	// Indicates function modules that are not subjected to masking. Discarded when constructor finishes.
-	private: std::vector<std::vector<bool> > isFunction;
+	private: std::vector<std::uint64_t> isFunction;
+	
+	// The transposes of the two grids above, so that columns can be scored as packed rows too.
+	// Kept in step with them by the constructor, and discarded when it finishes.
+	private: std::vector<std::uint64_t> modulesT;
+	private: std::vector<std::uint64_t> isFunctionT;
 	
 	
 	
@@ -226,6 +235,11 @@ class QrCode final {
 	private: bool module(int x, int y) const;
 	
 	
+	// Sets the color of the module at the given coordinates, which must be in range,
+	// in both the row and the column grid. Only used by the constructor.
+	private: void setModule(int x, int y, bool isBlack);
+	
+	
 	/*---- Private helper methods for constructor: Codewords and masking ----*/
 	
 	// Returns a new byte string representing the given data with the appropriate error correction
@@ -254,9 +268,14 @@ class QrCode final {
 	
 	// Calculates and returns the penalty score based on state of this QR Code's current modules.
 	// This is used by the automatic mask choice algorithm to find the mask pattern that yields the lowest score.
+	// Every rule is evaluated a whole packed row at a time, with shifts, masks and popcounts.
 	private: long getPenaltyScore() const;
 	
 	
+	// The rule 1 and rule 3 penalties of one packed row (or column) of modules.
+	private: long getLinePenalty(const std::uint64_t *line) const;
+	
+	
 	
 	/*---- Private helper functions ----*/
 	
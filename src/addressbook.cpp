@@ -4,6 +4,7 @@
 #include "settings.h"
 #include "mainwindow.h"
 #include "rpc.h"
+#include "recordlog.h"
 
 
 AddressBookModel::AddressBookModel(QTableView *parent)
@@ -54,6 +55,12 @@ void AddressBookModel::removeItemAt(int row) {
     layoutChanged();
 }
 
+void AddressBookModel::reload() {
+    beginResetModel();
+    labels = AddressBook::getInstance()->getAllAddressLabels();
+    endResetModel();
+}
+
 QPair<QString, QString> AddressBookModel::itemAt(int row) {
     if (row >= labels.size()) return QPair<QString, QString>();
 
@@ -158,30 +165,32 @@ void AddressBook::open(MainWindow* parent, QLineEdit* target) {
         if (fileName.isEmpty())
             return;
 
-        QFile file(fileName.toLocalFile());
-        if (!file.open(QIODevice::ReadOnly)) {
-            QMessageBox::information(&d, QObject::tr("Unable to open file"), file.errorString());
+        QString error;
+        int numReplaced = 0;
+        int numImported = getInstance()->importCSV(fileName.toLocalFile(), error, &numReplaced);
+        if (numImported < 0) {
+            QMessageBox::information(&d, QObject::tr("Unable to open file"), error);
             return;
-        }        
-
-        QTextStream in(&file);
-        QString line;
-        int numImported = 0;
-        while (in.readLineInto(&line)) {
-            QStringList items = line.split(",");
-            if (items.size() != 2)
-                continue;
-
-            if (!Settings::isValidAddress(items.at(0)))
-                continue;
-
-            // Add label, address.
-            model.addNewLabel(items.at(1), items.at(0));
-            numImported++;
         }
+        model.reload();
 
         QMessageBox::information(&d, QObject::tr("Address Book Import Done"),
-            QObject::tr("Imported %1 new Address book entries").arg(numImported));
+            QObject::tr("Imported %1 new Address book entries, updated %2").arg(numImported).arg(numReplaced));
+    });
+
+    // Export Button
+    QObject::connect(ab.btnExport, &QPushButton::clicked, [&] () {
+        auto fileName = QFileDialog::getSaveFileName(&d, QObject::tr("Export Address Book"), 
+            "addressbook.csv", "CSV file (*.csv)");
+        if (fileName.isEmpty())
+            return;
+
+        QString error;
+        if (!getInstance()->exportCSV(fileName, error)) {
+            QMessageBox::critical(&d, QObject::tr("Error"), 
+                QObject::tr("Error exporting the address book to %1").arg(fileName) + "\n" + error, 
+                QMessageBox::Ok);
+        }
     });
 
     auto fnSetTargetLabelAddr = [=] (QLineEdit* target, QString label, QString addr) {
@@ -259,19 +268,61 @@ AddressBook::AddressBook() {
     readFromStorage();
 }
 
+// Labels are stored in the "addresslabels" wallet table, keyed by label.
 void AddressBook::readFromStorage() {
-    QFile file(AddressBook::writeableFile());
+    table = WalletStore::getInstance()->table(QStringLiteral("addresslabels"));
+
+    entries.clear();
+    labelOrder.clear();
+    addressLabels.clear();
+    allLabels.clear();
+
+    for (auto it = table->all().constBegin(); it != table->all().constEnd(); it++) {
+        QDataStream in(it.value());
+        qint64  order;
+        QString address;
+        in >> order >> address;
+        insertLabel(QString::fromUtf8(it.key()), address, order);
+    }
+
+    nextOrder = entries.isEmpty() ? 0 : entries.lastKey() + 1;
 
-    if (file.exists()) {
-        allLabels.clear();
-        file.open(QIODevice::ReadOnly);
+    // Labels saved by earlier versions, which rewrote the whole file on every change
+    // Only removed once they're safely in the table, or the table already has labels
+    QFile file(WalletStore::writeableFile(QStringLiteral("addresslabels.dat")));
+    if (file.exists() && !entries.isEmpty()) {
+        file.remove();
+    } else if (file.exists() && file.open(QIODevice::ReadOnly)) {
         QDataStream in(&file);    // read the data serialized from the file
         QString version;
-        in >> version >> allLabels; 
-
+        QList<QPair<QString, QString>> oldLabels;
+        in >> version >> oldLabels; 
+        bool readOk = in.status() == QDataStream::Ok;
         file.close();
+        if (!readOk)
+            oldLabels.clear();
+
+        table->beginBatch();
+        for (const auto& item : oldLabels) {
+            if (labelOrder.contains(item.first))
+                takeLabel(item.first);
+
+            insertLabel(item.first, item.second, nextOrder++);
+            saveLabel(item.first);
+        }
+        bool ok = table->commit();
+
+        if (readOk && ok && table->sync()) {
+            file.remove();
+        } else {
+            LOG_WARNING("Couldn't move the old address labels, will try again", {{"file", file.fileName()}});
+        }
     }
 
+    // Nothing to announce for an empty book, and getAllAddressLabels would read it in again
+    if (!entries.isEmpty())
+        emit labelsReset();
+
     // Special. 
     // Add the default ZecWallet donation address if it isn't already present
     // QList<QString> allAddresses;
@@ -282,94 +333,218 @@ void AddressBook::readFromStorage() {
     // }
 }
 
-void AddressBook::writeToStorage() {
-    QFile file(AddressBook::writeableFile());
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate);
-    QDataStream out(&file);   // we will serialize the data into the file
-    out << QString("v1") << allLabels;
-    file.close();
+void AddressBook::saveLabel(const QString& label) {
+    qint64 order = labelOrder.value(label);
+
+    QByteArray value;
+    QDataStream out(&value, QIODevice::WriteOnly);
+    out << order << entries.value(order).second;
+
+    table->put(label.toUtf8(), value);
 }
 
-QString AddressBook::writeableFile() {
-    auto filename = QStringLiteral("addresslabels.dat");
+void AddressBook::insertLabel(const QString& label, const QString& address, qint64 order) {
+    entries.insert(order, QPair<QString, QString>(label, address));
+    labelOrder.insert(label, order);
+    addressLabels[address].insert(order, label);
+    listDirty = true;
+}
 
-    auto dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
-    if (!dir.exists())
-        QDir().mkpath(dir.absolutePath());
+QPair<QString, QString> AddressBook::takeLabel(const QString& label) {
+    qint64 order = labelOrder.take(label);
+    auto item = entries.take(order);
 
-    if (Settings::getInstance()->isTestnet()) {
-        return dir.filePath("testnet-" % filename);
-    } else {
-        return dir.filePath(filename);
+    auto it = addressLabels.find(item.second);
+    if (it != addressLabels.end()) {
+        it->remove(order);
+        if (it->isEmpty())
+            addressLabels.erase(it);
     }
-}
 
+    table->remove(label.toUtf8());
+    listDirty = true;
+
+    return item;
+}
 
 // Add a new address/label to the database
 void AddressBook::addAddressLabel(QString label, QString address) {
     Q_ASSERT(Settings::isValidAddress(address));
 
-    // First, remove any existing label
-    // Iterate over the list and remove the label/address
-    for (int i=0; i < allLabels.size(); i++) {
-        if (allLabels[i].first == label) {
-            removeAddressLabel(allLabels[i].first, allLabels[i].second);
+    addAddressLabels({ QPair<QString, QString>(label, address) });
+}
+
+int AddressBook::addAddressLabels(const QList<QPair<QString, QString>>& labels, int* replaced) {
+    // If the same label is in the list more than once, the last one wins
+    QHash<QString, int> last;
+    last.reserve(labels.size());
+    for (int i = 0; i < labels.size(); i++)
+        last.insert(labels[i].first, i);
+
+    // A bulk add is announced as a single reset at the end, instead of one signal per label
+    bool bulk = labels.size() > 1;
+
+    table->beginBatch();
+
+    int added = 0;
+    int moved = 0;
+    for (int i = 0; i < labels.size(); i++) {
+        const auto& label = labels[i].first;
+        if (last.value(label) != i)
+            continue;
+
+        // A label that is already in use is moved to its new address, and to the end of the list
+        if (labelOrder.contains(label)) {
+            auto old = takeLabel(label);
+            moved++;
+            if (!bulk)
+                emit labelRemoved(old.first, old.second);
+        } else {
+            added++;
         }
+
+        insertLabel(label, labels[i].second, nextOrder++);
+        saveLabel(label);
+
+        if (!bulk)
+            emit labelAdded(label, labels[i].second);
     }
 
-    allLabels.push_back(QPair<QString, QString>(label, address));
-    writeToStorage();
+    // All of it goes to disk as one record
+    table->commit();
+
+    if (bulk)
+        emit labelsReset();
+
+    if (replaced)
+        *replaced = moved;
+
+    return added;
 }
 
 // Remove a new address/label from the database
 void AddressBook::removeAddressLabel(QString label, QString address) {
-    // Iterate over the list and remove the label/address
-    for (int i=0; i < allLabels.size(); i++) {
-        if (allLabels[i].first == label && allLabels[i].second == address) {
-            allLabels.removeAt(i);
-            writeToStorage();
-            return;
-        }
-    }
+    auto it = labelOrder.constFind(label);
+    if (it == labelOrder.constEnd() || entries.value(*it).second != address)
+        return;
+
+    takeLabel(label);
+
+    emit labelRemoved(label, address);
 }
 
 void AddressBook::updateLabel(QString oldlabel, QString address, QString newlabel) {
-    // Iterate over the list and update the label/address
-    for (int i = 0; i < allLabels.size(); i++) {
-        if (allLabels[i].first == oldlabel && allLabels[i].second == address) {
-            allLabels[i].first = newlabel;
-            writeToStorage();
-            return;
-        }
+    auto it = labelOrder.constFind(oldlabel);
+    if (it == labelOrder.constEnd() || entries.value(*it).second != address || oldlabel == newlabel)
+        return;
+
+    table->beginBatch();
+
+    // The new label can only be on one address, so it is taken off the one it was on
+    QPair<QString, QString> other;
+    if (labelOrder.contains(newlabel))
+        other = takeLabel(newlabel);
+
+    // Keep the label where it was in the list
+    qint64 order = labelOrder.take(oldlabel);
+    labelOrder.insert(newlabel, order);
+    entries[order].first = newlabel;
+    addressLabels[address][order] = newlabel;
+    listDirty = true;
+
+    table->remove(oldlabel.toUtf8());
+    saveLabel(newlabel);
+    table->commit();
+
+    if (!other.first.isEmpty())
+        emit labelRemoved(other.first, other.second);
+    emit labelRemoved(oldlabel, address);
+    emit labelAdded(newlabel, address);
+}
+
+int AddressBook::importCSV(const QString& fileName, QString& error, int* replaced) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        error = file.errorString();
+        return -1;
+    }
+
+    QRegExp validLabel(Settings::labelRegExp);
+    QList<QPair<QString, QString>> labels;
+
+    QTextStream in(&file);
+    QString line;
+    while (in.readLineInto(&line)) {
+        auto items = line.splitRef(",");
+        if (items.size() != 2)
+            continue;
+
+        auto addr  = items.at(0).trimmed().toString();
+        auto label = items.at(1).trimmed().toString();
+        if (label.isEmpty() || !validLabel.exactMatch(label) || !Settings::isValidAddress(addr))
+            continue;
+
+        labels.push_back(QPair<QString, QString>(label, addr));
     }
+
+    return addAddressLabels(labels, replaced);
+}
+
+bool AddressBook::exportCSV(const QString& fileName, QString& error) const {
+    // Written to a temp file that is renamed over the target, so a failed export leaves no half file
+    QString tmp = fileName % ".tmp";
+    QFile file(tmp);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QByteArray out;
+    out.reserve(entries.size() * 96);
+    for (const auto& item : entries) {
+        out.append(item.second.toUtf8()).append(',').append(item.first.toUtf8()).append('\n');
+    }
+
+    bool ok = file.write(out) == out.size() && RecordLog::syncToDisk(file);
+    if (!ok)
+        error = file.errorString();
+    file.close();
+
+    if (ok && !RecordLog::replaceFile(tmp, fileName)) {
+        error = QObject::tr("Couldn't replace %1").arg(fileName);
+        ok = false;
+    }
+
+    if (!ok)
+        QFile::remove(tmp);
+
+    return ok;
 }
 
 // Read all addresses
 const QList<QPair<QString, QString>>& AddressBook::getAllAddressLabels() {
-    if (allLabels.isEmpty()) {
+    if (entries.isEmpty()) {
         readFromStorage();
     }
+
+    // Edits only mark the list stale, so a run of them doesn't copy it each time
+    if (listDirty) {
+        allLabels = entries.values();
+        listDirty = false;
+    }
     return allLabels;
 }
 
 // Get the label for an address
-QString AddressBook::getLabelForAddress(QString addr) {
-    for (auto i : allLabels) {
-        if (i.second == addr)
-            return i.first;
-    }
-
-    return "";
+QString AddressBook::getLabelForAddress(const QString& addr) const {
+    auto it = addressLabels.constFind(addr);
+    return it != addressLabels.constEnd() ? it->first() : QString();
 }
 
 // Get the address for a label
-QString AddressBook::getAddressForLabel(QString label) {
-    for (auto i: allLabels) {
-        if (i.first == label)
-            return i.second;
-    }
-
-    return "";
+QString AddressBook::getAddressForLabel(const QString& label) const {
+    auto it = labelOrder.constFind(label);
+    return it != labelOrder.constEnd() ? entries.value(*it).second : QString();
 }
 
 QString AddressBook::addLabelToAddress(QString addr) {
@@ -2,6 +2,7 @@
 #define ADDRESSBOOK_H
 
 #include "precompiled.h"
+#include "walletstore.h"
 
 class MainWindow;
 
@@ -15,6 +16,9 @@ public:
     void                    removeItemAt(int row);
     QPair<QString, QString> itemAt(int row);
 
+    // Pick up changes made to the address book directly, eg. by an import
+    void                    reload();
+
     int      rowCount(const QModelIndex &parent) const;
     int      columnCount(const QModelIndex &parent) const;
     QVariant data(const QModelIndex &index, int role) const;
@@ -29,7 +33,8 @@ private:
     QStringList headers;    
 };
 
-class AddressBook {
+class AddressBook : public QObject {
+    Q_OBJECT
 public:    
     // Method that opens the AddressBook dialog window. 
     static void open(MainWindow* parent, QLineEdit* target = nullptr);
@@ -41,6 +46,10 @@ public:
     // Add a new address/label to the database
     void addAddressLabel(QString label, QString address);
 
+    // Add many address/labels at once, written out as a single batch. Returns how many new labels were
+    // added, and sets replaced to how many existing labels were moved to the given address.
+    int  addAddressLabels(const QList<QPair<QString, QString>>& labels, int* replaced = nullptr);
+
     // Remove a new address/label from the database
     void removeAddressLabel(QString label, QString address);
 
@@ -51,17 +60,48 @@ public:
     const QList<QPair<QString, QString>>& getAllAddressLabels();
 
     // Get an address's first label
-    QString getLabelForAddress(QString address);
+    QString getLabelForAddress(const QString& address) const;
     // Get a Label's address
-    QString getAddressForLabel(QString label);
+    QString getAddressForLabel(const QString& label) const;
+
+    // CSV files of "address,label" lines. Import skips lines that aren't a valid address and label,
+    // and returns the number of new labels, or -1 if the file couldn't be read. Labels that were already
+    // in the book are counted in replaced instead.
+    int  importCSV(const QString& fileName, QString& error, int* replaced = nullptr);
+    bool exportCSV(const QString& fileName, QString& error) const;
+
+signals:
+    // Sent for every single change, so views can update incrementally
+    void labelAdded(const QString& label, const QString& address);
+    void labelRemoved(const QString& label, const QString& address);
+
+    // The labels were read in again from storage, or changed in bulk
+    void labelsReset();
+
 private:
     AddressBook();
 
     void readFromStorage();
-    void writeToStorage();
+    void saveLabel(const QString& label);
+
+    // Add or take out one entry, keeping the indexes in step. Neither sends a signal.
+    void insertLabel(const QString& label, const QString& address, qint64 order);
+    QPair<QString, QString> takeLabel(const QString& label);
+
+    WalletTable* table = nullptr;
+
+    // Every label and its address, by the order it was added in, which is kept across restarts
+    QMap<qint64, QPair<QString, QString>> entries;
+    qint64 nextOrder = 0;
+
+    // Where each label is in entries, and each address's labels in order. Only keyed by order, so an
+    // edit touches just its own entries and never has to renumber the rest.
+    QHash<QString, qint64> labelOrder;
+    QHash<QString, QMap<qint64, QString>> addressLabels;
 
-    QString writeableFile();
+    // entries as a list, for getAllAddressLabels. Rebuilt there once it is stale.
     QList<QPair<QString, QString>> allLabels;
+    bool listDirty = false;
 
     static AddressBook* instance;
 };
@@ -1,22 +1,40 @@
 #include "addresscombo.h"
 #include "addressbook.h"
+#include "addresslistmodel.h"
 #include "settings.h"
 
 AddressCombo::AddressCombo(QWidget* parent) : 
     QComboBox(parent) {
 }
 
+AddressListModel* AddressCombo::addressModel() const {
+    return qobject_cast<AddressListModel*>(model());
+}
+
 QString AddressCombo::itemText(int i) {
+    if (auto m = addressModel())
+        return m->address(i);
+
     QString txt = QComboBox::itemText(i);
     return AddressBook::addressFromAddressLabel(txt.split("(")[0].trimmed());
 }
 
 QString AddressCombo::currentText() {
+    if (auto m = addressModel())
+        return m->address(currentIndex());
+
     QString txt = QComboBox::currentText();
     return AddressBook::addressFromAddressLabel(txt.split("(")[0].trimmed());
 }
 
 void AddressCombo::setCurrentText(const QString& text) {
+    if (auto m = addressModel()) {
+        int row = m->rowOf(text);
+        if (row >= 0)
+            QComboBox::setCurrentIndex(row);
+        return;
+    }
+
     for (int i=0; i < count(); i++) {
         if (itemText(i) == text) {
             QComboBox::setCurrentIndex(i);
@@ -24,15 +42,23 @@ void AddressCombo::setCurrentText(const QString& text) {
     }
 } 
 
-void AddressCombo::addItem(const QString& text, double bal) {
+// The shared address lists follow the wallet by themselves, and are used by other combos too, so nothing
+// is ever added to them through a combo
+void AddressCombo::addItem(const QString& text, Amount bal) {
+    if (addressModel() != nullptr)
+        return;
+
     QString txt = AddressBook::addLabelToAddress(text);
-    if (bal > 0)
+    if (bal.isPositive())
         txt = txt % "(" % Settings::getZECDisplayFormat(bal) % ")";
         
     QComboBox::addItem(txt);
 }
 
-void AddressCombo::insertItem(int index, const QString& text, double bal) {
+void AddressCombo::insertItem(int index, const QString& text, Amount bal) {
+    if (addressModel() != nullptr)
+        return;
+
     QString txt = AddressBook::addLabelToAddress(text) % 
                     "(" % Settings::getZECDisplayFormat(bal) % ")";
     QComboBox::insertItem(index, txt);
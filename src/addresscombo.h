@@ -2,6 +2,9 @@
 #define ADDRESSCOMBO_H
 
 #include "precompiled.h"
+#include "amount.h"
+
+class AddressListModel;
 
 class AddressCombo : public QComboBox 
 {
@@ -12,13 +15,15 @@ public:
     QString     itemText(int i);
     QString     currentText();
 
-    void        addItem(const QString& itemText, double bal);
-    void        insertItem(int index, const QString& text, double bal = 0.0);
+    void        addItem(const QString& itemText, Amount bal);
+    void        insertItem(int index, const QString& text, Amount bal = Amount());
 
 public slots:
     void setCurrentText(const QString& itemText);
 
 private:
+    // The shared address model, if the combo is showing one
+    AddressListModel* addressModel() const;
 };
 
 #endif // ADDRESSCOMBO_H
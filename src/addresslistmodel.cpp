@@ -0,0 +1,179 @@
+#include "addresslistmodel.h"
+#include "addressbook.h"
+#include "settings.h"
+#include "trace.h"
+
+AddressListModel* AddressListModel::instances[KindCount] = {};
+
+AddressListModel* AddressListModel::get(Kind kind) {
+    if (instances[kind] == nullptr)
+        instances[kind] = new AddressListModel(kind);
+
+    return instances[kind];
+}
+
+AddressListModel::AddressListModel(Kind k) : kind(k) {
+    reset(WalletSnapshots::getInstance()->current());
+
+    QObject::connect(WalletDiff::getInstance(), &WalletDiff::changed, this, &AddressListModel::applyChanges);
+}
+
+void AddressListModel::labelsChanged() {
+    for (auto model : instances) {
+        if (model == nullptr || model->rows.isEmpty())
+            continue;
+
+        for (auto& row : model->rows)
+            row.text = displayText(row.address, row.balance);
+
+        emit model->dataChanged(model->index(0), model->index(model->rows.size() - 1));
+    }
+}
+
+QString AddressListModel::displayText(const QString& address, Amount bal) {
+    QString txt = AddressBook::addLabelToAddress(address);
+    if (bal.isPositive())
+        txt = txt % "(" % Settings::getZECDisplayFormat(bal) % ")";
+
+    return txt;
+}
+
+bool AddressListModel::accepts(const QString& address) const {
+    switch (kind) {
+    case SaplingAddresses:  return Settings::getInstance()->isSaplingAddress(address);
+    case SproutAddresses:   return Settings::getInstance()->isSproutAddress(address);
+    case TAddresses:        return Settings::isTAddress(address);
+    default:                return true;
+    }
+}
+
+QString AddressListModel::address(int row) const {
+    return row >= 0 && row < rows.size() ? rows.at(row).address : QString();
+}
+
+Amount AddressListModel::balance(int row) const {
+    return row >= 0 && row < rows.size() ? rows.at(row).balance : Amount();
+}
+
+int AddressListModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : rows.size();
+}
+
+QVariant AddressListModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= rows.size())
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:      return rows.at(index.row()).text;
+    case Qt::ToolTipRole:
+    case AddressRole:       return rows.at(index.row()).address;
+    default:                return QVariant();
+    }
+}
+
+void AddressListModel::reset(const WalletSnapshotPtr& snapshot) {
+    beginResetModel();
+    rows.clear();
+    rowIndex.clear();
+
+    if (followsBalances()) {
+        for (auto it = snapshot->balances.constBegin(); it != snapshot->balances.constEnd(); ++it) {
+            if (!it.value().isPositive())
+                continue;
+
+            QString addr = it.key();
+            if (accepts(addr))
+                rows.push_back(Row{ addr, it.value(), displayText(addr, it.value()) });
+        }
+
+        // The balances are hashed by id, the list is sorted by address
+        std::sort(rows.begin(), rows.end(), [] (const Row& a, const Row& b) {
+            return a.address < b.address;
+        });
+    } else {
+        for (const auto& addr : kind == TAddresses ? snapshot->taddresses : snapshot->zaddresses) {
+            if (accepts(addr)) {
+                auto bal = snapshot->balances.value(addr);
+                rows.push_back(Row{ addr, bal, displayText(addr, bal) });
+            }
+        }
+    }
+
+    reindexFrom(0);
+    synced = snapshot;
+    endResetModel();
+}
+
+void AddressListModel::applyChanges(const WalletChangeSet& changes) {
+    // Missed a snapshot somewhere, so the deltas don't apply to what we have
+    if (synced != changes.from) {
+        reset(changes.to);
+        return;
+    }
+    synced = changes.to;
+
+    if (changes.isEmpty())
+        return;
+
+    TraceSpan span("AddressListModel::applyChanges", "model");
+
+    for (const auto& d : changes.deltas) {
+        switch (d.type) {
+        case WalletDelta::AddressAdded:
+            if (!followsBalances() && accepts(d.address) && rowOf(d.address) < 0)
+                insertRow(rows.size(), d.address, changes.to->balances.value(d.address));
+            break;
+
+        case WalletDelta::AddressRemoved:
+            if (!followsBalances() && rowOf(d.address) >= 0)
+                removeRow(rowOf(d.address));
+            break;
+
+        case WalletDelta::BalanceChanged: {
+            int row = rowOf(d.address);
+            if (row >= 0 && followsBalances() && !d.newAmount.isPositive()) {
+                removeRow(row);
+            } else if (row >= 0) {
+                rows[row].balance = d.newAmount;
+                rows[row].text    = displayText(d.address, d.newAmount);
+                emit dataChanged(index(row), index(row));
+            } else if (followsBalances() && d.newAmount.isPositive() && accepts(d.address)) {
+                insertRow(sortedPosition(d.address), d.address, d.newAmount);
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+}
+
+void AddressListModel::insertRow(int row, const QString& address, Amount bal) {
+    beginInsertRows(QModelIndex(), row, row);
+    rows.insert(row, Row{ address, bal, displayText(address, bal) });
+    reindexFrom(row);
+    endInsertRows();
+}
+
+void AddressListModel::removeRow(int row) {
+    beginRemoveRows(QModelIndex(), row, row);
+    rowIndex.remove(rows.at(row).address);
+    rows.remove(row);
+    reindexFrom(row);
+    endRemoveRows();
+}
+
+// Only the rows after an insert or remove move, so only those are renumbered
+void AddressListModel::reindexFrom(int row) {
+    for (int i = row; i < rows.size(); i++)
+        rowIndex.insert(rows.at(i).address, i);
+}
+
+int AddressListModel::sortedPosition(const QString& address) const {
+    auto it = std::lower_bound(rows.begin(), rows.end(), address, [] (const Row& r, const QString& a) {
+        return r.address < a;
+    });
+    return (int)(it - rows.begin());
+}
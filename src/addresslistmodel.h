@@ -0,0 +1,72 @@
+#ifndef ADDRESSLISTMODEL_H
+#define ADDRESSLISTMODEL_H
+
+#include "precompiled.h"
+#include "walletdiff.h"
+
+/**
+ * List model of the wallet's addresses and their balances, for the address picker combo boxes.
+ *
+ * There is one shared instance per kind of list, so all the combos showing the same list use the
+ * same rows. The model follows the wallet snapshots by itself, and only inserts, removes or
+ * repaints the rows that the deltas touch. The display text of each row (label and balance) is
+ * built once when the row changes, and the row of an address is looked up through a hash.
+ */
+class AddressListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Kind {
+        Balances = 0,           // Every address with a balance, sorted. The send tab's from address.
+        SaplingAddresses,       // The wallet's sapling z-addresses, in the order the node lists them
+        SproutAddresses,        // The wallet's sprout z-addresses
+        TAddresses,             // The wallet's t-addresses, in the order the node lists them
+        KindCount
+    };
+
+    // Data role for the plain address of a row
+    static const int AddressRole = Qt::UserRole + 1;
+
+    static AddressListModel* get(Kind kind);
+
+    // The address book changed, so the display text of every row in every list is rebuilt
+    static void labelsChanged();
+
+    QString address(int row) const;
+    Amount  balance(int row) const;
+    int     rowOf(const QString& address) const   { return rowIndex.value(address, -1); }
+
+    int      rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+
+private:
+    explicit AddressListModel(Kind k);
+
+    struct Row {
+        QString address;
+        Amount  balance;
+        QString text;
+    };
+
+    bool    accepts(const QString& address) const;
+    bool    followsBalances() const     { return kind == Balances; }
+
+    void    reset(const WalletSnapshotPtr& snapshot);
+    void    applyChanges(const WalletChangeSet& changes);
+
+    void    insertRow(int row, const QString& address, Amount bal);
+    void    removeRow(int row);
+    void    reindexFrom(int row);
+    int     sortedPosition(const QString& address) const;
+
+    static QString displayText(const QString& address, Amount bal);
+
+    Kind                    kind;
+    QVector<Row>            rows;
+    QHash<QString, int>     rowIndex;
+    WalletSnapshotPtr       synced;
+
+    static AddressListModel* instances[KindCount];
+};
+
+#endif // ADDRESSLISTMODEL_H
@@ -0,0 +1,240 @@
+#include "addresspool.h"
+#include "logger.h"
+#include "rpc.h"
+#include "walletsnapshot.h"
+
+namespace {
+
+// Each pooled address is stored under the address itself, with its kind and when it was created
+QByteArray encodeEntry(AddressPool::Kind kind, qint64 created) {
+    QByteArray value;
+    QDataStream out(&value, QIODevice::WriteOnly);
+    out << (quint8)kind << created;
+    return value;
+}
+
+}
+
+AddressPool::AddressPool(RPC* _rpc) : rpc(_rpc) {
+}
+
+// Load the pool for the current network, if it isn't already
+void AddressPool::load() {
+    auto t = WalletStore::getInstance()->table(QStringLiteral("addrpool"));
+    if (t == table)
+        return;
+
+    table = t;
+
+    QList<QPair<qint64, QString>> entries[KindCount];
+    for (auto it = table->all().constBegin(); it != table->all().constEnd(); it++) {
+        QDataStream in(it.value());
+        quint8 kind;
+        qint64 created;
+        in >> kind >> created;
+        if (kind < KindCount)
+            entries[kind].push_back(qMakePair(created, QString::fromUtf8(it.key())));
+    }
+
+    for (int k = 0; k < KindCount; k++) {
+        std::sort(entries[k].begin(), entries[k].end());
+
+        pools[k].clear();
+        for (const auto& e : entries[k])
+            pools[k].push_back(e.second);
+
+        // Not checked against this wallet yet
+        verified[k] = false;
+    }
+}
+
+int AddressPool::available(Kind kind) {
+    load();
+    return verified[kind] ? pools[kind].size() : 0;
+}
+
+bool AddressPool::contains(const QString& addr) {
+    load();
+    return table->contains(addr.toUtf8());
+}
+
+void AddressPool::take(Kind kind, const std::function<void(QString)>& cb) {
+    take(kind, 1, [=] (QList<QString> addrs) {
+        cb(addrs.isEmpty() ? QString() : addrs.first());
+    });
+}
+
+void AddressPool::take(Kind kind, int count, const std::function<void(QList<QString>)>& cb) {
+    load();
+
+    // Whoever asked first is served first
+    if (verified[kind] && waiting[kind].isEmpty() && pools[kind].size() >= count) {
+        cb(takeNow(kind, count));
+        return;
+    }
+
+    // The last batch failed and there won't be another one for a while, so don't leave the caller hanging
+    if (verified[kind] && isBackingOff(kind)) {
+        cb(QList<QString>());
+        return;
+    }
+
+    // Served as soon as the pool is verified and the next batch comes in
+    waiting[kind].push_back(Waiter{ count, cb });
+    fill(kind);
+}
+
+QList<QString> AddressPool::takeNow(Kind kind, int count) {
+    QList<QString> addrs = pools[kind].mid(0, count);
+    pools[kind].erase(pools[kind].begin(), pools[kind].begin() + addrs.size());
+
+    table->beginBatch();
+    for (const auto& addr : addrs)
+        table->remove(addr.toUtf8());
+    table->commit();
+
+    handOut(kind, addrs);
+
+    if (pools[kind].size() < lowWater)
+        fill(kind);
+
+    return addrs;
+}
+
+// The addresses are already in the wallet, so they only have to be added to the lists, not reloaded from komodod
+void AddressPool::handOut(Kind kind, const QList<QString>& addrs) {
+    WalletSnapshots::getInstance()->update([&] (WalletSnapshot& s) {
+        if (kind == Sapling)
+            s.zaddresses.append(addrs);
+        else
+            s.taddresses.append(addrs);
+    });
+}
+
+void AddressPool::filter(Kind kind, QList<QString>& addresses) {
+    load();
+
+    QSet<QString> listed;
+    if (!pools[kind].isEmpty()) {
+        auto end = std::remove_if(addresses.begin(), addresses.end(), [&] (const QString& addr) {
+            if (!table->contains(addr.toUtf8()))
+                return false;
+
+            listed.insert(addr);
+            return true;
+        });
+        addresses.erase(end, addresses.end());
+    }
+
+    if (!verified[kind]) {
+        QList<QString> kept;
+        table->beginBatch();
+        for (const auto& addr : pools[kind]) {
+            if (listed.contains(addr))
+                kept.push_back(addr);
+            else
+                table->remove(addr.toUtf8());
+        }
+        table->commit();
+
+        pools[kind]    = kept;
+        verified[kind] = true;
+    }
+
+    if (pools[kind].size() < lowWater || !waiting[kind].isEmpty())
+        fill(kind);
+}
+
+bool AddressPool::isBackingOff(Kind kind) const {
+    return QDateTime::currentMSecsSinceEpoch() < retryAt[kind];
+}
+
+int AddressPool::waitingCount(Kind kind) const {
+    int count = 0;
+    for (const auto& w : waiting[kind])
+        count += w.count;
+    return count;
+}
+
+// Create enough addresses to bring the pool back up to target, and for everyone waiting, in one batch
+void AddressPool::fill(Kind kind) {
+    if (filling[kind] || !verified[kind] || rpc->getConnection() == nullptr || isBackingOff(kind))
+        return;
+
+    int count = target - pools[kind].size() + waitingCount(kind);
+    if (count <= 0)
+        return;
+
+    QList<QString> ids;
+    for (int i = 0; i < count; i++)
+        ids.push_back(QString::number(i));
+
+    filling[kind] = true;
+    auto t = table;
+
+    rpc->getConnection()->doBatchRPC<QString>(ids,
+        [=] (QString) {
+            json payload = {
+                {"jsonrpc", "1.0"},
+                {"id", "addrpool"},
+                {"method", kind == Sapling ? "z_getnewaddress" : "getnewaddress"}
+            };
+            if (kind == Sapling)
+                payload["params"] = json::array({"sapling"});
+
+            return payload;
+        },
+        [=] (QMap<QString, json>* replies) {
+            filling[kind] = false;
+
+            // Switched networks while the batch was out, these belong to the other wallet
+            if (t != table) {
+                delete replies;
+                return;
+            }
+
+            // Failed calls come back as empty objects
+            int failed = 0;
+            table->beginBatch();
+            qint64 now = QDateTime::currentSecsSinceEpoch();
+            for (const auto& reply : *replies) {
+                if (!reply.is_string()) {
+                    failed++;
+                    continue;
+                }
+
+                auto addr = QString::fromStdString(reply.get<json::string_t>());
+                table->put(addr.toUtf8(), encodeEntry(kind, now));
+                pools[kind].push_back(addr);
+            }
+            table->commit();
+            delete replies;
+
+            // Most likely every call fails the same way, like a locked wallet, so don't ask again right away
+            if (failed > 0) {
+                backoff[kind] = qBound(minBackoff, backoff[kind] * 2, maxBackoff);
+                retryAt[kind] = QDateTime::currentMSecsSinceEpoch() + backoff[kind];
+                LOG_WARNING("Couldn't create pool addresses", {{"failed", QString::number(failed)},
+                                                               {"retry_ms", QString::number(backoff[kind])}});
+            } else {
+                backoff[kind] = 0;
+                retryAt[kind] = 0;
+            }
+
+            while (!waiting[kind].isEmpty() && pools[kind].size() >= waiting[kind].first().count) {
+                auto w = waiting[kind].takeFirst();
+                w.cb(takeNow(kind, w.count));
+            }
+
+            // What's left can't be served until after the backoff, so it fails now. Otherwise there's
+            // someone who came in while the batch was out, and another batch is on its way for them.
+            if (failed > 0) {
+                auto unserved = waiting[kind];
+                waiting[kind].clear();
+                for (const auto& w : unserved)
+                    w.cb(QList<QString>());
+            } else if (!waiting[kind].isEmpty()) {
+                fill(kind);
+            }
+        });
+}
@@ -0,0 +1,81 @@
+#ifndef ADDRESSPOOL_H
+#define ADDRESSPOOL_H
+
+#include "precompiled.h"
+#include "walletstore.h"
+
+class RPC;
+
+/**
+ * A pool of fresh, never handed out receiving addresses, so that a new address for an invoice or the
+ * Receive tab is there right away instead of costing a round trip to komodod and a reload of every address.
+ *
+ * The pool is topped up in the background, with one batch of z_getnewaddress or getnewaddress calls,
+ * whenever it runs low. The pooled addresses are kept in the "addrpool" wallet table, so they survive a
+ * restart. They are left out of the wallet's address lists until they're handed out, and handing them out
+ * just appends them to the current snapshot.
+ *
+ * If komodod fails to create addresses (eg. the wallet is locked), everyone waiting is told, and the pool
+ * isn't topped up again until a backoff delay has passed.
+ */
+class AddressPool
+{
+public:
+    enum Kind : quint8 {
+        Sapling     = 0,
+        Transparent,
+        KindCount
+    };
+
+    AddressPool(RPC* _rpc);
+
+    // An unused address, from the pool if there is one, or as soon as the next batch comes in. Empty if
+    // komodod couldn't create one.
+    void        take(Kind kind, const std::function<void(QString)>& cb);
+
+    // count unused addresses at once, created in a single batch if the pool doesn't have them, and added to
+    // the address lists with a single snapshot. Empty if komodod couldn't create them all.
+    void        take(Kind kind, int count, const std::function<void(QList<QString>)>& cb);
+
+    int         available(Kind kind);
+    bool        contains(const QString& addr);
+
+    // Called with every full address list from komodod. Takes the pooled addresses out of the list, so they
+    // stay hidden until they're handed out. The first list after connecting also drops pooled addresses
+    // the wallet doesn't have (eg. a different wallet.dat). A pool below lowWater is then topped up.
+    void        filter(Kind kind, QList<QString>& addresses);
+
+    static const int lowWater   = 10;
+    static const int target     = 25;
+
+    // ms to wait after a failed batch, doubled with every failure in a row
+    static const int minBackoff = 5 * 1000;
+    static const int maxBackoff = 5 * 60 * 1000;
+
+private:
+    struct Waiter {
+        int                                     count;
+        std::function<void(QList<QString>)>     cb;
+    };
+
+    void        load();
+    void        fill(Kind kind);
+    bool        isBackingOff(Kind kind) const;
+    int         waitingCount(Kind kind) const;
+
+    QList<QString> takeNow(Kind kind, int count);
+    void        handOut(Kind kind, const QList<QString>& addrs);
+
+    RPC*                                rpc;
+    WalletTable*                        table       = nullptr;
+
+    QList<QString>                      pools[KindCount];           // Oldest first
+    bool                                verified[KindCount]         = {};
+    bool                                filling[KindCount]          = {};
+    QList<Waiter>                       waiting[KindCount];
+
+    int                                 backoff[KindCount]          = {};
+    qint64                              retryAt[KindCount]          = {};   // ms since epoch
+};
+
+#endif // ADDRESSPOOL_H
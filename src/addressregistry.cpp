@@ -0,0 +1,61 @@
+#include "addressregistry.h"
+
+QString AddressId::toString() const {
+    return AddressRegistry::getInstance()->string(*this);
+}
+
+AddressRegistry* AddressRegistry::instance = nullptr;
+
+AddressRegistry* AddressRegistry::getInstance() {
+    // Created on first use, which happens on the UI thread before any worker threads are started
+    if (!instance)
+        instance = new AddressRegistry();
+
+    return instance;
+}
+
+AddressRegistry::AddressRegistry() {
+    // Id 0 is reserved for the empty address
+    strings.push_back(QString());
+    index.insert(QString(), 0);
+}
+
+AddressId AddressRegistry::intern(const QString& addr) {
+    {
+        QReadLocker locker(&lock);
+        auto it = index.constFind(addr);
+        if (it != index.constEnd())
+            return AddressId(it.value());
+    }
+
+    QWriteLocker locker(&lock);
+
+    // Someone else might have added it in the meantime
+    auto it = index.constFind(addr);
+    if (it != index.constEnd())
+        return AddressId(it.value());
+
+    quint32 id = (quint32)strings.size();
+    strings.push_back(addr);
+    index.insert(addr, id);
+
+    return AddressId(id);
+}
+
+AddressId AddressRegistry::find(const QString& addr) const {
+    QReadLocker locker(&lock);
+    return AddressId(index.value(addr, 0));
+}
+
+QString AddressRegistry::string(AddressId id) const {
+    QReadLocker locker(&lock);
+    if (id.id >= (quint32)strings.size())
+        return QString();
+
+    return strings.at(id.id);
+}
+
+int AddressRegistry::size() const {
+    QReadLocker locker(&lock);
+    return strings.size() - 1;
+}
@@ -0,0 +1,128 @@
+#ifndef ADDRESSREGISTRY_H
+#define ADDRESSREGISTRY_H
+
+#include "precompiled.h"
+
+// A small integer handle for an interned address string. Id 0 is the empty address.
+struct AddressId {
+    quint32 id = 0;
+
+    AddressId() = default;
+    explicit AddressId(quint32 i) : id(i) {}
+
+    bool    isEmpty() const { return id == 0; }
+    QString toString() const;
+
+    bool operator==(const AddressId& o) const { return id == o.id; }
+    bool operator!=(const AddressId& o) const { return id != o.id; }
+    bool operator< (const AddressId& o) const { return id <  o.id; }
+};
+
+inline uint qHash(const AddressId& a, uint seed = 0) { return ::qHash(a.id, seed); }
+
+Q_DECLARE_TYPEINFO(AddressId, Q_PRIMITIVE_TYPE);
+
+/**
+ * Process wide address interning table.
+ *
+ * Every distinct address string is stored exactly once and given a stable AddressId, so the rest of
+ * the wallet can keep 4-byte ids instead of 78-character strings, and compare or hash them as
+ * integers.
+ *
+ * Ids are never released, the set of addresses a wallet sees is small and only grows.
+ * All methods are thread safe.
+ */
+class AddressRegistry
+{
+public:
+    static AddressRegistry* getInstance();
+
+    // Get the id for this address, adding it if it is not in the table yet
+    AddressId   intern(const QString& addr);
+
+    // Look up the id without adding it. Returns the empty id if the address was never interned.
+    AddressId   find(const QString& addr) const;
+
+    QString     string(AddressId id) const;
+
+    int         size() const;
+
+private:
+    AddressRegistry();
+
+    static AddressRegistry*     instance;
+
+    mutable QReadWriteLock      lock;
+
+    QVector<QString>            strings;
+    QHash<QString, quint32>     index;
+};
+
+/**
+ * A map from address to T, keyed by AddressId.
+ *
+ * Has the same lookup interface as the QMap<QString, T> it replaces, so lookups by address string still
+ * work, but the map itself only stores and hashes integers. A lookup by string goes through the registry
+ * first, which costs more than the plain string hash did, so loops should use the id overloads (the ids
+ * come with the iterators) and keep the string ones for one-off lookups. There is no keys(): walk it with the iterators,
+ * which give the key and the value together, and sort where a list has to be in address order.
+ */
+template<typename T>
+class AddressMap
+{
+public:
+    class const_iterator {
+    public:
+        explicit const_iterator(typename QHash<AddressId, T>::const_iterator i) : it(i) {}
+
+        QString     key() const     { return it.key().toString(); }
+        AddressId   id() const      { return it.key(); }
+        const T&    value() const   { return it.value(); }
+        const T&    operator*() const { return it.value(); }
+
+        const_iterator& operator++()    { ++it; return *this; }
+        bool operator==(const const_iterator& o) const { return it == o.it; }
+        bool operator!=(const const_iterator& o) const { return it != o.it; }
+
+    private:
+        typename QHash<AddressId, T>::const_iterator it;
+    };
+
+    int     size() const        { return map.size(); }
+    bool    isEmpty() const     { return map.isEmpty(); }
+    void    clear()             { map.clear(); }
+    void    reserve(int n)      { map.reserve(n); }
+
+    T value(AddressId id, const T& def = T()) const { return map.value(id, def); }
+    T value(const QString& addr, const T& def = T()) const {
+        AddressId id = AddressRegistry::getInstance()->find(addr);
+        return id.isEmpty() ? def : map.value(id, def);
+    }
+
+    bool contains(AddressId id) const           { return map.contains(id); }
+    bool contains(const QString& addr) const    {
+        AddressId id = AddressRegistry::getInstance()->find(addr);
+        return !id.isEmpty() && map.contains(id);
+    }
+
+    void insert(AddressId id, const T& v)       { map.insert(id, v); }
+    void insert(const QString& addr, const T& v){ map.insert(AddressRegistry::getInstance()->intern(addr), v); }
+
+    T& operator[](AddressId id)                 { return map[id]; }
+    T& operator[](const QString& addr)          { return map[AddressRegistry::getInstance()->intern(addr)]; }
+
+    QList<AddressId> ids() const                { return map.keys(); }
+
+    // True if both maps are copies of the same data, so they are known to be equal without comparing
+    bool isSharedWith(const AddressMap<T>& o) const { return map.isSharedWith(o.map); }
+
+    const_iterator constBegin() const   { return const_iterator(map.constBegin()); }
+    const_iterator constEnd() const     { return const_iterator(map.constEnd()); }
+    const_iterator begin() const        { return constBegin(); }
+    const_iterator end() const          { return constEnd(); }
+
+private:
+    QHash<AddressId, T>   map;
+};
+
+#endif // ADDRESSREGISTRY_H
@@ -0,0 +1,242 @@
+#include "addressvalidator.h"
+
+namespace {
+
+// Value of each ASCII character in the base58 alphabet, -1 if it isn't in it
+const qint8 base58Values[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8, -1, -1, -1, -1, -1, -1,
+    -1,  9, 10, 11, 12, 13, 14, 15, 16, -1, 17, 18, 19, 20, 21, -1,
+    22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, -1, -1, -1, -1, -1,
+    -1, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, 44, 45, 46,
+    47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, -1, -1, -1, -1, -1,
+};
+
+// Same for the bech32 charset, which is case insensitive
+const qint8 bech32Values[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    15, -1, 10, 17, 21, 20, 26, 30,  7,  5, -1, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+};
+
+// t-addresses are a version byte, a 20 byte hash and a 4 byte checksum, 34 base58 characters
+const int       tAddrChars      = 34;
+const int       tAddrBytes      = 25;
+const quint8    tAddrVersion    = 60;       // Encodes as a leading 'R'
+
+// Sapling addresses are 43 bytes, which is 69 five bit groups plus the 6 group checksum
+const int       saplingDataChars = 75;
+
+inline quint32 bech32Step(quint32 chk, quint32 value) {
+    static const quint32 gen[5] = { 0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3 };
+
+    quint32 top = chk >> 25;
+    chk = ((chk & 0x1ffffff) << 5) ^ value;
+    for (int i = 0; i < 5; i++)
+        chk ^= gen[i] & (0u - ((top >> i) & 1));
+    return chk;
+}
+
+}
+
+AddressValidator::Kind AddressValidator::check(const QString& addr) {
+    const QChar* s   = addr.constData();
+    const int    len = addr.size();
+
+    if (len == tAddrChars && s[0] == 'R')
+        return checkBase58(s, len);
+
+    if (len == 2 + 1 + saplingDataChars && (s[0] == 'z' || s[0] == 'Z'))
+        return checkBech32(s, len, 2, Sapling);
+
+    if (len == 12 + 1 + saplingDataChars && (s[0] == 'z' || s[0] == 'Z'))
+        return checkBech32(s, len, 12, SaplingTestnet);
+
+    return Invalid;
+}
+
+AddressValidator::Kind AddressValidator::checkBase58(const QChar* s, int len) {
+    // The number is built up in 32 bit limbs, least significant first. 7 limbs hold the 25 bytes.
+    quint32 limbs[7] = {0};
+
+    // 58^5 still fits in 32 bits, so 5 characters are folded in with one pass over the limbs
+    for (int i = 0; i < len; ) {
+        quint32 group = 0;
+        quint32 mul   = 1;
+        for (int n = 0; n < 5 && i < len; n++, i++) {
+            ushort c = s[i].unicode();
+            int    v = c < 128 ? base58Values[c] : -1;
+            if (v < 0)
+                return Invalid;
+
+            group = group * 58 + (quint32)v;
+            mul  *= 58;
+        }
+
+        quint64 carry = group;
+        for (auto& limb : limbs) {
+            quint64 t = (quint64)limb * mul + carry;
+            limb  = (quint32)t;
+            carry = t >> 32;
+        }
+        if (carry != 0)
+            return Invalid;
+    }
+
+    // 28 bytes in the limbs, the top 3 have to be empty
+    if (limbs[6] > 0xFF)
+        return Invalid;
+
+    unsigned char bytes[tAddrBytes];
+    for (int i = 0; i < tAddrBytes; i++) {
+        int bit = (tAddrBytes - 1 - i) * 8;
+        bytes[i] = (unsigned char)(limbs[bit / 32] >> (bit % 32));
+    }
+
+    if (bytes[0] != tAddrVersion)
+        return Invalid;
+
+    unsigned char hash[crypto_hash_sha256_BYTES];
+    crypto_hash_sha256(hash, bytes, tAddrBytes - 4);
+    crypto_hash_sha256(hash, hash, sizeof(hash));
+
+    return memcmp(hash, bytes + tAddrBytes - 4, 4) == 0 ? Transparent : Invalid;
+}
+
+AddressValidator::Kind AddressValidator::checkBech32(const QChar* s, int len, int hrpLen, Kind kind) {
+    const char* hrp = kind == Sapling ? "zs" : "ztestsapling";
+
+    // Mixing upper and lower case isn't allowed, but either one on its own is
+    bool lower = false;
+    bool upper = false;
+
+    quint32 chk = 1;
+    for (int i = 0; i < hrpLen; i++) {
+        ushort c = s[i].unicode();
+        if (c >= 'A' && c <= 'Z') {
+            upper = true;
+            c += 'a' - 'A';
+        } else {
+            lower = true;
+        }
+
+        if (c != (ushort)hrp[i])
+            return Invalid;
+        chk = bech32Step(chk, c >> 5);
+    }
+    chk = bech32Step(chk, 0);
+    for (int i = 0; i < hrpLen; i++)
+        chk = bech32Step(chk, (quint32)hrp[i] & 31);
+
+    if (s[hrpLen] != '1')
+        return Invalid;
+
+    int last = 0;
+    for (int i = hrpLen + 1; i < len; i++) {
+        ushort c = s[i].unicode();
+        int    v = c < 128 ? bech32Values[c] : -1;
+        if (v < 0)
+            return Invalid;
+
+        if (c >= 'A' && c <= 'Z')
+            upper = true;
+        else if (c >= 'a' && c <= 'z')
+            lower = true;
+
+        chk = bech32Step(chk, (quint32)v);
+        if (i == len - 7)
+            last = v;
+    }
+
+    if (lower && upper)
+        return Invalid;
+
+    // 69 groups are 345 bits for 344 bits of address, the extra bit has to be 0
+    if (last & 1)
+        return Invalid;
+
+    return chk == 1 ? kind : Invalid;
+}
+
+namespace {
+
+// Below this the batch is checked on the calling thread, splitting it up costs more than it saves
+const int parallelBatch = 16 * 1024;
+
+struct BatchProgress {
+    QMutex          lock;
+    QWaitCondition  finished;
+    int             pending = 0;
+    int             valid   = 0;
+};
+
+class CheckChunkTask : public QRunnable {
+public:
+    CheckChunkTask(const QString* a, int n, AddressValidator::Kind* o, BatchProgress* p)
+        : addrs(a), count(n), out(o), progress(p) {}
+
+    void run() override {
+        int valid = 0;
+        for (int i = 0; i < count; i++) {
+            out[i] = AddressValidator::check(addrs[i]);
+            if (out[i] != AddressValidator::Invalid)
+                valid++;
+        }
+
+        QMutexLocker locker(&progress->lock);
+        progress->valid += valid;
+        if (--progress->pending == 0)
+            progress->finished.wakeAll();
+    }
+
+private:
+    const QString*              addrs;
+    int                         count;
+    AddressValidator::Kind*     out;
+    BatchProgress*              progress;
+};
+
+}
+
+int AddressValidator::checkAll(const QString* addrs, int count, Kind* out) {
+    int threads = QThreadPool::globalInstance()->maxThreadCount();
+    if (count < parallelBatch || threads < 2) {
+        BatchProgress progress;
+        progress.pending = 1;
+        CheckChunkTask(addrs, count, out, &progress).run();
+        return progress.valid;
+    }
+
+    // Every chunk writes to its own part of out, so they only share the count of valid addresses.
+    // The last chunk runs here instead of waiting idle.
+    BatchProgress progress;
+    int chunk = (count + threads - 1) / threads;
+    progress.pending = (count + chunk - 1) / chunk;
+
+    for (int start = 0; start + chunk < count; start += chunk)
+        QThreadPool::globalInstance()->start(new CheckChunkTask(addrs + start, chunk, out + start, &progress));
+
+    int last = (progress.pending - 1) * chunk;
+    CheckChunkTask(addrs + last, count - last, out + last, &progress).run();
+
+    QMutexLocker locker(&progress.lock);
+    while (progress.pending > 0)
+        progress.finished.wait(&progress.lock);
+
+    return progress.valid;
+}
+
+int AddressValidator::checkAll(const QStringList& addrs, QVector<Kind>& out) {
+    // QStringList isn't contiguous, so the strings are copied (which only bumps their refcount) first
+    QVector<QString> list = addrs.toVector();
+    out.resize(list.size());
+
+    return checkAll(list.constData(), list.size(), out.data());
+}
@@ -0,0 +1,40 @@
+#ifndef ADDRESSVALIDATOR_H
+#define ADDRESSVALIDATOR_H
+
+#include "precompiled.h"
+
+/**
+ * Checks addresses locally, without asking the node.
+ *
+ * t-addresses are decoded from base58 and their SHA-256d checksum is verified, sapling addresses are
+ * decoded from bech32 and their checksum, human readable part and padding are verified. So a typo
+ * that still looks like an address is caught, not just a wrong length or character.
+ *
+ * Checking an address doesn't allocate: the characters are looked up in tables and decoded into fixed
+ * size buffers on the stack, so checking a whole payout file is cheap.
+ */
+class AddressValidator
+{
+public:
+    enum Kind : quint8 {
+        Invalid = 0,
+        Transparent,        // R..., base58check
+        Sapling,            // zs1..., mainnet
+        SaplingTestnet      // ztestsapling1...
+    };
+
+    static Kind check(const QString& addr);
+
+    static bool isValid(const QString& addr)        { return check(addr) != Invalid; }
+
+    // Check count addresses into out, which has room for count results. Returns how many were valid.
+    // Large batches, like a payout file, are split up over the thread pool.
+    static int  checkAll(const QString* addrs, int count, Kind* out);
+    static int  checkAll(const QStringList& addrs, QVector<Kind>& out);
+
+private:
+    static Kind checkBase58(const QChar* s, int len);
+    static Kind checkBech32(const QChar* s, int len, int hrpLen, Kind kind);
+};
+
+#endif // ADDRESSVALIDATOR_H
@@ -0,0 +1,160 @@
+#include "amount.h"
+
+Amount Amount::fromDouble(double coins) {
+    return Amount(std::llround(coins * COIN));
+}
+
+bool Amount::parse(const char* s, int len, Amount& out) {
+    int i = 0;
+
+    // Surrounding whitespace is allowed, it often comes along when amounts are pasted
+    while (i < len && (s[i] == ' ' || s[i] == '\t'))
+        i++;
+    while (len > i && (s[len - 1] == ' ' || s[len - 1] == '\t'))
+        len--;
+
+    bool negative = false;
+    if (i < len && (s[i] == '-' || s[i] == '+')) {
+        negative = s[i] == '-';
+        i++;
+    }
+
+    // Whole coins. 11 digits is the most that can't overflow once multiplied by COIN.
+    quint64 whole  = 0;
+    int     digits = 0;
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+        if (digits == 0 && whole == 0 && s[i] == '0')   // Leading zeros don't count towards the limit
+            continue;
+        if (++digits > 11)
+            return false;
+        whole = whole * 10 + (quint64)(s[i] - '0');
+    }
+    bool anyWhole = i > 0 && s[i - 1] >= '0' && s[i - 1] <= '9';
+
+    // Fractional zats
+    quint64 frac     = 0;
+    int     decimals = 0;
+    bool    anyFrac  = false;
+    if (i < len && s[i] == '.') {
+        i++;
+        for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+            anyFrac = true;
+            if (decimals < Decimals) {
+                frac = frac * 10 + (quint64)(s[i] - '0');
+                decimals++;
+            } else if (s[i] != '0') {
+                return false;       // Finer than a zat
+            }
+        }
+    }
+
+    if (i != len || (!anyWhole && !anyFrac))
+        return false;
+
+    for (; decimals < Decimals; decimals++)
+        frac *= 10;
+
+    quint64 total = whole * (quint64)COIN + frac;
+    if (total > (quint64)std::numeric_limits<qint64>::max())
+        return false;
+
+    out = Amount(negative ? -(qint64)total : (qint64)total);
+    return true;
+}
+
+bool Amount::parse(const QString& s, Amount& out) {
+    // Amounts are plain ASCII, so anything longer than this can't be one
+    char buf[64];
+    if (s.size() > (int)sizeof(buf))
+        return false;
+
+    const QChar* p = s.constData();
+    for (int i = 0; i < s.size(); i++) {
+        ushort c = p[i].unicode();
+        if (c > 127)
+            return false;
+        buf[i] = (char)c;
+    }
+
+    return parse(buf, s.size(), out);
+}
+
+Amount Amount::fromString(const QString& s, bool* ok) {
+    Amount a;
+    bool   parsed = parse(s, a);
+    if (ok != nullptr)
+        *ok = parsed;
+
+    return parsed ? a : Amount();
+}
+
+Amount Amount::fromJson(const json& j) {
+    if (j.is_string()) {
+        const std::string& s = j.get_ref<const json::string_t&>();
+        Amount a;
+        return parse(s.data(), (int)s.size(), a) ? a : Amount();
+    }
+
+    if (j.is_number_integer())
+        return Amount(j.get<json::number_integer_t>() * COIN);
+
+    // komodod writes numbers with exactly 8 decimals, so rounding the parsed double to the nearest
+    // zat recovers the original value for every representable amount.
+    if (j.is_number())
+        return fromDouble(j.get<json::number_float_t>());
+
+    return Amount();
+}
+
+int Amount::format(char* buf) const {
+    int     n = 0;
+    quint64 u = zats < 0 ? (quint64)(-(zats + 1)) + 1 : (quint64)zats;
+
+    quint64 whole = u / COIN;
+    quint64 frac  = u % COIN;
+
+    if (zats < 0)
+        buf[n++] = '-';
+
+    // Whole part, written backwards into a scratch area and then copied
+    char tmp[20];
+    int  w = 0;
+    do {
+        tmp[w++] = (char)('0' + (whole % 10));
+        whole /= 10;
+    } while (whole > 0);
+    while (w > 0)
+        buf[n++] = tmp[--w];
+
+    if (frac == 0)
+        return n;
+
+    // Drop the trailing zeros of the fraction before writing it out
+    int fracDigits = Decimals;
+    while (frac % 10 == 0) {
+        frac /= 10;
+        fracDigits--;
+    }
+
+    buf[n++] = '.';
+    for (int d = fracDigits - 1; d >= 0; d--) {
+        buf[n + d] = (char)('0' + (frac % 10));
+        frac /= 10;
+    }
+
+    return n + fracDigits;
+}
+
+QString Amount::toDecimalString() const {
+    char buf[MaxChars];
+    return QString::fromLatin1(buf, format(buf));
+}
+
+Amount Amount::sum(const Amount* amounts, int count) {
+    qint64 total = 0;
+    for (int i = 0; i < count; i++) {
+        total += amounts[i].zats;
+    }
+
+    return Amount(total);
+}
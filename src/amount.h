@@ -0,0 +1,88 @@
+#ifndef AMOUNT_H
+#define AMOUNT_H
+
+#include "precompiled.h"
+
+using json = nlohmann::json;
+
+/**
+ * An exact amount of coins, stored as a signed integer number of zats (1e-8 of a coin).
+ *
+ * All balances, transaction amounts and fees are kept as Amounts, so adding them up never picks up
+ * the binary rounding errors a double does, and they can be formatted directly into a char buffer
+ * without going through QString::number and trimming.
+ */
+class Amount
+{
+public:
+    static const qint64 COIN     = 100000000;
+    static const int    Decimals = 8;
+
+    // Longest formatted amount, "-92233720368.54775808", without a terminating null
+    static const int    MaxChars = 21;
+
+    constexpr Amount() : zats(0) {}
+
+    static constexpr Amount fromZats(qint64 zats) { return Amount(zats); }
+
+    // For amounts that are only available as a double, like prices or old saved files. Rounds to the
+    // nearest zat, which is exact for any value that was written with 8 or fewer decimals.
+    static Amount   fromDouble(double coins);
+
+    // Exact decimal parse, eg. "1.5", "-0.00000001". Fails on more than 8 significant decimals or
+    // anything that isn't a plain decimal number.
+    static bool     parse(const char* s, int len, Amount& out);
+    static bool     parse(const QString& s, Amount& out);
+    static Amount   fromString(const QString& s, bool* ok = nullptr);
+
+    // From an RPC reply field, which komodod sends either as a JSON number or a string. Nulls are 0.
+    static Amount   fromJson(const json& j);
+
+    qint64  toZats() const      { return zats; }
+    double  toDouble() const    { return (double)zats / COIN; }
+
+    // The shortest exact decimal form, with trailing zeros (and a trailing ".") removed, eg. "1.5"
+    int     format(char* buf) const;
+    QString toDecimalString() const;
+
+    // For RPC params. Amounts are sent as strings so they arrive at komodod exactly as formatted.
+    json    toJson() const      { char buf[MaxChars]; return std::string(buf, (size_t)format(buf)); }
+
+    // For the RPC params that komodod reads with get_real(), like z_sendmany's fee, which refuse a string.
+    // The double is written out as its shortest round-trip form, and komodod rounds it back to zats.
+    json    toJsonNumber() const { return toDouble(); }
+
+    bool    isZero() const      { return zats == 0; }
+    bool    isNegative() const  { return zats < 0; }
+    bool    isPositive() const  { return zats > 0; }
+
+    // Add up a packed array of amounts. This is a plain integer loop the compiler can vectorize.
+    static Amount sum(const Amount* amounts, int count);
+
+    constexpr Amount operator-() const                  { return Amount(-zats); }
+    constexpr Amount operator+(const Amount& o) const   { return Amount(zats + o.zats); }
+    constexpr Amount operator-(const Amount& o) const   { return Amount(zats - o.zats); }
+    constexpr Amount operator*(qint64 n) const          { return Amount(zats * n); }
+    constexpr Amount operator/(qint64 n) const          { return Amount(zats / n); }
+    Amount& operator+=(const Amount& o)                 { zats += o.zats; return *this; }
+    Amount& operator-=(const Amount& o)                 { zats -= o.zats; return *this; }
+
+    constexpr bool operator==(const Amount& o) const    { return zats == o.zats; }
+    constexpr bool operator!=(const Amount& o) const    { return zats != o.zats; }
+    constexpr bool operator< (const Amount& o) const    { return zats <  o.zats; }
+    constexpr bool operator<=(const Amount& o) const    { return zats <= o.zats; }
+    constexpr bool operator> (const Amount& o) const    { return zats >  o.zats; }
+    constexpr bool operator>=(const Amount& o) const    { return zats >= o.zats; }
+
+private:
+    constexpr explicit Amount(qint64 z) : zats(z) {}
+
+    qint64 zats;
+};
+
+inline Amount operator*(qint64 n, const Amount& a) { return a * n; }
+
+Q_DECLARE_TYPEINFO(Amount, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(Amount)
+
+#endif // AMOUNT_H
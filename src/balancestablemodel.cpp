@@ -1,31 +1,32 @@
 #include "balancestablemodel.h"
 #include "addressbook.h"
 #include "settings.h"
+#include "trace.h"
 
 
 BalancesTableModel::BalancesTableModel(QObject *parent)
     : QAbstractTableModel(parent) {    
 }
 
-void BalancesTableModel::setNewData(const QMap<QString, double>* balances, 
-    const QList<UnspentOutput>* outputs)
+void BalancesTableModel::setNewData(WalletSnapshotPtr data)
 {    
+    TraceSpan span("BalancesTableModel::setNewData", "model");
+    span.arg("rows", data->balances.size());
     loading = false;
 
     int currentRows = rowCount(QModelIndex());
-    // Copy over the utxos for our use
-    delete utxos;
-    utxos = new QList<UnspentOutput>();
-    // This is a QList deep copy.
-    *utxos = *outputs;
+    snapshot = data;
 
     // Process the address balances into a list
     delete modeldata;
-    modeldata = new QList<std::tuple<QString, double>>();
-    std::for_each(balances->keyBegin(), balances->keyEnd(), [=] (auto keyIt) {
-        if (balances->value(keyIt) > 0)
-            modeldata->push_back(std::make_tuple(keyIt, balances->value(keyIt)));
-    });
+    modeldata = new QList<std::tuple<QString, Amount>>();
+    for (auto it = data->balances.constBegin(); it != data->balances.constEnd(); ++it) {
+        if (it.value().isPositive())
+            modeldata->push_back(std::make_tuple(it.key(), it.value()));
+    }
+
+    // Keep the rows in address order
+    std::sort(modeldata->begin(), modeldata->end());
 
     // And then update the data
     dataChanged(index(0, 0), index(modeldata->size()-1, columnCount(index(0,0))-1));
@@ -35,9 +36,63 @@ void BalancesTableModel::setNewData(const QMap<QString, double>* balances,
         layoutChanged();
 }
 
+// The rows are sorted by address, so this is a binary search. Returns the row where the address is,
+// or where it would be inserted.
+int BalancesTableModel::findRow(const QString& addr) const {
+    auto it = std::lower_bound(modeldata->begin(), modeldata->end(), addr, 
+                    [] (const std::tuple<QString, Amount>& row, const QString& a) {
+                        return std::get<0>(row) < a;
+                    });
+    return (int)(it - modeldata->begin());
+}
+
+void BalancesTableModel::applyChanges(const WalletChangeSet& changes) {
+    if (modeldata == nullptr || snapshot != changes.from) {
+        if (changes.to->hasBalances)
+            setNewData(changes.to);
+        return;
+    }
+    snapshot = changes.to;
+
+    TraceSpan span("BalancesTableModel::applyChanges", "model");
+    span.arg("deltas", changes.deltas.size());
+
+    for (const auto& d : changes.deltas) {
+        if (d.type == WalletDelta::BalanceChanged) {
+            int  row    = findRow(d.address);
+            bool exists = row < modeldata->size() && std::get<0>(modeldata->at(row)) == d.address;
+
+            if (exists && d.newAmount.isPositive()) {
+                std::get<1>((*modeldata)[row]) = d.newAmount;
+                dataChanged(index(row, 0), index(row, columnCount(index(0,0))-1));
+            } else if (exists) {
+                beginRemoveRows(QModelIndex(), row, row);
+                modeldata->removeAt(row);
+                endRemoveRows();
+            } else if (d.newAmount.isPositive()) {
+                beginInsertRows(QModelIndex(), row, row);
+                modeldata->insert(row, std::make_tuple(d.address, d.newAmount));
+                endInsertRows();
+            }
+        } else if (d.type == WalletDelta::UtxoConfirmed) {
+            // Repaint the row, it may not be red anymore
+            int row = findRow(d.address);
+            if (row < modeldata->size() && std::get<0>(modeldata->at(row)) == d.address)
+                dataChanged(index(row, 0), index(row, columnCount(index(0,0))-1));
+        }
+    }
+}
+
+void BalancesTableModel::setStale(bool s) {
+    if (stale == s)
+        return;
+
+    stale = s;
+    dataChanged(index(0, 0), index(rowCount(QModelIndex())-1, columnCount(index(0,0))-1));
+}
+
 BalancesTableModel::~BalancesTableModel() {
     delete modeldata;
-    delete utxos;
 }
 
 int BalancesTableModel::rowCount(const QModelIndex&) const
@@ -68,9 +123,15 @@ QVariant BalancesTableModel::data(const QModelIndex &index, int role) const
     if (role == Qt::TextAlignmentRole && index.column() == 1) return QVariant(Qt::AlignRight | Qt::AlignVCenter);
     
     if (role == Qt::ForegroundRole) {
+        if (stale) {
+            QBrush b;
+            b.setColor(Qt::gray);
+            return b;
+        }
+
         // If any of the UTXOs for this address has zero confirmations, paint it in red
         const auto& addr = std::get<0>(modeldata->at(index.row()));
-        for (auto utxo : *utxos) {
+        for (const auto& utxo : snapshot->utxos) {
             if (utxo.address == addr && utxo.confirmations == 0) {
                 QBrush b;
                 b.setColor(Qt::red);
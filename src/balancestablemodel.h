@@ -2,14 +2,7 @@
 #define BALANCESTABLEMODEL_H
 
 #include "precompiled.h"
-
-struct UnspentOutput {
-    QString address;
-    QString txid;
-    QString amount;    
-    int     confirmations;
-    bool    spendable;
-};
+#include "walletdiff.h"
 
 class BalancesTableModel : public QAbstractTableModel
 {
@@ -17,7 +10,14 @@ public:
     BalancesTableModel(QObject* parent);
     ~BalancesTableModel();
 
-    void setNewData(const QMap<QString, double>* balances, const QList<UnspentOutput>* outputs);
+    void setNewData(WalletSnapshotPtr data);
+
+    // Update just the rows the deltas touch. Falls back to setNewData if the model isn't showing the
+    // snapshot the deltas start from.
+    void applyChanges(const WalletChangeSet& changes);
+
+    // Stale data is the saved state from the last run, shown greyed out until the node is up
+    void setStale(bool s);
 
     int rowCount(const QModelIndex &parent) const;
     int columnCount(const QModelIndex &parent) const;
@@ -25,10 +25,15 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
 
 private:
-    QList<std::tuple<QString, double>>*    modeldata   = nullptr;    
-    QList<UnspentOutput>*                  utxos       = nullptr;  
+    int  findRow(const QString& addr) const;
+
+    QList<std::tuple<QString, Amount>>*    modeldata   = nullptr;    
+
+    // Held on to for the UTXOs, instead of copying them
+    WalletSnapshotPtr                      snapshot;
 
     bool loading = true;
+    bool stale   = false;
 };
 
 #endif // BALANCESTABLEMODEL_H
\ No newline at end of file
@@ -707,27 +707,41 @@ void Connection::doRPC(const json& payload, const std::function<void(json)>& cb,
         return;
     }
 
-    qDebug() << "RPC: " << QString::fromStdString(payload["method"]);
-    qDebug() << "< payload " << QString::fromStdString(payload.dump());
+    // Only the method, the params can have private keys and memos in them
+    LOG_DEBUG("RPC", {{"method", QString::fromStdString(payload["method"])}});
 
     QNetworkReply *reply = restclient->post(*request, QByteArray::fromStdString(payload.dump()));
 
+    // Spans the time the call is waiting on the node
+    QByteArray traceName;
+    quint64    traceId = 0;
+    if (Trace::isEnabled()) {
+        traceName = QByteArray::fromStdString(payload["method"].get<json::string_t>());
+        traceId   = Trace::asyncBegin(traceName, "rpc");
+    }
+
     QObject::connect(reply, &QNetworkReply::finished, [=] {
         reply->deleteLater();
+        Trace::asyncEnd(traceName, "rpc", traceId);
         if (shutdownInProgress) {
             // Ignoring callback because shutdown in progress
             return;
         }
         
+        TRACE_SPAN("Connection::doRPC reply", "rpc");
         if (reply->error() != QNetworkReply::NoError) {
-	    qDebug() << "RPC error detected: " << reply->readAll();
+            LOG_WARNING("RPC error", {{"method", QString::fromStdString(payload["method"])}, {"error", reply->errorString()}});
             auto parsed = json::parse(reply->readAll(), nullptr, false);
             ne(reply, parsed);
             
             return;
         } 
 	//qDebug() << "about to parse RPC response";
-        auto parsed = json::parse(reply->readAll(), nullptr, false);
+        json parsed;
+        {
+            TRACE_SPAN("json parse", "rpc");
+            parsed = json::parse(reply->readAll(), nullptr, false);
+        }
 	//qDebug() << "response=" << reply->readAll();
         if (parsed.is_discarded()) {
             ne(reply, "Unknown error");
@@ -756,6 +770,11 @@ void Connection::doRPCIgnoreError(const json& payload, const std::function<void(
 void Connection::showTxError(const QString& error) {
     if (error.isNull()) return;
 
+    // Times the dialog in the trace. Its nested event loop keeps the watchdog's heartbeat going, so the
+    // dialog itself is never a stall, and a stall in an event handled inside it isn't blamed on this span.
+    TRACE_SPAN("Connection::showTxError");
+    TraceNestedLoop nestedLoop;
+
     // Prevent multiple dialog boxes from showing, because they're all called async
     static bool shown = false;
     if (shown)
@@ -4,6 +4,7 @@
 #include "mainwindow.h"
 #include "ui_connection.h"
 #include "precompiled.h"
+#include "trace.h"
 
 using json = nlohmann::json;
 
@@ -118,6 +119,14 @@ public:
         static QMap<QString, bool> inProgress;
 
         QString method = QString::fromStdString(payloadGenerator(payloads[0])["method"]);
+
+        // Spans the whole batch, until the callback gets all the responses
+        QByteArray traceName;
+        quint64    traceId = 0;
+        if (Trace::isEnabled()) {
+            traceName = "batch " + method.toUtf8();
+            traceId   = Trace::asyncBegin(traceName, "rpc");
+        }
         //if (inProgress.value(method, false)) {
         //    qDebug() << "In progress batch, skipping";
         //    return;
@@ -136,6 +145,7 @@ public:
                     return;
                 }
                 
+                TRACE_SPAN("Connection::doBatchRPC reply", "rpc");
                 auto all = reply->readAll();            
                 auto parsed = json::parse(all.toStdString(), nullptr, false);
 
@@ -166,7 +176,9 @@ public:
             if (responses->size() == totalSize) {
 
                 waitTimer->stop();
-                
+                Trace::asyncEnd(traceName, "rpc", traceId);
+
+                TRACE_SPAN("Connection::doBatchRPC callback", "rpc");
                 cb(responses);
                 inProgress[method] = false;
 
@@ -176,6 +188,66 @@ public:
         waitTimer->start(100);    
     }
 
+    // Like doBatchRPC, but all the calls go to komodod as one JSON-RPC batch in a single request, so a
+    // long list of small calls costs one round trip. A call that failed gets an empty object.
+    template<class T>
+    void doBatchRPCInOneRequest(const QList<T>& items,
+                                std::function<json(T)> payloadGenerator,
+                                std::function<void(QMap<T, json>*)> cb) {
+        if (items.isEmpty())
+            return;
+
+        // The replies can come back in any order, so each call's id is its index
+        json batch = json::array();
+        for (int i = 0; i < items.size(); i++) {
+            json payload  = payloadGenerator(items[i]);
+            payload["id"] = i;
+            batch.push_back(payload);
+        }
+
+        QByteArray traceName;
+        quint64    traceId = 0;
+        if (Trace::isEnabled()) {
+            traceName = "batch " + QByteArray::fromStdString(batch[0]["method"].get<json::string_t>());
+            traceId   = Trace::asyncBegin(traceName, "rpc");
+        }
+
+        QNetworkReply *reply = restclient->post(*request, QByteArray::fromStdString(batch.dump()));
+
+        QObject::connect(reply, &QNetworkReply::finished, [=] {
+            reply->deleteLater();
+            Trace::asyncEnd(traceName, "rpc", traceId);
+            if (shutdownInProgress) {
+                // Ignoring callback because shutdown in progress
+                return;
+            }
+
+            TRACE_SPAN("Connection::doBatchRPCInOneRequest reply", "rpc");
+            auto parsed = json::parse(reply->readAll().toStdString(), nullptr, false);
+            if (reply->error() != QNetworkReply::NoError || !parsed.is_array()) {
+                LOG_WARNING("RPC batch error", {{"method", QString::fromStdString(batch[0]["method"])}, 
+                                                {"error", reply->errorString()}});
+            }
+
+            auto responses = new QMap<T, json>();
+            for (const auto& item : items)
+                (*responses)[item] = json::object();
+
+            if (reply->error() == QNetworkReply::NoError && parsed.is_array()) {
+                for (auto& r : parsed) {
+                    if (!r.is_object() || !r["id"].is_number_integer() || !r["error"].is_null())
+                        continue;
+
+                    int i = r["id"].get<int>();
+                    if (i >= 0 && i < items.size())
+                        (*responses)[items[i]] = r["result"];
+                }
+            }
+
+            cb(responses);
+        });
+    }
+
 private:
     bool shutdownInProgress = false;    
 };
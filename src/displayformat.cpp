@@ -0,0 +1,65 @@
+#include "displayformat.h"
+#include "settings.h"
+
+DisplayFormat& DisplayFormat::decimal(Amount amt) {
+    Q_ASSERT(len + Amount::MaxChars <= Capacity);
+    len += amt.format(buf + len);
+    return *this;
+}
+
+DisplayFormat& DisplayFormat::coins(Amount amt) {
+    decimal(amt);
+    buf[len++] = ' ';
+    return latin1(Settings::getInstance()->getTokenNameLatin1());
+}
+
+DisplayFormat& DisplayFormat::fiat(Amount amt, double price) {
+    Q_ASSERT(len + 32 <= Capacity);
+    len += writeFiat(buf + len, amt, price);
+    return *this;
+}
+
+DisplayFormat& DisplayFormat::latin1(const char* s) {
+    while (*s && len < Capacity) {
+        buf[len++] = *s++;
+    }
+    return *this;
+}
+
+int DisplayFormat::writeFiat(char* out, Amount amt, double price) {
+    // Clamp to what fits in an int64 number of cents. No wallet will get anywhere close.
+    double value = amt.toDouble() * price * 100.0;
+    if (!(value > -9.0e15)) value = -9.0e15;
+    if (!(value <  9.0e15)) value =  9.0e15;
+
+    qint64 cents = std::llround(value);
+    int    n     = 0;
+
+    out[n++] = '$';
+    if (cents < 0) {
+        out[n++] = '-';
+        cents = -cents;
+    }
+
+    // Dollars are written backwards, with a separator after every 3 digits, and then copied in order
+    qint64 dollars = cents / 100;
+    char   tmp[24];
+    int    t      = 0;
+    int    digits = 0;
+    do {
+        if (digits > 0 && digits % 3 == 0)
+            tmp[t++] = ',';
+        tmp[t++] = (char)('0' + (dollars % 10));
+        dollars /= 10;
+        digits++;
+    } while (dollars > 0);
+
+    while (t > 0)
+        out[n++] = tmp[--t];
+
+    out[n++] = '.';
+    out[n++] = (char)('0' + (cents % 100) / 10);
+    out[n++] = (char)('0' + (cents % 10));
+
+    return n;
+}
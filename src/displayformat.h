@@ -0,0 +1,42 @@
+#ifndef DISPLAYFORMAT_H
+#define DISPLAYFORMAT_H
+
+#include "precompiled.h"
+#include "amount.h"
+
+/**
+ * Fixed size text buffer used to build the amount strings shown in the tables and combo boxes.
+ *
+ * Each piece (the coin amount, the token name, the fiat value with its thousands separators) is written
+ * straight into the buffer in a single pass, and the only allocation is the final QString. Lives on
+ * the stack, so a formatting call never touches the heap until it returns.
+ */
+class DisplayFormat
+{
+public:
+    // Room for the longest "<amount> <token> ($<fiat>)" string
+    static const int Capacity = 96;
+
+    DisplayFormat() = default;
+
+    DisplayFormat& decimal(Amount amt);
+    DisplayFormat& coins(Amount amt);                   // "1.5 THC"
+    DisplayFormat& fiat(Amount amt, double price);      // "$1,234.56"
+    DisplayFormat& latin1(const char* s);
+
+    int         size() const        { return len; }
+    const char* data() const        { return buf; }
+    void        clear()             { len = 0; }
+
+    QString     toString() const    { return QString::fromLatin1(buf, len); }
+
+    // Write the fiat value of amt in dollars, with thousands separators and 2 decimals. Returns the
+    // number of chars written, which is at most 32.
+    static int  writeFiat(char* out, Amount amt, double price);
+
+private:
+    char    buf[Capacity];
+    int     len = 0;
+};
+
+#endif // DISPLAYFORMAT_H
@@ -0,0 +1,399 @@
+#include "invoicestore.h"
+#include "settings.h"
+
+InvoiceStore* InvoiceStore::instance = nullptr;
+
+InvoiceStore* InvoiceStore::getInstance() {
+    if (instance == nullptr)
+        instance = new InvoiceStore();
+
+    return instance;
+}
+
+QDataStream &operator<<(QDataStream& ds, const InvoicePayment& p) {
+    return ds << p.txid << (qint32)p.vout << p.amount.toZats() << p.seen << (qint32)p.height;
+}
+
+QDataStream &operator>>(QDataStream& ds, InvoicePayment& p) {
+    qint32 vout;
+    qint64 zats;
+    qint32 height;
+    ds >> p.txid >> vout >> zats >> p.seen >> height;
+    p.vout   = vout;
+    p.amount = Amount::fromZats(zats);
+    p.height = height;
+    return ds;
+}
+
+QDataStream &operator<<(QDataStream& ds, const Invoice& inv) {
+    return ds << QString("v1") << inv.address << inv.amount.toZats() << inv.created << inv.expires
+              << inv.description << inv.label << (qint32)inv.minConfirmations << inv.cancelled
+              << inv.payments << (quint8)inv.state;
+}
+
+QDataStream &operator>>(QDataStream& ds, Invoice& inv) {
+    QString version;
+    qint64  zats;
+    qint32  minConfirmations;
+    quint8  state;
+    ds >> version >> inv.address >> zats >> inv.created >> inv.expires
+       >> inv.description >> inv.label >> minConfirmations >> inv.cancelled
+       >> inv.payments >> state;
+    inv.amount           = Amount::fromZats(zats);
+    inv.minConfirmations = minConfirmations;
+    inv.state            = (InvoiceState)state;
+    return ds;
+}
+
+Amount Invoice::received() const {
+    Amount sum;
+    for (const auto& p : payments)
+        sum += p.amount;
+    return sum;
+}
+
+QString Invoice::paymentURI() const {
+    QString uri = "thc:" % address;
+
+    QStringList params;
+    if (amount.isPositive())
+        params.push_back("amt=" % amount.toDecimalString());
+    if (!description.isEmpty())
+        params.push_back("memo=" % QString::fromLatin1(QUrl::toPercentEncoding(description)));
+
+    return params.isEmpty() ? uri : uri % "?" % params.join("&");
+}
+
+InvoiceState Invoice::stateAt(qint64 now, int blockNumber) const {
+    if (cancelled)
+        return InvoiceState::Cancelled;
+
+    // Only what came in before it expired counts towards paying it
+    Amount inTime;
+    bool   confirmed = true;
+    for (const auto& p : payments) {
+        if (expires != 0 && p.seen > expires)
+            continue;
+
+        inTime += p.amount;
+        if (p.height == 0 || blockNumber - p.height + 1 < minConfirmations)
+            confirmed = false;
+    }
+
+    bool covered = amount.isPositive() ? inTime >= amount : inTime.isPositive();
+    if (covered) {
+        if (!confirmed)
+            return InvoiceState::Paid;
+
+        return amount.isPositive() && received() > amount ? InvoiceState::Overpaid : InvoiceState::Confirmed;
+    }
+
+    if (expires != 0 && now > expires)
+        return InvoiceState::Expired;
+
+    return inTime.isPositive() ? InvoiceState::PartiallyPaid : InvoiceState::Open;
+}
+
+// Nothing more can change about it, except late payments being recorded
+bool Invoice::isFinal() const {
+    return state == InvoiceState::Confirmed || state == InvoiceState::Overpaid ||
+           state == InvoiceState::Expired   || state == InvoiceState::Cancelled;
+}
+
+InvoiceStore::InvoiceStore() {
+    expiryTimer.setSingleShot(true);
+    QObject::connect(&expiryTimer, &QTimer::timeout, [=] () {
+        reconcile(QSet<QString>());
+    });
+}
+
+QString InvoiceStore::stateName(InvoiceState state) {
+    switch (state) {
+    case InvoiceState::Open:            return tr("Open");
+    case InvoiceState::PartiallyPaid:   return tr("Partially paid");
+    case InvoiceState::Paid:            return tr("Paid, confirming");
+    case InvoiceState::Confirmed:       return tr("Paid");
+    case InvoiceState::Overpaid:        return tr("Overpaid");
+    case InvoiceState::Expired:         return tr("Expired");
+    case InvoiceState::Cancelled:       return tr("Cancelled");
+    }
+    return QString();
+}
+
+// Load the invoices for the current network, if they aren't already. The indexes and the queues are only
+// built here, after that they're kept up to date as the invoices change.
+void InvoiceStore::load() {
+    auto t = WalletStore::getInstance()->table(QStringLiteral("invoices"));
+    if (t == table)
+        return;
+
+    table = t;
+    invoices.clear();
+    byAddress.clear();
+    openAddrs.clear();
+    confirmQueue.clear();
+    expiryQueue.clear();
+
+    // Each invoice is stored under its id
+    for (auto it = table->all().constBegin(); it != table->all().constEnd(); it++) {
+        QDataStream in(it.value());
+        Invoice inv;
+        in >> inv;
+        inv.id = QString::fromUtf8(it.key());
+
+        invoices.insert(inv.id, inv);
+        byAddress.insert(inv.address, inv.id);
+        updateOpen(inv);
+        schedule(inv);
+    }
+
+    armExpiryTimer();
+}
+
+void InvoiceStore::save(const Invoice& inv) {
+    QByteArray value;
+    QDataStream out(&value, QIODevice::WriteOnly);
+    out << inv;
+
+    table->put(inv.id.toUtf8(), value);
+}
+
+// Queue the invoice for its next look, if anything about it can still change by itself
+void InvoiceStore::schedule(const Invoice& inv) {
+    if (inv.isFinal())
+        return;
+
+    if (inv.state == InvoiceState::Paid) {
+        // Once every payment is mined, the block it'll have enough confirmations at is known. Until then
+        // it comes up again with the delta for the payment's confirmation.
+        int due = 0;
+        for (const auto& p : inv.payments) {
+            if (inv.expires != 0 && p.seen > inv.expires)
+                continue;
+            if (p.height == 0)
+                return;
+            due = qMax(due, p.height + inv.minConfirmations - 1);
+        }
+        confirmQueue.insert(due, inv.id);
+    } else if (inv.expires != 0) {
+        expiryQueue.insert(inv.expires, inv.id);
+    }
+}
+
+void InvoiceStore::updateOpen(const Invoice& inv) {
+    if (inv.isFinal())
+        openAddrs.remove(inv.address);
+    else
+        openAddrs.insert(inv.address);
+}
+
+void InvoiceStore::armExpiryTimer() {
+    if (expiryQueue.isEmpty()) {
+        expiryTimer.stop();
+        return;
+    }
+
+    // Once a minute at the most, the next refresh picks it up otherwise
+    qint64 wait = expiryQueue.firstKey() - QDateTime::currentSecsSinceEpoch() + 1;
+    expiryTimer.start((int)qBound((qint64)1, wait, (qint64)60) * 1000);
+}
+
+Invoice InvoiceStore::create(const QString& address, Amount amount, qint64 expiresIn, const QString& description,
+                             const QString& label, int minConfirmations) {
+    load();
+
+    // A random id, so it can be handed out without giving away how many invoices there are
+    unsigned char bytes[8];
+    randombytes_buf(bytes, sizeof(bytes));
+
+    Invoice inv;
+    inv.id               = QByteArray((const char*)bytes, sizeof(bytes)).toHex();
+    inv.address          = address;
+    inv.amount           = amount;
+    inv.created          = QDateTime::currentSecsSinceEpoch();
+    inv.expires          = expiresIn > 0 ? inv.created + expiresIn : 0;
+    inv.description      = description;
+    inv.label            = label;
+    inv.minConfirmations = qMax(1, minConfirmations);
+
+    invoices.insert(inv.id, inv);
+    byAddress.insert(inv.address, inv.id);
+    updateOpen(inv);
+    save(inv);
+    schedule(inv);
+    armExpiryTimer();
+
+    emit changed(inv.id, inv.state);
+    return inv;
+}
+
+bool InvoiceStore::cancel(const QString& id) {
+    load();
+
+    auto it = invoices.find(id);
+    if (it == invoices.end() || it->isFinal())
+        return false;
+
+    it->cancelled = true;
+    it->state     = InvoiceState::Cancelled;
+    updateOpen(*it);
+    save(*it);
+
+    emit changed(id, it->state);
+    return true;
+}
+
+QList<Invoice> InvoiceStore::getAll() {
+    load();
+
+    QList<Invoice> all = invoices.values();
+    std::sort(all.begin(), all.end(), [] (const Invoice& a, const Invoice& b) {
+        return a.created > b.created;
+    });
+    return all;
+}
+
+bool InvoiceStore::get(const QString& id, Invoice& out) {
+    load();
+
+    auto it = invoices.constFind(id);
+    if (it == invoices.constEnd())
+        return false;
+
+    out = *it;
+    return true;
+}
+
+QList<QString> InvoiceStore::openAddresses() {
+    load();
+
+    return openAddrs.toList();
+}
+
+// Pick the payments to invoice addresses out of a refresh's deltas. Each delta is one lookup in the
+// address index, and the invoices that aren't paid to are never touched.
+void InvoiceStore::applyChanges(const WalletChangeSet& changes) {
+    load();
+
+    int    blockNumber = Settings::getInstance()->getBlockNumber();
+    qint64 now         = QDateTime::currentSecsSinceEpoch();
+
+    // Whether the output is still in the wallet, spent or not, as far as this refresh knows
+    auto stillUnspent = [&] (const WalletDelta& d) {
+        for (const auto& u : changes.to->utxos) {
+            if (u.txid == d.txid && u.vout == d.vout && u.address == d.address)
+                return true;
+        }
+        return false;
+    };
+
+    QSet<QString> touched;
+    for (const auto& d : changes.deltas) {
+        bool received = d.list == WalletTxList::ZReceived || (d.list == WalletTxList::Transparent && d.txType == "receive");
+        bool incoming = d.type == WalletDelta::UtxoConfirmed ||
+                        ((d.type == WalletDelta::TxInserted || d.type == WalletDelta::ConfirmationsAdvanced ||
+                          d.type == WalletDelta::TxRemoved) && received);
+        if (!incoming)
+            continue;
+
+        auto id = byAddress.constFind(d.address);
+        if (id == byAddress.constEnd())
+            continue;
+
+        Invoice& inv = invoices[id.value()];
+
+        // Each output is its own payment, so a tx paying the same amount twice counts twice
+        int i = 0;
+        while (i < inv.payments.size() && (inv.payments.at(i).txid != d.txid || inv.payments.at(i).vout != d.vout))
+            i++;
+
+        if (d.type == WalletDelta::TxRemoved) {
+            // The transparent list only holds the latest txs, so dropping out of it is normal. The payment is only
+            // dropped if it didn't have its confirmations yet and its output is gone too, ie. it was evicted or
+            // reorged out. If it comes back, it's recorded again.
+            if (i == inv.payments.size() || inv.isFinal())
+                continue;
+
+            const auto& p = inv.payments.at(i);
+            if ((p.height != 0 && blockNumber - p.height + 1 >= inv.minConfirmations) || stillUnspent(d))
+                continue;
+
+            inv.payments.removeAt(i);
+            touched.insert(inv.id);
+            continue;
+        }
+
+        if (i == inv.payments.size()) {
+            // Only a new tx in a list is a new payment, the UTXO and confirmation deltas just update one
+            if (d.type != WalletDelta::TxInserted || !d.newAmount.isPositive())
+                continue;
+
+            // Whether it was in time goes by the tx's own time, not when the wallet got to see it, which can be
+            // much later if the wallet wasn't running
+            InvoicePayment p;
+            p.txid   = d.txid;
+            p.vout   = d.vout;
+            p.amount = d.newAmount;
+            p.seen   = d.datetime > 0 ? d.datetime : now;
+            inv.payments.push_back(p);
+        }
+
+        // Work out the block it was mined in, so its confirmations keep counting up even after the tx drops
+        // out of the lists or the output is spent. The lists' confirmations always win, so a payment that was
+        // reorged into another block, or back into the mempool, gets its new height.
+        auto& p = inv.payments[i];
+        if (blockNumber > 0) {
+            if (d.type == WalletDelta::UtxoConfirmed) {
+                if (p.height == 0)
+                    p.height = blockNumber;
+            } else {
+                p.height = d.newConfirmations > 0 ? blockNumber - (int)d.newConfirmations + 1 : 0;
+            }
+        }
+
+        touched.insert(inv.id);
+    }
+
+    reconcile(touched);
+}
+
+// Re-check the given invoices, and the ones whose confirmations or expiry are due
+void InvoiceStore::reconcile(const QSet<QString>& ids) {
+    load();
+
+    int    blockNumber = Settings::getInstance()->getBlockNumber();
+    qint64 now         = QDateTime::currentSecsSinceEpoch();
+
+    QSet<QString> due = ids;
+    while (!confirmQueue.isEmpty() && confirmQueue.firstKey() <= blockNumber)
+        due.insert(confirmQueue.take(confirmQueue.firstKey()));
+    while (!expiryQueue.isEmpty() && expiryQueue.firstKey() < now)
+        due.insert(expiryQueue.take(expiryQueue.firstKey()));
+
+    if (!due.isEmpty())
+        table->beginBatch();
+
+    for (const auto& id : due) {
+        auto it = invoices.find(id);
+        if (it == invoices.end())
+            continue;
+
+        auto state = it->stateAt(now, blockNumber);
+        bool moved = state != it->state;
+        it->state  = state;
+        updateOpen(*it);
+
+        // Payments were recorded even if the state stays the same, so it's always written. A paid invoice's
+        // due block may have moved with a new payment, so it's queued again too.
+        save(*it);
+        if (moved || state == InvoiceState::Paid)
+            schedule(*it);
+
+        emit changed(id, state);
+    }
+
+    if (!due.isEmpty())
+        table->commit();
+
+    armExpiryTimer();
+}
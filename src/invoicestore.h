@@ -0,0 +1,121 @@
+#ifndef INVOICESTORE_H
+#define INVOICESTORE_H
+
+#include "precompiled.h"
+#include "amount.h"
+#include "walletstore.h"
+#include "walletdiff.h"
+
+enum class InvoiceState : quint8 {
+    Open = 0,
+    PartiallyPaid,
+    Paid,               // The whole amount came in, but doesn't have enough confirmations yet
+    Confirmed,
+    Overpaid,           // Confirmed, with more than the amount. The difference may need to be refunded.
+    Expired,            // Not fully paid before it expired
+    Cancelled
+};
+
+// One output of a tx paying into an invoice's address
+struct InvoicePayment {
+    QString txid;
+    int     vout        = -1;
+    Amount  amount;
+    qint64  seen        = 0;    // The tx's time, secs since epoch
+    int     height      = 0;    // Block it was mined in, 0 while unconfirmed
+};
+
+struct Invoice {
+    QString         id;
+    QString         address;            // Each invoice gets its own receiving address
+    Amount          amount;             // Zero for "any amount"
+    qint64          created             = 0;
+    qint64          expires             = 0;    // Secs since epoch, 0 if it never expires
+    QString         description;        // Goes into the memo of the payment URI
+    QString         label;              // For the merchant, eg. an order number. Not shown to the payer.
+    int             minConfirmations    = 1;
+    bool            cancelled           = false;
+
+    QList<InvoicePayment> payments;
+    InvoiceState    state               = InvoiceState::Open;
+
+    // Everything that came in, including payments made after it expired
+    Amount          received() const;
+    QString         paymentURI() const;
+
+    InvoiceState    stateAt(qint64 now, int blockNumber) const;
+    bool            isFinal() const;
+};
+
+/**
+ * The wallet's invoices, and which of them have been paid.
+ *
+ * Every invoice has its own receiving address, so an incoming payment is matched to its invoice with one
+ * lookup in an address index. Payments are picked up from the change set of each refresh, and an invoice
+ * is only looked at again when a payment for it comes in, when it is due to reach its confirmations (kept
+ * in a queue ordered by block) or when it expires (kept in a queue ordered by time). So a refresh costs
+ * the same no matter how many invoices are open.
+ *
+ * A payment is one output of a tx, so two equal outputs of the same tx count twice. A payment that drops out
+ * of the wallet before it has its confirmations (evicted from the mempool, or reorged out) is dropped again.
+ *
+ * Invoices are kept in the "invoices" wallet table, and written through on every change.
+ *
+ * Shielded payments are seen through the received z-tx list. With "save z-txs" off that list only covers
+ * the addresses of open invoices, so a payment that comes in after an invoice is final (eg. expired) is
+ * only recorded while the setting is on.
+ */
+class InvoiceStore : public QObject
+{
+    Q_OBJECT
+public:
+    static InvoiceStore* getInstance();
+
+    Invoice         create(const QString& address, Amount amount, qint64 expiresIn, const QString& description,
+                           const QString& label, int minConfirmations = defaultConfirmations);
+    bool            cancel(const QString& id);
+
+    // Newest first
+    QList<Invoice>  getAll();
+    bool            get(const QString& id, Invoice& out);
+
+    void            applyChanges(const WalletChangeSet& changes);
+
+    // The addresses of the invoices that can still be paid. When shielded txs aren't saved, the received
+    // txs are only listed for these, so the invoices still see their payments. Kept as an index, so this
+    // doesn't look at the other invoices.
+    QList<QString>  openAddresses();
+
+    static QString  stateName(InvoiceState state);
+
+    static const int defaultConfirmations = 2;
+
+signals:
+    void            changed(const QString& id, InvoiceState state);
+
+private:
+    InvoiceStore();
+
+    void            load();
+    void            save(const Invoice& inv);
+    void            schedule(const Invoice& inv);
+    void            updateOpen(const Invoice& inv);
+    void            reconcile(const QSet<QString>& ids);
+    void            armExpiryTimer();
+
+    static InvoiceStore*        instance;
+
+    WalletTable*                table = nullptr;
+    QHash<QString, Invoice>     invoices;       // By id
+    QHash<QString, QString>     byAddress;      // Receiving address -> invoice id
+    QSet<QString>               openAddrs;      // Addresses of the invoices that aren't final
+
+    // Invoices that need another look once the chain or the clock gets there. Entries can be stale, an
+    // invoice is just re-checked when it comes up.
+    QMultiMap<int, QString>     confirmQueue;   // By block
+    QMultiMap<qint64, QString>  expiryQueue;    // By time
+
+    QTimer                      expiryTimer;
+};
+
+#endif // INVOICESTORE_H
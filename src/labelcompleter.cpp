@@ -0,0 +1,133 @@
+#include "labelcompleter.h"
+#include "addressbook.h"
+
+int LabelIndex::lowerBound(const QString& lower) const {
+    auto it = std::lower_bound(entries.begin(), entries.end(), lower, [] (const Entry& e, const QString& s) {
+        return e.lower < s;
+    });
+    return (int)(it - entries.begin());
+}
+
+void LabelIndex::insert(const QString& label, const QString& address) {
+    QString text = label % "/" % address;
+    QString lower = text.toLower();
+
+    int pos = lowerBound(lower);
+    if (pos < entries.size() && entries.at(pos).text == text)
+        return;
+
+    entries.insert(pos, Entry{ lower, text });
+}
+
+void LabelIndex::remove(const QString& label, const QString& address) {
+    QString text = label % "/" % address;
+    QString lower = text.toLower();
+
+    // Entries that differ only in case sort next to each other
+    for (int pos = lowerBound(lower); pos < entries.size() && entries.at(pos).lower == lower; pos++) {
+        if (entries.at(pos).text == text) {
+            entries.remove(pos);
+            return;
+        }
+    }
+}
+
+void LabelIndex::reset(const QList<QPair<QString, QString>>& labels) {
+    entries.clear();
+    entries.reserve(labels.size());
+    for (const auto& item : labels) {
+        QString text = item.first % "/" % item.second;
+        entries.push_back(Entry{ text.toLower(), text });
+    }
+
+    std::sort(entries.begin(), entries.end(), [] (const Entry& a, const Entry& b) {
+        return a.lower < b.lower;
+    });
+}
+
+bool LabelIndex::fuzzyMatch(const QString& text, const QString& lower) {
+    int i = 0;
+    for (QChar c : lower) {
+        if (c == text.at(i) && ++i == text.size())
+            return true;
+    }
+    return false;
+}
+
+QStringList LabelIndex::match(const QString& text, int modes, int limit) const {
+    QStringList matches;
+    QString     query = text.trimmed().toLower();
+    if (query.isEmpty() || limit <= 0)
+        return matches;
+
+    QVector<bool> used;
+
+    // Prefix matches are a contiguous run in the sorted entries
+    if (modes & Prefix) {
+        used.resize(entries.size());
+        for (int i = lowerBound(query); i < entries.size() && matches.size() < limit; i++) {
+            if (!entries.at(i).lower.startsWith(query))
+                break;
+
+            matches.push_back(entries.at(i).text);
+            used[i] = true;
+        }
+    }
+
+    // The rest have to look at every entry, so they only run until there are enough matches
+    auto fnScan = [&] (auto fnMatches) {
+        if (used.size() != entries.size())
+            used.resize(entries.size());
+
+        for (int i = 0; i < entries.size() && matches.size() < limit; i++) {
+            if (!used.at(i) && fnMatches(entries.at(i).lower)) {
+                matches.push_back(entries.at(i).text);
+                used[i] = true;
+            }
+        }
+    };
+
+    if ((modes & Substring) && matches.size() < limit)
+        fnScan([&] (const QString& lower) { return lower.contains(query); });
+
+    if ((modes & Fuzzy) && matches.size() < limit && query.size() > 1)
+        fnScan([&] (const QString& lower) { return fuzzyMatch(query, lower); });
+
+    return matches;
+}
+
+LabelCompleter::LabelCompleter(QObject* parent) : QCompleter(parent) {
+    results = new QStringListModel(this);
+    setModel(results);
+
+    // The results are already filtered, so the popup just shows them all
+    setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    setCaseSensitivity(Qt::CaseInsensitive);
+}
+
+void LabelCompleter::reload() {
+    auto book = AddressBook::getInstance();
+
+    // The address book isn't touched until the first reload, since it can't be read too early at startup
+    if (!following) {
+        following = true;
+
+        QObject::connect(book, &AddressBook::labelAdded, this, [=] (const QString& label, const QString& address) {
+            index.insert(label, address);
+        });
+        QObject::connect(book, &AddressBook::labelRemoved, this, [=] (const QString& label, const QString& address) {
+            index.remove(label, address);
+        });
+        QObject::connect(book, &AddressBook::labelsReset, this, &LabelCompleter::reload);
+    }
+
+    index.reset(book->getAllAddressLabels());
+}
+
+// QCompleter calls this with the text typed so far, before it filters the model. This is where the
+// matches are looked up, so the model only ever holds the results for the current text.
+QStringList LabelCompleter::splitPath(const QString& path) const {
+    results->setStringList(index.match(path, matchModes, maxResults));
+
+    return QCompleter::splitPath(path);
+}
@@ -0,0 +1,73 @@
+#ifndef LABELCOMPLETER_H
+#define LABELCOMPLETER_H
+
+#include "precompiled.h"
+
+/**
+ * The address book labels as "label/address" strings, kept sorted (case insensitively) so that
+ * prefix matches are a binary search. Labels are inserted and removed one at a time as the address
+ * book changes, instead of the whole list being rebuilt.
+ */
+class LabelIndex
+{
+public:
+    enum MatchMode {
+        Prefix      = 1,    // The label starts with the text
+        Substring   = 2,    // The text is anywhere in the label or address
+        Fuzzy       = 4     // The characters of the text appear in order
+    };
+
+    void    insert(const QString& label, const QString& address);
+    void    remove(const QString& label, const QString& address);
+    int     size() const            { return entries.size(); }
+
+    // Replace everything, sorting once instead of inserting one by one
+    void    reset(const QList<QPair<QString, QString>>& labels);
+
+    // Up to limit matches, best first: all the prefix matches, then substring, then fuzzy
+    QStringList match(const QString& text, int modes, int limit) const;
+
+private:
+    struct Entry {
+        QString lower;      // What is matched against
+        QString text;       // What is shown
+    };
+
+    int     lowerBound(const QString& lower) const;
+
+    static bool fuzzyMatch(const QString& text, const QString& lower);
+
+    QVector<Entry>  entries;
+};
+
+/**
+ * Completer for the address fields, matching the typed text against the address book labels.
+ *
+ * QCompleter's own filtering scans every row on each keystroke. This one looks up a short list of
+ * matches in a LabelIndex instead, and shows just those. It follows the address book's changes, so
+ * one instance is shared by all the address fields.
+ */
+class LabelCompleter : public QCompleter
+{
+    Q_OBJECT
+public:
+    explicit LabelCompleter(QObject* parent = nullptr);
+
+    // Read in all the labels from the address book again
+    void reload();
+
+    void setMatchModes(int modes)   { matchModes = modes; }
+    void setMaxResults(int max)     { maxResults = max; }
+
+    QStringList splitPath(const QString& path) const override;
+
+private:
+    LabelIndex          index;
+    QStringListModel*   results;
+
+    int                 matchModes  = LabelIndex::Prefix | LabelIndex::Substring | LabelIndex::Fuzzy;
+    int                 maxResults  = 50;
+    bool                following   = false;
+};
+
+#endif // LABELCOMPLETER_H
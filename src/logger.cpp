@@ -1,31 +1,182 @@
 #include "logger.h"
 
-Logger::Logger(QObject *parent, QString fileName) : QObject(parent) {
-    m_showDate = true;
+Logger* Logger::instance = nullptr;
+
+namespace {
+    const char* levelNames[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+}
+
+/**
+ * Drains the logger's ring buffer into the log file.
+ */
+class LogWriter : public QThread {
+public:
+    LogWriter(Logger* l, QString name) : logger(l), fileName(name) {}
+
+    void stop() { stopping.store(true); }
+
+protected:
+    void run() override {
+        openFile();
+
+        Logger::Slot entry;
+        QByteArray   batch;
+        qint64       lastSecond = -1;
+        QByteArray   stamp;
+
+        while (true) {
+            bool last = stopping.load();
+
+            batch.clear();
+            while (logger->tryPop(entry)) {
+                // The date only needs to be formatted again when the second changes
+                qint64 second = entry.time / 1000;
+                if (second != lastSecond) {
+                    lastSecond = second;
+                    stamp = QDateTime::fromMSecsSinceEpoch(entry.time).toString("dd.MM.yyyy hh:mm:ss ").toUtf8();
+                }
+
+                batch.append(stamp);
+                if (entry.level != (int)LogLevel::Info) {
+                    batch.append(levelNames[entry.level]);
+                    batch.append(' ');
+                }
+                batch.append(entry.text.toUtf8());
+                batch.append('\n');
+                entry.text.clear();
+            }
+
+            quint64 dropped = logger->dropped.exchange(0);
+            if (dropped > 0) {
+                batch.append(QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss ").toUtf8());
+                batch.append("WARN Log buffer was full, dropped " + QByteArray::number(dropped) + " lines\n");
+            }
+
+            if (!batch.isEmpty() && file.isOpen()) {
+                file.write(batch);
+                file.flush();
+
+                if (file.size() > Logger::maxFileSize)
+                    rotate();
+            }
+
+            if (last)
+                break;
+
+            msleep(50);
+        }
+
+        file.close();
+    }
+
+private:
+    void openFile() {
+        file.setFileName(fileName);
+        file.open(QIODevice::Append);
+    }
+
+    // HempPAY.log becomes HempPAY.log.1, and so on, and the oldest one is dropped
+    void rotate() {
+        file.close();
+
+        QFile::remove(fileName % "." % QString::number(Logger::maxOldFiles));
+        for (int i = Logger::maxOldFiles - 1; i >= 1; i--) {
+            QFile::rename(fileName % "." % QString::number(i), fileName % "." % QString::number(i + 1));
+        }
+        QFile::rename(fileName, fileName % ".1");
+
+        openFile();
+    }
+
+    Logger*             logger;
+    QString             fileName;
+    QFile               file;
+    std::atomic<bool>   stopping { false };
+};
+
+Logger::Logger(QObject *parent, QString fileName) : QObject(parent), head(0), dropped(0), level((int)LogLevel::Info) {
+    for (quint64 i = 0; i < (quint64)capacity; i++) {
+        ring[i].seq.store(i, std::memory_order_relaxed);
+    }
 
     if (!fileName.isEmpty()) {
-        file = new QFile;
-        file->setFileName(fileName);
-        file->open(QIODevice::Append | QIODevice::Text);
+        writer = new LogWriter(this, fileName);
+        writer->start(QThread::LowPriority);
     }
-    
+
+    instance = this;
     write("=========Startup==========");
 }
 
+Logger::~Logger() {
+    if (instance == this)
+        instance = nullptr;
+
+    // Let the writer get the last lines out
+    if (writer != nullptr) {
+        writer->stop();
+        writer->wait();
+        delete writer;
+    }
+}
+
 void Logger::write(const QString &value) {
-    if (!file)
+    log(LogLevel::Info, value);
+}
+
+void Logger::log(LogLevel l, const QString& message, std::initializer_list<LogField> fields) {
+    if (writer == nullptr || !isEnabled(l))
         return;
-        
-    QString text = value;
-    text = QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss ") + text;
-    QTextStream out(file);
-    out.setCodec("UTF-8");
-    if (file != 0) {
-        out << text << endl;
+
+    QString text = message;
+    for (const auto& f : fields) {
+        text += QLatin1Char(' ') % QLatin1String(f.key) % QLatin1Char('=');
+        if (f.value.contains(QLatin1Char(' ')))
+            text += QLatin1Char('"') % f.value % QLatin1Char('"');
+        else
+            text += f.value;
     }
+
+    // Claim a slot. A slot is free for position pos when its seq is pos; the writer sets that once it
+    // has taken out what was there one lap earlier.
+    quint64 pos = head.load(std::memory_order_relaxed);
+    Slot*   slot;
+    while (true) {
+        slot = &ring[pos & (capacity - 1)];
+        quint64 seq  = slot->seq.load(std::memory_order_acquire);
+        qint64  diff = (qint64)(seq - pos);
+
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // Full. Don't make the caller wait for the disk.
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->time  = QDateTime::currentMSecsSinceEpoch();
+    slot->level = (int)l;
+    slot->text  = text;
+    slot->seq.store(pos + 1, std::memory_order_release);
 }
 
-Logger::~Logger() {
-    if (file != 0)
-        file->close();
-}
\ No newline at end of file
+// Only called from the writer thread
+bool Logger::tryPop(Slot& out) {
+    Slot& slot = ring[tail & (capacity - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != tail + 1)
+        return false;
+
+    out.time  = slot.time;
+    out.level = slot.level;
+    out.text  = std::move(slot.text);
+    slot.text = QString();
+
+    slot.seq.store(tail + capacity, std::memory_order_release);
+    tail++;
+
+    return true;
+}
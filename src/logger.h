@@ -3,21 +3,91 @@
 
 #include "precompiled.h"
 
+enum class LogLevel : int {
+    Debug = 0,
+    Info,
+    Warning,
+    Error
+};
+
+// Anything below this level is compiled out of the LOG_* macros entirely. Set it with
+// DEFINES += HEMPPAY_MIN_LOG_LEVEL=1 to drop the debug logging from a build.
+#ifndef HEMPPAY_MIN_LOG_LEVEL
+#define HEMPPAY_MIN_LOG_LEVEL 0
+#endif
+
+// Extra key/value pairs for a log line, written as key=value after the message
+struct LogField {
+    const char* key;
+    QString     value;
+};
+
+class LogWriter;
+
+/**
+ * Logs to HempPAY.log without blocking the thread doing the logging.
+ *
+ * A log call only formats the message and puts it in a fixed size ring buffer, which any number of
+ * threads can write to without taking a lock. A background thread drains the buffer, formats the
+ * timestamps and writes the lines out in batches. When the file gets too big, it's rotated out to
+ * HempPAY.log.1 and so on. If the writer falls so far behind that the buffer is full, lines are dropped
+ * (and counted) rather than making the caller wait.
+ */
 class Logger : public QObject
 {
-  Q_OBJECT
+    Q_OBJECT
 public:
-  explicit Logger(QObject *parent, QString fileName);
-  ~Logger();
+    explicit Logger(QObject* parent, QString fileName);
+    ~Logger();
 
-private:
-  QFile *file      = nullptr;
-  bool m_showDate;
+    // The logger the main window created, for code that doesn't have access to it. Can be null.
+    static Logger* getInstance()                { return instance; }
+
+    void     setLevel(LogLevel l)               { level.store((int)l, std::memory_order_relaxed); }
+    bool     isEnabled(LogLevel l) const        { return (int)l >= level.load(std::memory_order_relaxed); }
+
+    void     log(LogLevel l, const QString& message, std::initializer_list<LogField> fields = {});
 
-signals:
+    static const int    capacity        = 4096;                 // Lines in the ring buffer, a power of 2
+    static const qint64 maxFileSize     = 5 * 1024 * 1024;
+    static const int    maxOldFiles     = 3;
 
 public slots:
-  void write(const QString &value);
+    void write(const QString &value);
+
+private:
+    friend class LogWriter;
+
+    struct Slot {
+        std::atomic<quint64>    seq;
+        qint64                  time;           // ms since epoch
+        int                     level;
+        QString                 text;
+    };
+
+    bool     tryPop(Slot& out);
+
+    Slot                    ring[capacity];
+    std::atomic<quint64>    head;               // Next position the producers write to
+    quint64                 tail    = 0;        // Next position the writer reads, only used by the writer
+    std::atomic<quint64>    dropped;
+    std::atomic<int>        level;
+
+    LogWriter*              writer  = nullptr;
+
+    static Logger*          instance;
 };
 
-#endif // LOGGER_H
\ No newline at end of file
+#define HEMPPAY_LOG(lvl, ...) \
+    do { \
+        if ((int)(lvl) >= HEMPPAY_MIN_LOG_LEVEL && Logger::getInstance() != nullptr && \
+                Logger::getInstance()->isEnabled(lvl)) \
+            Logger::getInstance()->log(lvl, __VA_ARGS__); \
+    } while (0)
+
+#define LOG_DEBUG(...)      HEMPPAY_LOG(LogLevel::Debug,   __VA_ARGS__)
+#define LOG_INFO(...)       HEMPPAY_LOG(LogLevel::Info,    __VA_ARGS__)
+#define LOG_WARNING(...)    HEMPPAY_LOG(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...)      HEMPPAY_LOG(LogLevel::Error,   __VA_ARGS__)
+
+#endif // LOGGER_H
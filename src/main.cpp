@@ -5,6 +5,8 @@
 #include "rpc.h"
 #include "settings.h"
 #include "turnstile.h"
+#include "trace.h"
+#include "stallwatchdog.h"
 
 #include "version.h"
 
@@ -159,11 +161,31 @@ public:
         QCommandLineOption noembeddedOption(QStringList() << "no-embedded", "Disable embedded komodod");
         parser.addOption(noembeddedOption);
 
+        // Record a Chrome trace of the refreshes and sends, written out on exit
+        QCommandLineOption traceFileOption(QStringList() << "trace-file", "Write a Chrome trace event file on exit", "file");
+        parser.addOption(traceFileOption);
+
+        // Write the event loop stall statistics on exit
+        QCommandLineOption stallReportOption(QStringList() << "stall-report", "Write event loop stall statistics as JSON on exit", "file");
+        parser.addOption(stallReportOption);
+
+        // Print a sheet of QR codes from a file of addresses or URIs, without starting the wallet
+        QCommandLineOption qrSheetOption(QStringList() << "qr-sheet", "Print the addresses or THC URIs in a file as a sheet of QR codes, and exit", "file");
+        parser.addOption(qrSheetOption);
+
+        QCommandLineOption qrSheetOutputOption(QStringList() << "qr-sheet-output", "Where --qr-sheet writes the codes, a .pdf or .png file", "file");
+        parser.addOption(qrSheetOutputOption);
+
         // Positional argument will specify a zcash payment URI
         parser.addPositionalArgument("thcURI", "An optional THC URI to pay");
 
         parser.process(a);
 
+        // Doesn't need the wallet, so it also works while another instance is running
+        if (parser.isSet(qrSheetOption)) {
+            return printQrSheet(parser.value(qrSheetOption), parser.value(qrSheetOutputOption));
+        }
+
         // Check for a positional argument indicating a THC payment URI
         if (a.isSecondary()) {
             if (parser.positionalArguments().length() > 0) {
@@ -173,6 +195,10 @@ public:
             return 0;            
         } 
 
+        if (parser.isSet(traceFileOption)) {
+            Trace::start(parser.value(traceFileOption));
+        }
+
         QCoreApplication::setOrganizationName("Hempcoin");
         QCoreApplication::setApplicationName("HempPAY");
 
@@ -245,7 +271,20 @@ public:
             w->show();
         }
 
-        return QApplication::exec();
+        // Watch for the UI getting stuck. Which span it got stuck in is only tracked when a report was asked for.
+        StallWatchdog::getInstance()->start(parser.isSet(stallReportOption));
+
+        auto ret = QApplication::exec();
+
+        StallWatchdog::getInstance()->stop();
+        StallWatchdog::getInstance()->logSummary();
+        if (parser.isSet(stallReportOption)) {
+            StallWatchdog::getInstance()->writeReport(parser.value(stallReportOption));
+        }
+
+        Trace::stop();
+
+        return ret;
     }
 
     void DispatchToMainThread(std::function<void()> callback)
@@ -281,6 +320,42 @@ public:
     }
 
 private:
+    int printQrSheet(const QString& input, const QString& output) {
+        if (output.isEmpty()) {
+            qDebug() << "--qr-sheet needs a --qr-sheet-output file";
+            return 1;
+        }
+
+        QString error;
+        QList<QrSheetItem> items = QrSheetWriter::readItems(input, error);
+        if (!error.isEmpty() || items.isEmpty()) {
+            qDebug() << "Could not read the codes from" << input << error;
+            return 1;
+        }
+
+        QrSheetOptions options;
+        options.fileName = output;
+        options.format   = QrSheetWriter::formatForFile(output);
+
+        // The writer runs its own thread, so wait for it here and pick up the result directly
+        bool success = false;
+        QrSheetWriter writer(options, items);
+        QObject::connect(&writer, &QrSheetWriter::done, [&] (bool ok, QString err) {
+            success = ok;
+            error   = err;
+        });
+        writer.start();
+        writer.wait();
+
+        if (!success) {
+            qDebug() << "Error printing the QR codes:" << error;
+            return 1;
+        }
+
+        qDebug() << items.size() << "QR codes saved to" << output;
+        return 0;
+    }
+
     MainWindow* w;
 };
 
@@ -1,5 +1,10 @@
 #include "mainwindow.h"
 #include "addressbook.h"
+#include "addresspool.h"
+#include "invoicestore.h"
+#include "payoutengine.h"
+#include "qrcodelabel.h"
+#include "addresslistmodel.h"
 #include "viewalladdresses.h"
 #include "validateaddress.h"
 #include "ui_mainwindow.h"
@@ -19,9 +24,11 @@
 #include "version.h"
 #include "turnstile.h"
 #include "senttxstore.h"
+#include "walletstore.h"
 #include "connection.h"
 #include "requestdialog.h"
 #include "websockets.h"
+#include "txexporter.h"
 
 using json = nlohmann::json;
 
@@ -32,6 +39,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->setupUi(this);
 
     logger = new Logger(this, QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("HempPAY.log"));
+    logger->setLevel((LogLevel)QSettings().value("options/loglevel", (int)LogLevel::Info).toInt());
     qDebug() << "Logging to " << QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("HempPAY.log");
 
     // Status Bar
@@ -61,6 +69,9 @@ MainWindow::MainWindow(QWidget *parent) :
         RequestDialog::showRequestZcash(this);
     });
 
+    // Invoices
+    QObject::connect(ui->actionInvoices, &QAction::triggered, this, &MainWindow::showInvoices);
+
     // Pay URI
     QObject::connect(ui->actionPay_URI, &QAction::triggered, [=] () {
         payZcashURI();
@@ -84,6 +95,12 @@ MainWindow::MainWindow(QWidget *parent) :
     // Validate Address
     QObject::connect(ui->actionValidate_Address, &QAction::triggered, this, &MainWindow::validateAddress);
 
+    // Pay a file of recipients
+    QObject::connect(ui->actionBulk_Payout, &QAction::triggered, this, &MainWindow::bulkPayout);
+
+    // Print a sheet of QR codes
+    QObject::connect(ui->actionPrint_QR_Codes, &QAction::triggered, this, &MainWindow::printQrSheet);
+
     // Connect mobile app
     QObject::connect(ui->actionConnect_Mobile_App, &QAction::triggered, this, [=] () {
         if (rpc->getConnection() == nullptr)
@@ -189,6 +206,9 @@ void MainWindow::closeEvent(QCloseEvent* event) {
 
     s.sync();
 
+    // And the wallet tables, which only sync on a timer
+    WalletStore::getInstance()->sync();
+
     // Let the RPC know to shut down any running service.
     rpc->shutdownZcashd();
 
@@ -295,7 +315,7 @@ void MainWindow::turnstileDoMigration(QString fromAddr) {
     turnstile.msgIcon->setPixmap(icon.pixmap(64, 64));
 
     auto fnGetAllSproutBalance = [=] () {
-        double bal = 0;
+        Amount bal;
         for (auto addr : *rpc->getAllZAddresses()) {
             if (Settings::getInstance()->isSproutAddress(addr)) {
                 bal += rpc->getAllBalances()->value(addr);
@@ -316,7 +336,7 @@ void MainWindow::turnstileDoMigration(QString fromAddr) {
     }
 
     auto fnUpdateSproutBalance = [=] (QString addr) {
-        double bal = 0;
+        Amount bal;
 
         // The currentText contains the balance as well, so strip that.
         if (addr.contains("(")) {
@@ -362,7 +382,7 @@ void MainWindow::turnstileDoMigration(QString fromAddr) {
     QObject::connect(turnstile.privLevel, QOverload<int>::of(&QComboBox::currentIndexChanged), [=] (auto idx) {
         // Update the fees
         turnstile.minerFee->setText(
-            Settings::getZECUSDDisplayFormat(std::get<0>(privOptions[idx]) * Settings::getMinerFee()));
+            Settings::getZECUSDDisplayFormat(Settings::getMinerFee() * std::get<0>(privOptions[idx])));
     });
 
     for (auto i : privOptions) {
@@ -459,6 +479,8 @@ void MainWindow::setupSettingsModal() {
         // Setup save sent check box
         QObject::connect(settings.chkSaveTxs, &QCheckBox::stateChanged, [=](auto checked) {
             Settings::getInstance()->setSaveZtxs(checked);
+            if (!checked)
+                rpc->discardSavedState();
         });
 
         // Setup clear button
@@ -466,7 +488,8 @@ void MainWindow::setupSettingsModal() {
             if (QMessageBox::warning(this, "Clear saved history?",
                 "Shielded z-Address transactions are stored locally in your wallet, outside komodod. You may delete this saved information safely any time for your privacy.\nDo you want to delete the saved shielded transactions now?",
                 QMessageBox::Yes, QMessageBox::Cancel)) {
-                    SentTxStore::deleteHistory();
+                    SentTxStore::getInstance()->deleteHistory();
+                    rpc->discardSavedState();
                     // Reload after the clear button so existing txs disappear
                     rpc->refresh(true);
             }
@@ -653,6 +676,14 @@ void MainWindow::validateAddress() {
     if (!ok)
         return;
 
+    // A mistyped address fails the checksum, so there's no need to ask the node about it
+    if (!Settings::isValidAddress(address.trimmed())) {
+        QMessageBox::warning(this, tr("Invalid Address"),
+            tr("%1 is not a valid address. Please check it for typos.").arg(address.trimmed()),
+            QMessageBox::Ok);
+        return;
+    }
+
     getRPC()->validateAddress(address, [=] (json props) {
         QDialog d(this);
         Ui_ValidateAddress va;
@@ -690,11 +721,15 @@ void MainWindow::postToZBoard() {
         return;
 
     // Fill the from field with sapling addresses.
-    for (auto i = rpc->getAllBalances()->keyBegin(); i != rpc->getAllBalances()->keyEnd(); i++) {
-        if (Settings::getInstance()->isSaplingAddress(*i) && rpc->getAllBalances()->value(*i) > 0) {
-            zb.fromAddr->addItem(*i);
+    QStringList fromAddrs;
+    auto allBalances = rpc->getAllBalances();
+    for (auto it = allBalances->constBegin(); it != allBalances->constEnd(); ++it) {
+        if (it.value().isPositive() && Settings::getInstance()->isSaplingAddress(it.key())) {
+            fromAddrs.push_back(it.key());
         }
     }
+    fromAddrs.sort();
+    zb.fromAddr->addItems(fromAddrs);
 
     QMap<QString, QString> topics;
     // Insert the main topic automatically
@@ -886,24 +921,35 @@ void MainWindow::payZcashURI(QString uri, QString myAddr) {
         return;
     }
 
-    // Now, set the fields on the send tab
+    // Now, set the fields on the send tab, one recipient section per payee
     removeExtraAddresses();
     if (!myAddr.isEmpty()) {
         ui->inputsCombo->setCurrentText(myAddr);
     }
 
-    ui->Address1->setText(paymentInfo.addr);
-    ui->Address1->setCursorPosition(0);
-    ui->Amount1->setText(Settings::getDecimalString(paymentInfo.amt.toDouble()));
-    ui->MemoTxt1->setText(paymentInfo.memo);
+    bool allAmounts = true;
+    for (int i = 0; i < paymentInfo.recipients.size(); i++) {
+        const auto& payee = paymentInfo.recipients.at(i);
+        if (i > 0)
+            addAddressSection();
+
+        auto addr = ui->sendToWidgets->findChild<QLineEdit*>(QString("Address") % QString::number(i+1));
+        addr->setText(payee.addr);
+        addr->setCursorPosition(0);
+        ui->sendToWidgets->findChild<QLineEdit*>(QString("Amount") % QString::number(i+1))
+            ->setText(Settings::getDecimalString(payee.amount));
+        ui->sendToWidgets->findChild<QLabel*>(QString("MemoTxt") % QString::number(i+1))->setText(payee.memo);
+
+        allAmounts = allAmounts && payee.amount.isPositive();
+    }
 
     // And switch to the send tab.
     ui->tabWidget->setCurrentIndex(1);
     raise();
 
-    // And click the send button if the amount is > 0, to validate everything. If everything is OK, it will show the confirm box
+    // And click the send button if every amount is > 0, to validate everything. If everything is OK, it will show the confirm box
     // else, show the error message;
-    if (paymentInfo.amt > 0) {
+    if (allAmounts) {
         sendButton();
     }
 }
@@ -955,24 +1001,570 @@ void MainWindow::importPrivKey() {
 }
 
 /** 
- * Export transaction history into a CSV file
+ * Export transaction history into a CSV or JSON Lines file
  */
 void MainWindow::exportTransactions() {
+    exportTransactionsFor(QString());
+}
+
+void MainWindow::exportTransactionsFor(QString address) {
+    if (!rpc->getConnection())
+        return;
+
     // First, get the export file name
     QString exportName = "thc-transactions-" + QDateTime::currentDateTime().toString("yyyyMMdd") + ".csv";
 
-    QUrl csvName = QFileDialog::getSaveFileUrl(this, 
-            tr("Export transactions"), exportName, "CSV file (*.csv)");
+    QUrl exportUrl = QFileDialog::getSaveFileUrl(this, 
+            tr("Export transactions"), exportName, "CSV file (*.csv);;JSON Lines file (*.jsonl)");
 
-    if (csvName.isEmpty())
+    if (exportUrl.isEmpty())
         return;
 
-    if (!rpc->getTransactionsModel()->exportToCsv(csvName.toLocalFile())) {
-        QMessageBox::critical(this, tr("Error"), 
-            tr("Error exporting transactions, file was not saved"), QMessageBox::Ok);
+    // Optional filters
+    QDialog d(this);
+    d.setWindowTitle(tr("Export transactions"));
+    auto layout = new QFormLayout(&d);
+
+    auto chkDates = new QCheckBox(tr("Only export transactions between"), &d);
+    auto fromDate = new QDateEdit(QDate::currentDate().addMonths(-1), &d);
+    auto toDate   = new QDateEdit(QDate::currentDate(), &d);
+    fromDate->setCalendarPopup(true);
+    toDate->setCalendarPopup(true);
+    fromDate->setEnabled(false);
+    toDate->setEnabled(false);
+    QObject::connect(chkDates, &QCheckBox::toggled, fromDate, &QWidget::setEnabled);
+    QObject::connect(chkDates, &QCheckBox::toggled, toDate, &QWidget::setEnabled);
+
+    auto txtAddress = new QLineEdit(address, &d);
+    txtAddress->setPlaceholderText(tr("All addresses"));
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &d);
+    QObject::connect(buttons, &QDialogButtonBox::accepted, &d, &QDialog::accept);
+    QObject::connect(buttons, &QDialogButtonBox::rejected, &d, &QDialog::reject);
+
+    layout->addRow(chkDates);
+    layout->addRow(tr("From"), fromDate);
+    layout->addRow(tr("To"), toDate);
+    layout->addRow(tr("Address"), txtAddress);
+    layout->addRow(buttons);
+
+    if (d.exec() != QDialog::Accepted)
+        return;
+
+    TxExportOptions options;
+    options.fileName = exportUrl.toLocalFile();
+    options.format   = TxExporter::formatForFile(options.fileName);
+    options.address  = AddressBook::addressFromAddressLabel(txtAddress->text());
+    if (chkDates->isChecked()) {
+        options.fromTime = QDateTime(fromDate->date(), QTime(0, 0, 0)).toSecsSinceEpoch();
+        options.toTime   = QDateTime(toDate->date(), QTime(23, 59, 59)).toSecsSinceEpoch();
     }
+
+    startTransactionExport(options);
+}
+
+// Run the export on a worker thread. The z-transactions are handed over right away, and the complete 
+// t-transaction history is paged from komodod and streamed to the worker as it arrives.
+void MainWindow::startTransactionExport(TxExportOptions options) {
+    auto progress = new QProgressDialog(tr("Exporting transactions..."), tr("Cancel"), 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    QPointer<TxExporter> exporter = new TxExporter(options, this);
+
+    QObject::connect(exporter, &TxExporter::progress, progress, [=] (qint64 rows) {
+        progress->setLabelText(tr("Exported %1 transactions").arg(rows));
+    });
+    QObject::connect(progress, &QProgressDialog::canceled, exporter, &TxExporter::cancel);
+    QObject::connect(exporter, &TxExporter::done, this, [=] (bool success, QString error) {
+        progress->close();
+        progress->deleteLater();
+
+        if (!success && !exporter->isCancelled()) {
+            QMessageBox::critical(this, tr("Error"), 
+                tr("Error exporting transactions, file was not saved") % "\n\n" % error, QMessageBox::Ok);
+        } else if (success) {
+            ui->statusBar->showMessage(tr("Transactions exported to ") % options.fileName, 5 * 1000);
+        }
+    });
+    QObject::connect(exporter, &QThread::finished, exporter, &QObject::deleteLater);
+
+    exporter->addRows(rpc->getTransactionsModel()->getShieldedRows());
+    exporter->start();
+
+    rpc->fetchTransparentHistory(1000, [=] (QList<TransactionItem> page, bool last) {
+        if (exporter.isNull())
+            return;
+
+        exporter->addRows(page);
+        if (last)
+            exporter->endOfInput();
+    }, [=] (QString error) {
+        if (exporter.isNull())
+            return;
+
+        exporter->cancel();
+        QMessageBox::critical(this, tr("Error"), 
+            tr("Error exporting transactions, file was not saved") % "\n\n" % error, QMessageBox::Ok);
+    });
 } 
 
+/**
+ * The list of invoices, with the QR code of the selected one. The list follows the invoices as they're paid.
+ */
+void MainWindow::showInvoices() {
+    QDialog d(this);
+    d.setWindowTitle(tr("Invoices"));
+    Settings::saveRestore(&d);
+
+    auto layout = new QVBoxLayout(&d);
+    auto top    = new QHBoxLayout();
+    layout->addLayout(top);
+
+    auto table = new QTableWidget(0, 6, &d);
+    table->setHorizontalHeaderLabels({ tr("Created"), tr("Label"), tr("Amount"), tr("Received"), tr("Status"), tr("Expires") });
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    top->addWidget(table);
+
+    auto qrcode = new QRCodeLabel(&d);
+    qrcode->setMinimumSize(180, 180);
+    top->addWidget(qrcode);
+
+    auto btnNew     = new QPushButton(tr("New invoice..."), &d);
+    auto btnCopy    = new QPushButton(tr("Copy payment URI"), &d);
+    auto btnCancel  = new QPushButton(tr("Cancel invoice"), &d);
+    auto buttons    = new QDialogButtonBox(QDialogButtonBox::Close, &d);
+    buttons->addButton(btnNew,    QDialogButtonBox::ActionRole);
+    buttons->addButton(btnCopy,   QDialogButtonBox::ActionRole);
+    buttons->addButton(btnCancel, QDialogButtonBox::ActionRole);
+    QObject::connect(buttons, &QDialogButtonBox::rejected, &d, &QDialog::reject);
+    layout->addWidget(buttons);
+
+    auto fnSelected = [=] () {
+        auto row = table->currentRow();
+        return row < 0 ? QString() : table->item(row, 0)->data(Qt::UserRole).toString();
+    };
+
+    auto fnShowSelected = [=] () {
+        Invoice inv;
+        bool found = InvoiceStore::getInstance()->get(fnSelected(), inv);
+        qrcode->setQrcodeString(found ? inv.paymentURI() : QString());
+        btnCopy->setEnabled(found);
+        btnCancel->setEnabled(found && !inv.isFinal());
+    };
+
+    auto fnTime = [] (qint64 secs) {
+        return secs == 0 ? QString() : QDateTime::fromSecsSinceEpoch(secs).toLocalTime().toString(Qt::SystemLocaleShortDate);
+    };
+
+    auto fnReload = [=] () {
+        QString selected = fnSelected();
+        auto invoices    = InvoiceStore::getInstance()->getAll();
+
+        table->setRowCount(invoices.size());
+        for (int row = 0; row < invoices.size(); row++) {
+            const auto& inv = invoices.at(row);
+
+            auto created = new QTableWidgetItem(fnTime(inv.created));
+            created->setData(Qt::UserRole, inv.id);
+            created->setToolTip(inv.address);
+
+            table->setItem(row, 0, created);
+            table->setItem(row, 1, new QTableWidgetItem(inv.label.isEmpty() ? inv.description : inv.label));
+            table->setItem(row, 2, new QTableWidgetItem(inv.amount.isPositive() ? Settings::getZECDisplayFormat(inv.amount) : tr("Any")));
+            table->setItem(row, 3, new QTableWidgetItem(Settings::getZECDisplayFormat(inv.received())));
+            table->setItem(row, 4, new QTableWidgetItem(InvoiceStore::stateName(inv.state)));
+            table->setItem(row, 5, new QTableWidgetItem(inv.expires == 0 ? tr("Never") : fnTime(inv.expires)));
+
+            if (inv.id == selected)
+                table->setCurrentCell(row, 0);
+        }
+
+        fnShowSelected();
+    };
+
+    QObject::connect(table, &QTableWidget::itemSelectionChanged, fnShowSelected);
+    QObject::connect(InvoiceStore::getInstance(), &InvoiceStore::changed, &d, fnReload);
+
+    QObject::connect(btnNew, &QPushButton::clicked, [=, &d] () {
+        newInvoice(&d);
+    });
+    QObject::connect(btnCopy, &QPushButton::clicked, [=] () {
+        Invoice inv;
+        if (InvoiceStore::getInstance()->get(fnSelected(), inv)) {
+            QGuiApplication::clipboard()->setText(inv.paymentURI());
+            ui->statusBar->showMessage(tr("Copied to clipboard"), 3 * 1000);
+        }
+    });
+    QObject::connect(btnCancel, &QPushButton::clicked, [=, &d] () {
+        if (QMessageBox::question(&d, tr("Cancel invoice"), 
+                tr("Cancel this invoice? Payments that still come in are recorded, but it won't be marked as paid."),
+                QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
+            InvoiceStore::getInstance()->cancel(fnSelected());
+        }
+    });
+
+    fnReload();
+    d.exec();
+}
+
+// Ask for the details of a new invoice, and give it an address from the pool
+void MainWindow::newInvoice(QWidget* parent) {
+    if (!rpc->getConnection())
+        return;
+
+    QDialog d(parent);
+    d.setWindowTitle(tr("New invoice"));
+    auto layout = new QFormLayout(&d);
+
+    auto txtAmount = new QLineEdit(&d);
+    txtAmount->setValidator(amtValidator);
+    txtAmount->setPlaceholderText(tr("Any amount"));
+
+    auto txtDescription = new QLineEdit(&d);
+    txtDescription->setPlaceholderText(tr("Shown to the payer, in the memo"));
+    auto txtLabel       = new QLineEdit(&d);
+    txtLabel->setPlaceholderText(tr("eg. an order number, only for you"));
+
+    auto spnHours = new QSpinBox(&d);
+    spnHours->setRange(0, 24 * 90);
+    spnHours->setValue(24);
+    spnHours->setSuffix(tr(" hours"));
+    spnHours->setSpecialValueText(tr("Never"));
+
+    auto spnConfirmations = new QSpinBox(&d);
+    spnConfirmations->setRange(1, 100);
+    spnConfirmations->setValue(InvoiceStore::defaultConfirmations);
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &d);
+    QObject::connect(buttons, &QDialogButtonBox::accepted, &d, &QDialog::accept);
+    QObject::connect(buttons, &QDialogButtonBox::rejected, &d, &QDialog::reject);
+
+    layout->addRow(tr("Amount"), txtAmount);
+    layout->addRow(tr("Description"), txtDescription);
+    layout->addRow(tr("Label"), txtLabel);
+    layout->addRow(tr("Expires after"), spnHours);
+    layout->addRow(tr("Confirmations"), spnConfirmations);
+    layout->addRow(buttons);
+
+    if (d.exec() != QDialog::Accepted)
+        return;
+
+    Amount  amount        = Amount::fromString(txtAmount->text());
+    qint64  expiresIn     = (qint64)spnHours->value() * 60 * 60;
+    QString description   = txtDescription->text();
+    QString label         = txtLabel->text();
+    int     confirmations = spnConfirmations->value();
+
+    rpc->getAddressPool()->take(AddressPool::Sapling, [=] (QString addr) {
+        if (addr.isEmpty()) {
+            QMessageBox::critical(this, tr("Error"), tr("Couldn't create a new address for the invoice"), QMessageBox::Ok);
+            return;
+        }
+
+        InvoiceStore::getInstance()->create(addr, amount, expiresIn, description, label, confirmations);
+    });
+}
+
+/**
+ * Pay every recipient in a CSV file, from the funded addresses picked here. Opening a file that was
+ * paid out before carries on with the recipients that weren't paid yet.
+ */
+void MainWindow::bulkPayout() {
+    if (!rpc->getConnection())
+        return;
+
+    if (payouts != nullptr && payouts->isRunning()) {
+        QMessageBox::information(this, tr("Bulk payout"), 
+            tr("A payout is already running") % "\n\n" % payouts->report(), QMessageBox::Ok);
+        return;
+    }
+
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Payout file"), "", 
+            "CSV file (*.csv);;All files (*)");
+    if (fileName.isEmpty())
+        return;
+
+    QByteArray hash;
+    QString    error;
+    auto rows = PayoutEngine::readFile(fileName, hash, error);
+    if (rows.isEmpty()) {
+        QMessageBox::critical(this, tr("Error"), 
+            tr("Could not read the payout file %1").arg(fileName) % "\n\n" % error, QMessageBox::Ok);
+        return;
+    }
+
+    auto   batches = PayoutEngine::planBatches(rows);
+    Amount fee     = Settings::getMinerFee();
+    Amount total;
+    Amount largest;
+    for (const auto& b : batches) {
+        total  += b.total;
+        largest = std::max(largest, b.total + fee);
+    }
+
+    QDialog d(this);
+    d.setWindowTitle(tr("Bulk payout"));
+    auto layout = new QVBoxLayout(&d);
+
+    auto lblSummary = new QLabel(tr("%1 recipients, %2 in total, in %3 transactions with %4 in fees.")
+        .arg(rows.size()).arg(Settings::getZECDisplayFormat(total)).arg(batches.size())
+        .arg(Settings::getZECDisplayFormat(fee * batches.size())), &d);
+    lblSummary->setWordWrap(true);
+    layout->addWidget(lblSummary);
+
+    auto lblSources = new QLabel(tr("Pay from these addresses. Each one sends a transaction per block, so more addresses pay out faster."), &d);
+    lblSources->setWordWrap(true);
+    layout->addWidget(lblSources);
+
+    // The addresses with enough for the biggest transaction are picked to start with
+    auto list     = new QListWidget(&d);
+    auto snapshot = rpc->getSnapshot();
+    QList<QPair<QString, Amount>> funded;
+    for (auto it = snapshot->balances.constBegin(); it != snapshot->balances.constEnd(); ++it) {
+        if (it.value().isPositive() && !Settings::getInstance()->isSproutAddress(it.key()))
+            funded.push_back(qMakePair(it.key(), it.value()));
+    }
+    std::sort(funded.begin(), funded.end(), [] (const QPair<QString, Amount>& a, const QPair<QString, Amount>& b) {
+        return a.second > b.second;
+    });
+    for (const auto& f : funded) {
+        auto item = new QListWidgetItem(f.first % " (" % Settings::getZECDisplayFormat(f.second) % ")", list);
+        item->setData(Qt::UserRole, f.first);
+        item->setCheckState(f.second >= largest ? Qt::Checked : Qt::Unchecked);
+    }
+    layout->addWidget(list);
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &d);
+    buttons->button(QDialogButtonBox::Ok)->setText(tr("Start payout"));
+    QObject::connect(buttons, &QDialogButtonBox::accepted, &d, &QDialog::accept);
+    QObject::connect(buttons, &QDialogButtonBox::rejected, &d, &QDialog::reject);
+    layout->addWidget(buttons);
+
+    if (d.exec() != QDialog::Accepted)
+        return;
+
+    QStringList sources;
+    for (int i = 0; i < list->count(); i++) {
+        if (list->item(i)->checkState() == Qt::Checked)
+            sources.push_back(list->item(i)->data(Qt::UserRole).toString());
+    }
+
+    if (payouts == nullptr) {
+        payouts = new PayoutEngine(rpc, this);
+
+        QObject::connect(payouts, &PayoutEngine::finished, this, [=] (bool allPaid) {
+            if (allPaid) {
+                QMessageBox::information(this, tr("Bulk payout"), payouts->report(), QMessageBox::Ok);
+            } else {
+                QMessageBox::warning(this, tr("Bulk payout"), 
+                    tr("Not every recipient was paid. Open the same file again to carry on.") % "\n\n" % payouts->report(), 
+                    QMessageBox::Ok);
+            }
+        });
+    }
+
+    if (!payouts->start(fileName, sources, fee, error)) {
+        QMessageBox::critical(this, tr("Error"), tr("Could not start the payout") % "\n\n" % error, QMessageBox::Ok);
+        return;
+    }
+
+    // Not modal, it can take a while. Cancelling stops sending new transactions.
+    QPointer<QProgressDialog> progress = new QProgressDialog(tr("Paying out..."), tr("Stop"), 0, payouts->batchCount(), this);
+    progress->setMinimumDuration(0);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+    progress->setValue(payouts->count(PayoutBatch::Done));
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+
+    QObject::connect(payouts, &PayoutEngine::progress, progress, [=] (int done, int failed, int) {
+        progress->setValue(done);
+        progress->setLabelText(tr("%1 transactions sent, %2 failed, %3 recipients per minute")
+            .arg(done).arg(failed).arg(payouts->throughput(), 0, 'f', 1));
+    });
+    QObject::connect(payouts, &PayoutEngine::finished, progress, &QWidget::close);
+    QObject::connect(progress, &QProgressDialog::canceled, payouts, &PayoutEngine::stop);
+    progress->show();
+
+    ui->statusBar->showMessage(payouts->isResumed() ? tr("Payout resumed") : tr("Payout started"), 5 * 1000);
+}
+
+/**
+ * Print a sheet of QR code stickers, either for a list of addresses or payment URIs from a file, or
+ * for a number of new shielded addresses.
+ */
+void MainWindow::printQrSheet() {
+    QDialog d(this);
+    d.setWindowTitle(tr("Print QR codes"));
+    auto layout = new QFormLayout(&d);
+
+    auto cmbSource = new QComboBox(&d);
+    cmbSource->addItem(tr("Addresses or payment URIs from a file"));
+    cmbSource->addItem(tr("New shielded addresses"));
+
+    auto txtFile   = new QLineEdit(&d);
+    txtFile->setPlaceholderText(tr("One address or URI per line, optionally followed by ,label"));
+    auto btnBrowse = new QPushButton(tr("Browse..."), &d);
+    auto fileRow   = new QHBoxLayout();
+    fileRow->addWidget(txtFile);
+    fileRow->addWidget(btnBrowse);
+    QObject::connect(btnBrowse, &QPushButton::clicked, [=, &d] () {
+        QString fileName = QFileDialog::getOpenFileName(&d, tr("Codes to print"), "", "Text or CSV file (*.txt *.csv);;All files (*)");
+        if (!fileName.isEmpty())
+            txtFile->setText(fileName);
+    });
+
+    auto spnCount  = new QSpinBox(&d);
+    spnCount->setRange(1, 10000);
+    spnCount->setValue(20);
+
+    auto txtAmount = new QLineEdit(&d);
+    txtAmount->setValidator(amtValidator);
+    txtAmount->setPlaceholderText(tr("Any amount"));
+
+    auto txtLabel  = new QLineEdit(&d);
+    txtLabel->setPlaceholderText(tr("eg. Table"));
+
+    auto spnColumns = new QSpinBox(&d);
+    spnColumns->setRange(1, 10);
+    spnColumns->setValue(4);
+    auto spnRows    = new QSpinBox(&d);
+    spnRows->setRange(1, 15);
+    spnRows->setValue(6);
+
+    auto fnSourceChanged = [=] (int index) {
+        bool fromFile = index == 0;
+        txtFile->setEnabled(fromFile);
+        btnBrowse->setEnabled(fromFile);
+        spnCount->setEnabled(!fromFile);
+        txtAmount->setEnabled(!fromFile);
+        txtLabel->setEnabled(!fromFile);
+    };
+    QObject::connect(cmbSource, QOverload<int>::of(&QComboBox::currentIndexChanged), fnSourceChanged);
+    fnSourceChanged(0);
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &d);
+    QObject::connect(buttons, &QDialogButtonBox::accepted, &d, &QDialog::accept);
+    QObject::connect(buttons, &QDialogButtonBox::rejected, &d, &QDialog::reject);
+
+    layout->addRow(tr("Codes for"), cmbSource);
+    layout->addRow(tr("File"), fileRow);
+    layout->addRow(tr("Number of addresses"), spnCount);
+    layout->addRow(tr("Amount"), txtAmount);
+    layout->addRow(tr("Label prefix"), txtLabel);
+    layout->addRow(tr("Columns"), spnColumns);
+    layout->addRow(tr("Rows per page"), spnRows);
+    layout->addRow(buttons);
+
+    if (d.exec() != QDialog::Accepted)
+        return;
+
+    bool fromFile = cmbSource->currentIndex() == 0;
+    if (!fromFile && !rpc->getConnection())
+        return;
+
+    // Read the file before asking where to save, so a bad line doesn't waste the trip
+    QList<QrSheetItem> items;
+    if (fromFile) {
+        QString error;
+        items = QrSheetWriter::readItems(txtFile->text(), error);
+        if (!error.isEmpty() || items.isEmpty()) {
+            QMessageBox::critical(this, tr("Error"), 
+                tr("Could not read the codes from %1").arg(txtFile->text()) % "\n\n" % error, QMessageBox::Ok);
+            return;
+        }
+    }
+
+    QUrl saveUrl = QFileDialog::getSaveFileUrl(this, tr("Save QR codes"), QString("thc-qr-codes.pdf"), 
+            "PDF file (*.pdf);;PNG images (*.png)");
+    if (saveUrl.isEmpty())
+        return;
+
+    QrSheetOptions options;
+    options.fileName = saveUrl.toLocalFile();
+    options.format   = QrSheetWriter::formatForFile(options.fileName);
+    options.columns  = spnColumns->value();
+    options.rows     = spnRows->value();
+
+    if (fromFile) {
+        startQrSheet(options, items);
+        return;
+    }
+
+    // The addresses are created in one batch, so there's no telling how far along it is
+    auto progress = new QProgressDialog(tr("Creating addresses..."), tr("Cancel"), 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    QObject::connect(progress, &QProgressDialog::canceled, progress, &QObject::deleteLater);
+
+    createQrSheetAddresses(options, spnCount->value(), Amount::fromString(txtAmount->text()), 
+                           txtLabel->text().trimmed(), progress);
+}
+
+// Create all the new addresses at once, then print them. Cancelling the progress dialog stops it.
+void MainWindow::createQrSheetAddresses(QrSheetOptions options, int count, Amount amount, QString labelPrefix,
+                                        QPointer<QProgressDialog> progress) {
+    rpc->getAddressPool()->take(AddressPool::Sapling, count, [=] (QList<QString> addrs) {
+        if (progress.isNull())
+            return;
+
+        progress->close();
+        progress->deleteLater();
+
+        if (addrs.isEmpty()) {
+            QMessageBox::critical(this, tr("Error"), 
+                tr("Couldn't create the new addresses, nothing was printed"), QMessageBox::Ok);
+            return;
+        }
+
+        QList<QrSheetItem> items;
+        items.reserve(addrs.size());
+        for (const auto& addr : addrs) {
+            QrSheetItem item;
+            item.text  = amount.isPositive() ? QString("thc:" % addr % "?amt=" % amount.toDecimalString()) : addr;
+            item.label = labelPrefix.isEmpty() ? QString() : QString(labelPrefix % " " % QString::number(items.size() + 1));
+            items.push_back(item);
+        }
+
+        startQrSheet(options, items);
+    });
+}
+
+void MainWindow::startQrSheet(QrSheetOptions options, QList<QrSheetItem> items) {
+    auto progress = new QProgressDialog(tr("Printing QR codes..."), tr("Cancel"), 0, items.size(), this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    auto writer = new QrSheetWriter(options, items, this);
+
+    QObject::connect(writer, &QrSheetWriter::progress, progress, [=] (int written, int) {
+        progress->setValue(written);
+    });
+    QObject::connect(progress, &QProgressDialog::canceled, writer, &QrSheetWriter::cancel);
+    QObject::connect(writer, &QrSheetWriter::done, this, [=] (bool success, QString error) {
+        progress->close();
+        progress->deleteLater();
+
+        if (!success && !writer->isCancelled()) {
+            QMessageBox::critical(this, tr("Error"), 
+                tr("Error printing the QR codes, nothing was saved") % "\n\n" % error, QMessageBox::Ok);
+        } else if (success) {
+            ui->statusBar->showMessage(tr("%1 QR codes saved to ").arg(items.size()) % options.fileName, 5 * 1000);
+        }
+    });
+    QObject::connect(writer, &QThread::finished, writer, &QObject::deleteLater);
+
+    writer->start();
+}
+
 /**
  * Backup the wallet.dat file. This is kind of a hack, since it has to read from the filesystem rather than an RPC call
  * This might fail for various reasons - Remote komodod, non-standard locations, custom params passed to komodod, many others
@@ -1093,14 +1685,8 @@ void MainWindow::setupBalancesTab() {
 
     // Double click on balances table
     auto fnDoSendFrom = [=](const QString& addr, const QString& to = QString(), bool sendMax = false) {
-        // Find the inputs combo
-        for (int i = 0; i < ui->inputsCombo->count(); i++) {
-            auto inputComboAddress = ui->inputsCombo->itemText(i);
-            if (inputComboAddress.startsWith(addr)) {
-                ui->inputsCombo->setCurrentIndex(i);
-                break;
-            }
-        }
+        // Select it in the inputs combo
+        ui->inputsCombo->setCurrentText(addr);
 
         // If there's a to address, add that as well
         if (!to.isEmpty()) {
@@ -1240,6 +1826,12 @@ void MainWindow::setupTransactionsTab() {
             });
         }
 
+        if (!addr.isEmpty()) {
+            menu.addAction(tr("Export transactions for this address"), [=] () {
+                this->exportTransactionsFor(addr);
+            });
+        }
+
         menu.addAction(tr("View on block explorer"), [=] () {
             QString url;
             if (Settings::getInstance()->isTestnet()) {
@@ -1299,20 +1891,34 @@ void MainWindow::setupTransactionsTab() {
 }
 
 void MainWindow::addNewZaddr(bool sapling) {
-    rpc->newZaddr(sapling, [=] (json reply) {
-        QString addr = QString::fromStdString(reply.get<json::string_t>());
-        // Make sure the RPC class reloads the z-addrs for future use
-        rpc->refreshAddresses();
+    auto fnShow = [=] (QString addr) {
+        if (addr.isEmpty()) {
+            ui->statusBar->showMessage(tr("Couldn't create a new address"), 10 * 1000);
+            return;
+        }
 
         // Just double make sure the z-address is still checked
         if ( sapling && ui->rdioZSAddr->isChecked() ) {
-            ui->listReceiveAddresses->insertItem(0, addr); 
-            ui->listReceiveAddresses->setCurrentIndex(0);
+            ui->listReceiveAddresses->setCurrentIndex(
+                ui->listReceiveAddresses->findData(addr, AddressListModel::AddressRole));
 
             ui->statusBar->showMessage(QString::fromStdString("Created new zAddr") %
                                        (sapling ? "(Sapling)" : "(Sprout)"), 
                                        10 * 1000);
         }
+    };
+
+    // Sapling addresses come from the pool, which puts them straight into the address list
+    if (sapling) {
+        rpc->getAddressPool()->take(AddressPool::Sapling, fnShow);
+        return;
+    }
+
+    rpc->newZaddr(sapling, [=] (json reply) {
+        QString addr = QString::fromStdString(reply.get<json::string_t>());
+        // Make sure the RPC class reloads the z-addrs for future use
+        rpc->refreshAddresses();
+        fnShow(addr);
     });
 }
 
@@ -1322,21 +1928,12 @@ void MainWindow::addNewZaddr(bool sapling) {
 std::function<void(bool)> MainWindow::addZAddrsToComboList(bool sapling) {
     return [=] (bool checked) { 
         if (checked && this->rpc->getAllZAddresses() != nullptr) { 
-            auto addrs = this->rpc->getAllZAddresses();
-            ui->listReceiveAddresses->clear();
-
-            std::for_each(addrs->begin(), addrs->end(), [=] (auto addr) {
-                if ( (sapling &&  Settings::getInstance()->isSaplingAddress(addr)) ||
-                    (!sapling && !Settings::getInstance()->isSaplingAddress(addr))) {
-                        if (rpc->getAllBalances()) {
-                            auto bal = rpc->getAllBalances()->value(addr);
-                            ui->listReceiveAddresses->addItem(addr, bal);
-                        }
-                }
-            }); 
+            // The list is shared and kept up to date, so switching to it is all there is to do
+            ui->listReceiveAddresses->setModel(AddressListModel::get(
+                sapling ? AddressListModel::SaplingAddresses : AddressListModel::SproutAddresses));
 
             // If z-addrs are empty, then create a new one.
-            if (addrs->isEmpty()) {
+            if (this->rpc->getAllZAddresses()->isEmpty()) {
                 addNewZaddr(sapling);
             }
         } 
@@ -1345,15 +1942,16 @@ std::function<void(bool)> MainWindow::addZAddrsToComboList(bool sapling) {
 
 void MainWindow::setupReceiveTab() {
     auto addNewTAddr = [=] () {
-        rpc->newTaddr([=] (json reply) {
-            QString addr = QString::fromStdString(reply.get<json::string_t>());
-            // Make sure the RPC class reloads the t-addrs for future use
-            rpc->refreshAddresses();
+        rpc->getAddressPool()->take(AddressPool::Transparent, [=] (QString addr) {
+            if (addr.isEmpty()) {
+                ui->statusBar->showMessage(tr("Couldn't create a new t-Addr"), 10 * 1000);
+                return;
+            }
 
-            // Just double make sure the t-address is still checked
+            // Just double make sure the t-address is still checked. The pool has already put it in the list.
             if (ui->rdioTAddr->isChecked()) {
-                ui->listReceiveAddresses->insertItem(0, addr);
-                ui->listReceiveAddresses->setCurrentIndex(0);
+                ui->listReceiveAddresses->setCurrentIndex(
+                    ui->listReceiveAddresses->findData(addr, AddressListModel::AddressRole));
 
                 ui->statusBar->showMessage(tr("Created new t-Addr"), 10 * 1000);
             }
@@ -1529,34 +2127,15 @@ void MainWindow::setupReceiveTab() {
 
 void MainWindow::updateTAddrCombo(bool checked) {
     if (checked) {
-        auto utxos = this->rpc->getUTXOs();
-        ui->listReceiveAddresses->clear();
-
-        std::for_each(utxos->begin(), utxos->end(), [=](auto& utxo) {
-            auto addr = utxo.address;
-            if (addr.startsWith("R") && ui->listReceiveAddresses->findText(addr) < 0) {
-                auto bal = rpc->getAllBalances()->value(addr);
-                ui->listReceiveAddresses->addItem(addr, bal);
-            }
-        });
+        ui->listReceiveAddresses->setModel(AddressListModel::get(AddressListModel::TAddresses));
     }
 };
 
 // Updates the labels everywhere on the UI. Call this after the labels have been updated
 void MainWindow::updateLabels() {
-    // Update the Receive tab
-    if (ui->rdioTAddr->isChecked()) {
-        updateTAddrCombo(true);
-    }
-    else {
-        addZAddrsToComboList(ui->rdioZSAddr->isChecked())(true);
-    }
-
-    // Update the Send Tab
-    updateFromCombo();
-
-    // Update the autocomplete
-    updateLabelsAutoComplete();
+    // Update the address pickers on the Send and Receive tabs. The autocomplete follows the address
+    // book by itself.
+    AddressListModel::labelsChanged();
 }
 
 MainWindow::~MainWindow()
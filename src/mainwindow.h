@@ -3,19 +3,24 @@
 
 #include "precompiled.h"
 #include "logger.h"
+#include "amount.h"
+#include "txexporter.h"
+#include "qrsheet.h"
+#include "labelcompleter.h"
 
 // Forward declare to break circular dependency.
 class RPC;
 class Settings;
 class WSServer;
 class WormholeClient;
+class PayoutEngine;
 
 using json = nlohmann::json;
 
 // Struct used to hold destination info when sending a Tx. 
 struct ToFields {
     QString addr;
-    double  amount;
+    Amount  amount;
     QString txtMemo;
     QString encodedMemo;
 };
@@ -24,7 +29,7 @@ struct ToFields {
 struct Tx {
     QString         fromAddr;
     QList<ToFields> toAddrs;
-    double          fee;
+    Amount          fee;
 };
 
 namespace Ui {
@@ -39,7 +44,6 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
-    void updateLabelsAutoComplete();
     RPC* getRPC() { return rpc; }
 
     QCompleter*         getLabelCompleter() { return labelCompleter; }
@@ -88,7 +92,8 @@ private:
 
     void removeExtraAddresses();
 
-    Tx   createTxFromSendPage();
+    // error says which amount on the page couldn't be read, if any
+    Tx   createTxFromSendPage(QString* error = nullptr);
     bool confirmTx(Tx tx);
 
     void turnstileDoMigration(QString fromAddr = "");
@@ -122,6 +127,18 @@ private:
     void exportKeys(QString addr = "");
     void backupWalletDat();
     void exportTransactions();
+    void exportTransactionsFor(QString address);
+    void startTransactionExport(TxExportOptions options);
+
+    void showInvoices();
+    void newInvoice(QWidget* parent);
+
+    void bulkPayout();
+
+    void printQrSheet();
+    void createQrSheetAddresses(QrSheetOptions options, int count, Amount amount, QString labelPrefix,
+                                QPointer<QProgressDialog> progress);
+    void startQrSheet(QrSheetOptions options, QList<QrSheetItem> items);
 
     void doImport(QList<QString>* keys);
 
@@ -129,13 +146,15 @@ private:
     bool eventFilter(QObject *object, QEvent *event);
 
     bool            uiPaymentsReady    = false;
+    bool            payFromDefaulted   = false;
     QString         pendingURIPayment;
 
     WSServer*       wsserver = nullptr;
     WormholeClient* wormhole = nullptr;
 
     RPC*                rpc             = nullptr;
-    QCompleter*         labelCompleter  = nullptr;
+    PayoutEngine*       payouts         = nullptr;
+    LabelCompleter*     labelCompleter  = nullptr;
     QRegExpValidator*   amtValidator    = nullptr;
     QRegExpValidator*   feesValidator   = nullptr;
 
@@ -0,0 +1,260 @@
+#include "paymenturi.h"
+#include "addressvalidator.h"
+
+namespace {
+
+// Indexes are at most 4 digits, which is plenty for one transaction
+const int maxIndexDigits = 4;
+
+enum class Param {
+    Address,
+    Amount,
+    Memo,
+    Label,
+    Other,
+    Required        // An unknown "req-" parameter, which can't be ignored
+};
+
+// Case insensitive compare of s[0..len) with an ASCII literal
+bool equalsLiteral(const QChar* s, int len, const char* lit) {
+    int i = 0;
+    for (; i < len && lit[i] != 0; i++) {
+        ushort c = s[i].unicode();
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        if (c != (ushort)lit[i])
+            return false;
+    }
+    return i == len && lit[i] == 0;
+}
+
+Param paramFor(const QChar* s, int len) {
+    if (equalsLiteral(s, len, "address"))
+        return Param::Address;
+    if (equalsLiteral(s, len, "amount") || equalsLiteral(s, len, "amt"))
+        return Param::Amount;
+    if (equalsLiteral(s, len, "memo") || equalsLiteral(s, len, "message") || equalsLiteral(s, len, "msg"))
+        return Param::Memo;
+    if (equalsLiteral(s, len, "label"))
+        return Param::Label;
+
+    // Ignore unknown fields, since some developers use it to pass extra data. Unless it says it's required.
+    if (len > 4 && equalsLiteral(s, 4, "req-"))
+        return Param::Required;
+    return Param::Other;
+}
+
+int hexValue(ushort c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Percent-decode s[0..len) as UTF-8. Returns the offset of a broken escape in bad, or -1.
+QString percentDecode(const QChar* s, int len, int& bad) {
+    bad = -1;
+
+    // Most values have nothing escaped, and are just copied
+    int i = 0;
+    while (i < len && s[i] != '%')
+        i++;
+    if (i == len)
+        return QString(s, len);
+
+    QByteArray bytes;
+    bytes.reserve(len);
+    bytes.append(QString::fromRawData(s, i).toUtf8());
+
+    while (i < len) {
+        ushort c = s[i].unicode();
+        if (c == '%') {
+            int hi = i + 2 < len ? hexValue(s[i + 1].unicode()) : -1;
+            int lo = hi >= 0     ? hexValue(s[i + 2].unicode()) : -1;
+            if (lo < 0) {
+                bad = i;
+                return QString();
+            }
+            bytes.append((char)(hi * 16 + lo));
+            i += 3;
+        } else if (c < 128) {
+            bytes.append((char)c);
+            i++;
+        } else {
+            // Unescaped non-ASCII, eg. a URI that was typed in. Keep surrogate pairs together.
+            int n = s[i].isHighSurrogate() && i + 1 < len ? 2 : 1;
+            bytes.append(QString::fromRawData(s + i, n).toUtf8());
+            i += n;
+        }
+    }
+
+    return QString::fromUtf8(bytes);
+}
+
+// Strict amount parse, straight from the URI's characters into a stack buffer
+bool parseAmount(const QChar* s, int len, Amount& out) {
+    char buf[Amount::MaxChars];
+    if (len == 0 || len > Amount::MaxChars)
+        return false;
+
+    for (int i = 0; i < len; i++) {
+        ushort c = s[i].unicode();
+        if (!((c >= '0' && c <= '9') || c == '.'))
+            return false;           // No signs, spaces or exponents in a URI
+        buf[i] = (char)c;
+    }
+
+    return Amount::parse(buf, len, out);
+}
+
+PaymentRecipient& recipientAt(QVector<PaymentRecipient>& recipients, int index, int offset) {
+    for (auto& r : recipients) {
+        if (r.index == index)
+            return r;
+    }
+
+    PaymentRecipient r;
+    r.index  = index;
+    r.offset = offset;
+    recipients.push_back(r);
+    return recipients.last();
+}
+
+}
+
+Amount PaymentURI::total() const {
+    Amount sum;
+    for (const auto& r : recipients)
+        sum += r.amount;
+    return sum;
+}
+
+PaymentURI PaymentURI::parse(const QString& uri) {
+    PaymentURI ans;
+
+    const QChar* s   = uri.constData();
+    const int    len = uri.size();
+
+    auto fnFail = [&] (int offset, const char* msg) {
+        ans.recipients.clear();
+        ans.errorOffset = offset;
+        ans.error       = QString("%1 at character %2").arg(msg).arg(offset + 1);
+        return ans;
+    };
+
+    const int schemeLen = 4;
+    if (len < schemeLen || !equalsLiteral(s, schemeLen, "thc:"))
+        return fnFail(0, "Not a THC payment URI");
+
+    // The address in the path is recipient 0. It can be left out when the parameters have all the addresses.
+    int pos = schemeLen;
+    while (pos < len && s[pos] != '?')
+        pos++;
+
+    if (pos > schemeLen) {
+        auto& r = recipientAt(ans.recipients, 0, schemeLen);
+        r.addr  = QString(s + schemeLen, pos - schemeLen);
+        if (!AddressValidator::isValid(r.addr))
+            return fnFail(schemeLen, "Could not understand address");
+    }
+
+    if (pos < len)
+        pos++;      // Eat the "?"
+
+    while (pos < len) {
+        int keyStart = pos;
+        while (pos < len && s[pos] != '=' && s[pos] != '&')
+            pos++;
+        int keyEnd = pos;
+
+        if (pos == len || s[pos] != '=')
+            return fnFail(keyStart, "No value argument was seen");
+        pos++;
+
+        int valStart = pos;
+        while (pos < len && s[pos] != '&')
+            pos++;
+        int valLen = pos - valStart;
+
+        if (pos < len)
+            pos++;  // Eat the "&"
+
+        // Split "name.n" into the name and the recipient index
+        int nameEnd = keyStart;
+        while (nameEnd < keyEnd && s[nameEnd] != '.')
+            nameEnd++;
+
+        int index = 0;
+        if (nameEnd < keyEnd) {
+            int digits = keyEnd - nameEnd - 1;
+            if (digits < 1 || digits > maxIndexDigits || s[nameEnd + 1] == '0')
+                return fnFail(nameEnd + 1, "Invalid parameter index");
+
+            for (int i = nameEnd + 1; i < keyEnd; i++) {
+                ushort c = s[i].unicode();
+                if (c < '0' || c > '9')
+                    return fnFail(i, "Invalid parameter index");
+                index = index * 10 + (c - '0');
+            }
+        }
+
+        if (nameEnd == keyStart)
+            return fnFail(keyStart, "Missing parameter name");
+
+        auto param = paramFor(s + keyStart, nameEnd - keyStart);
+        if (param == Param::Other)
+            continue;
+        if (param == Param::Required)
+            return fnFail(keyStart, "Unsupported required parameter");
+
+        auto& r = recipientAt(ans.recipients, index, keyStart);
+        switch (param) {
+        case Param::Address:
+            if (!r.addr.isEmpty())
+                return fnFail(keyStart, "Duplicate address");
+
+            r.addr = QString(s + valStart, valLen);
+            if (!AddressValidator::isValid(r.addr))
+                return fnFail(valStart, "Could not understand address");
+            break;
+
+        case Param::Amount:
+            if (r.hasAmount)
+                return fnFail(keyStart, "Duplicate amount");
+            if (!parseAmount(s + valStart, valLen, r.amount))
+                return fnFail(valStart, "Invalid amount");
+            r.hasAmount = true;
+            break;
+
+        case Param::Memo:
+        case Param::Label: {
+            QString& field = param == Param::Memo ? r.memo : r.label;
+            if (!field.isEmpty())
+                return fnFail(keyStart, param == Param::Memo ? "Duplicate memo" : "Duplicate label");
+
+            int bad;
+            field = percentDecode(s + valStart, valLen, bad);
+            if (bad >= 0)
+                return fnFail(valStart + bad, "Invalid percent-encoding");
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    if (ans.recipients.isEmpty())
+        return fnFail(schemeLen, "Couldn't find an address");
+
+    std::sort(ans.recipients.begin(), ans.recipients.end(), [] (const PaymentRecipient& a, const PaymentRecipient& b) {
+        return a.index < b.index;
+    });
+
+    for (const auto& r : ans.recipients) {
+        if (r.addr.isEmpty())
+            return fnFail(r.offset, "Recipient has no address");
+    }
+
+    return ans;
+}
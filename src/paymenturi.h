@@ -0,0 +1,43 @@
+#ifndef PAYMENTURI_H
+#define PAYMENTURI_H
+
+#include "precompiled.h"
+#include "amount.h"
+
+// One payee of a payment URI
+struct PaymentRecipient {
+    QString addr;
+    Amount  amount;
+    bool    hasAmount   = false;
+    QString memo;
+    QString label;
+
+    int     index       = 0;    // The ".n" suffix of its parameters, 0 for the address in the URI path
+    int     offset      = 0;    // Where in the URI it was first mentioned, for errors
+};
+
+/**
+ * A parsed "thc:" payment URI.
+ *
+ * Besides the plain "thc:<addr>?amt=x&memo=y" form, a URI can pay several recipients the way ZIP-321
+ * does it: every parameter can carry a ".n" index, and the parameters with the same index describe
+ * one recipient, eg. "thc:?address=R...&amount=1&address.1=zs1...&amount.1=2&memo.1=Thanks".
+ *
+ * The URI is parsed in one pass over its characters, without splitting it up into lists of strings.
+ * Amounts are parsed exactly into Amounts, values are percent-decoded, and errors say at which
+ * character the URI stopped making sense.
+ */
+struct PaymentURI {
+    QVector<PaymentRecipient> recipients;   // In index order
+
+    // Any errors are stored here
+    QString error;
+    int     errorOffset = -1;
+
+    bool    isValid() const     { return error.isEmpty() && !recipients.isEmpty(); }
+    Amount  total() const;
+
+    static PaymentURI parse(const QString& uri);
+};
+
+#endif // PAYMENTURI_H
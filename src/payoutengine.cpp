@@ -0,0 +1,598 @@
+#include "payoutengine.h"
+#include "addressvalidator.h"
+#include "mainwindow.h"
+#include "rpc.h"
+#include "settings.h"
+#include "walletstore.h"
+
+namespace {
+
+// Memos are 512 bytes on chain
+const int maxMemoBytes = 512;
+
+// A CSV field, with its quotes taken off
+QString unquote(QString field) {
+    field = field.trimmed();
+    if (field.size() >= 2 && field.startsWith('"') && field.endsWith('"'))
+        field = field.mid(1, field.size() - 2).replace("\"\"", "\"");
+    return field;
+}
+
+// Split a CSV line into at most count fields, on the commas that aren't inside quotes. The last field is the
+// rest of the line, so an unquoted memo can still have commas in it.
+QStringList splitFields(const QString& line, int count) {
+    QStringList fields;
+    bool quoted = false;
+    int  start  = 0;
+    for (int i = 0; i < line.size() && fields.size() < count - 1; i++) {
+        QChar c = line.at(i);
+        if (c == '"') {
+            quoted = !quoted;       // An escaped "" flips it twice
+        } else if (c == ',' && !quoted) {
+            fields.push_back(line.mid(start, i - start));
+            start = i + 1;
+        }
+    }
+    fields.push_back(line.mid(start));
+    return fields;
+}
+
+QString linesOf(const QList<PayoutRow>& rows, const PayoutBatch& b) {
+    return QObject::tr("Lines %1-%2").arg(rows.at(b.first).line).arg(rows.at(b.first + b.count - 1).line);
+}
+
+}
+
+PayoutEngine::PayoutEngine(RPC* _rpc, QObject* parent) : QObject(parent), rpc(_rpc) {
+    // Every refresh may have confirmed a source's change, so see if another batch can go out
+    QObject::connect(WalletDiff::getInstance(), &WalletDiff::changed, this, [=] () {
+        if (running)
+            schedule();
+    });
+}
+
+PayoutEngine::~PayoutEngine() {
+    log.close();
+}
+
+QList<PayoutRow> PayoutEngine::readFile(const QString& fileName, QByteArray& hash, QString& error) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return QList<PayoutRow>();
+    }
+    QByteArray data = file.readAll();
+
+    // The journal is tied to the exact contents of the file, so a changed file is never resumed
+    hash.resize(crypto_hash_sha256_BYTES);
+    crypto_hash_sha256((unsigned char*)hash.data(), (const unsigned char*)data.constData(), (unsigned long long)data.size());
+
+    auto fnFail = [&] (int line, const QString& msg) {
+        error = tr("Line %1: %2").arg(line).arg(msg);
+        return QList<PayoutRow>();
+    };
+
+    QList<PayoutRow> rows;
+    QStringList      addrs;
+    auto lines = QString::fromUtf8(data).split('\n');
+    for (int i = 0; i < lines.size(); i++) {
+        QString line = lines.at(i).trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        // address,amount[,memo], where the memo is the rest of the line
+        auto fields = splitFields(line, 3);
+
+        PayoutRow row;
+        row.line = i + 1;
+        row.addr = unquote(fields.at(0));
+        QString amount = fields.size() > 1 ? unquote(fields.at(1)) : QString();
+        row.memo = fields.size() > 2 ? unquote(fields.at(2)) : QString();
+
+        if (!Amount::parse(amount, row.amount)) {
+            // A header line, like "address,amount,memo"
+            if (rows.isEmpty() && !AddressValidator::isValid(row.addr))
+                continue;
+            return fnFail(row.line, tr("\"%1\" is not an amount").arg(amount));
+        }
+        if (!row.amount.isPositive())
+            return fnFail(row.line, tr("The amount has to be more than zero"));
+        if (row.memo.toUtf8().size() > maxMemoBytes)
+            return fnFail(row.line, tr("The memo is longer than %1 bytes").arg(maxMemoBytes));
+
+        rows.push_back(row);
+        addrs.push_back(row.addr);
+    }
+
+    if (rows.isEmpty()) {
+        error = tr("There are no recipients in the file");
+        return rows;
+    }
+
+    // All the checksums in one go, spread over the cores for a big file
+    QVector<AddressValidator::Kind> kinds;
+    AddressValidator::checkAll(addrs, kinds);
+
+    bool testnet = Settings::getInstance()->isTestnet();
+    QHash<QString, int> seen;
+    seen.reserve(rows.size());
+    for (int i = 0; i < rows.size(); i++) {
+        const auto& row = rows.at(i);
+        auto kind = kinds.at(i);
+
+        if (kind == AddressValidator::Invalid ||
+                (kind == AddressValidator::Sapling && testnet) || (kind == AddressValidator::SaplingTestnet && !testnet))
+            return fnFail(row.line, tr("\"%1\" is not a valid address").arg(row.addr));
+        if (kind == AddressValidator::Transparent && !row.memo.isEmpty())
+            return fnFail(row.line, tr("Memos can only be sent to shielded addresses"));
+
+        // komodod refuses a z_sendmany that pays the same address twice, and it's most likely a mistake anyway
+        auto prev = seen.constFind(row.addr);
+        if (prev != seen.constEnd())
+            return fnFail(row.line, tr("Pays the same address as line %1").arg(prev.value()));
+        seen.insert(row.addr, row.line);
+    }
+
+    return rows;
+}
+
+QList<PayoutBatch> PayoutEngine::planBatches(const QList<PayoutRow>& rows) {
+    QList<PayoutBatch> batches;
+
+    PayoutBatch b;
+    int zOutputs = 0;
+    for (int i = 0; i < rows.size(); i++) {
+        bool shielded = !Settings::isTAddress(rows.at(i).addr);
+        if (b.count == maxOutputs || (shielded && zOutputs == maxZOutputs)) {
+            batches.push_back(b);
+            b        = PayoutBatch();
+            b.first  = i;
+            zOutputs = 0;
+        }
+
+        b.count++;
+        b.total += rows.at(i).amount;
+        if (shielded)
+            zOutputs++;
+    }
+    if (b.count > 0)
+        batches.push_back(b);
+
+    return batches;
+}
+
+bool PayoutEngine::start(const QString& file, const QStringList& sourceAddrs, Amount batchFee, QString& error) {
+    if (running || log.isOpen()) {
+        error = tr("A payout is already running");
+        return false;
+    }
+
+    QByteArray hash;
+    auto newRows = readFile(file, hash, error);
+    if (newRows.isEmpty())
+        return false;
+
+    if (sourceAddrs.isEmpty()) {
+        error = tr("There are no addresses to pay from");
+        return false;
+    }
+
+    fileName = file;
+    rows     = newRows;
+    batches  = planBatches(rows);
+    fee      = batchFee;
+
+    sources.clear();
+    for (const auto& addr : sourceAddrs) {
+        Source s;
+        s.addr = addr;
+        sources.push_back(s);
+    }
+
+    if (!openJournal(hash, error))
+        return false;
+
+    running = true;
+    elapsed.start();
+    rowsPaidAtStart = 0;
+    for (const auto& b : batches) {
+        if (b.status == PayoutBatch::Done)
+            rowsPaidAtStart += b.count;
+    }
+
+    resumeSubmitted();
+    schedule();
+    checkFinished();
+    return true;
+}
+
+void PayoutEngine::stop() {
+    running = false;
+    checkFinished();
+}
+
+// The journal for this file is found by its contents. If there is one, the payout carries on from it.
+bool PayoutEngine::openJournal(const QByteArray& hash, QString& error) {
+    QString journalFile = WalletStore::writeableFile("payout-" % QString::fromLatin1(hash.toHex().left(16)) % ".journal");
+
+    QList<QByteArray> records;
+    if (!log.open(journalFile, &records)) {
+        error = tr("Could not open the payout journal %1").arg(journalFile);
+        return false;
+    }
+
+    resumed = !records.isEmpty();
+    if (!resumed) {
+        QList<QPair<qint32, qint32>> plan;
+        for (const auto& b : batches)
+            plan.push_back(qMakePair((qint32)b.first, (qint32)b.count));
+
+        QByteArray record;
+        QDataStream out(&record, QIODevice::WriteOnly);
+        out << (quint8)Plan << hash << plan;
+        log.append(record);
+        log.sync();
+        return true;
+    }
+
+    // The batches are the ones the journal was started with, in case they would be planned differently now
+    QDataStream in(records.first());
+    quint8     op;
+    QByteArray planHash;
+    QList<QPair<qint32, qint32>> plan;
+    in >> op >> planHash >> plan;
+    if (op != Plan || planHash != hash) {
+        error = tr("The payout journal %1 doesn't belong to this file").arg(journalFile);
+        log.close();
+        return false;
+    }
+
+    batches.clear();
+    for (const auto& p : plan) {
+        if (p.first < 0 || p.second <= 0 || p.first + p.second > rows.size()) {
+            error = tr("The payout journal %1 is damaged").arg(journalFile);
+            log.close();
+            return false;
+        }
+
+        PayoutBatch b;
+        b.first = p.first;
+        b.count = p.second;
+        for (int i = b.first; i < b.first + b.count; i++)
+            b.total += rows.at(i).amount;
+        batches.push_back(b);
+    }
+
+    for (int i = 1; i < records.size(); i++)
+        replay(records.at(i));
+
+    // It was on its way to komodod when the wallet stopped, so it may or may not have gone out
+    for (auto& b : batches) {
+        if (b.status == PayoutBatch::Submitting) {
+            b.status = PayoutBatch::Unknown;
+            b.error  = tr("The wallet stopped while it was being sent");
+        }
+    }
+
+    return true;
+}
+
+void PayoutEngine::replay(const QByteArray& record) {
+    QDataStream in(record);
+    quint8  op;
+    qint32  index;
+    QString a, b;
+    in >> op >> index >> a >> b;
+    if (index < 0 || index >= batches.size())
+        return;
+
+    auto& batch = batches[index];
+    switch (op) {
+    case Submitting:
+        batch.status = PayoutBatch::Submitting;
+        batch.from   = a;
+        batch.attempts++;
+        break;
+    case Submitted:
+        batch.status = PayoutBatch::Submitted;
+        batch.opid   = a;
+        break;
+    case Done:
+        batch.status = PayoutBatch::Done;
+        batch.txid   = a;
+        break;
+    case Failed:
+        batch.status = batch.attempts >= maxAttempts ? PayoutBatch::Failed : PayoutBatch::Pending;
+        batch.error  = a;
+        break;
+    case Lost:
+        batch.status = PayoutBatch::Unknown;
+        batch.error  = a;
+        break;
+    default:
+        break;
+    }
+}
+
+void PayoutEngine::journal(Op op, int batch, const QString& a, const QString& b) {
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out << (quint8)op << (qint32)batch << a << b;
+    log.append(record);
+}
+
+PayoutEngine::Source* PayoutEngine::sourceFor(const QString& addr) {
+    for (auto& s : sources) {
+        if (s.addr == addr)
+            return &s;
+    }
+    return nullptr;
+}
+
+Tx PayoutEngine::makeTx(const PayoutBatch& b) const {
+    Tx tx;
+    tx.fromAddr = b.from;
+    tx.fee      = fee;
+    for (int i = b.first; i < b.first + b.count; i++) {
+        const auto& row = rows.at(i);
+        tx.toAddrs.push_back(ToFields{ row.addr, row.amount, row.memo, row.memo.toUtf8().toHex() });
+    }
+    return tx;
+}
+
+// Pick up the batches komodod was computing when the journal was last written. komodod only remembers
+// its operations until it restarts, and one it has forgotten about can't be told apart from one that
+// went out, so those become Unknown.
+void PayoutEngine::resumeSubmitted() {
+    QStringList opids;
+    for (const auto& b : batches) {
+        if (b.status == PayoutBatch::Submitted) {
+            opids.push_back(b.opid);
+            if (auto s = sourceFor(b.from))
+                s->busy = true;
+        }
+    }
+    if (opids.isEmpty())
+        return;
+
+    rpc->getOperationStatus(opids, [=] (json reply) {
+        // Anything that can't be read is left out of known, and ends up Unknown below
+        QSet<QString> known;
+        json ops = reply.is_array() ? reply : json::array();
+        for (auto& it : ops) {
+            if (!it.is_object() || !it["id"].is_string() || !it["status"].is_string())
+                continue;
+
+            QString opid   = QString::fromStdString(it["id"]);
+            QString status = QString::fromStdString(it["status"]);
+            known.insert(opid);
+
+            int i = 0;
+            while (i < batches.size() && (batches.at(i).status != PayoutBatch::Submitted || batches.at(i).opid != opid))
+                i++;
+            if (i == batches.size())
+                continue;
+
+            bool hasTxid  = it["result"].is_object() && it["result"]["txid"].is_string();
+            bool hasError = it["error"].is_object() && it["error"]["message"].is_string();
+            if (status == "success" && hasTxid) {
+                batchDone(i, QString::fromStdString(it["result"]["txid"]));
+            } else if (status == "failed" && hasError) {
+                batchFailed(i, QString::fromStdString(it["error"]["message"]));
+            } else if (status == "success" || status == "failed") {
+                batchLost(i, tr("komodod's status for operation %1 couldn't be read").arg(opid));
+            } else {
+                // Still being computed, so watch it like any other tx
+                rpc->addNewTxToWatch(opid, WatchedTx { opid, makeTx(batches.at(i)),
+                    [=] (QString, QString txid) { batchDone(i, txid); },
+                    [=] (QString, QString err)  { batchFailed(i, err); } });
+            }
+        }
+
+        for (int i = 0; i < batches.size(); i++) {
+            auto& b = batches[i];
+            if (b.status == PayoutBatch::Submitted && !known.contains(b.opid)) {
+                b.status = PayoutBatch::Unknown;
+                b.error  = tr("komodod doesn't know operation %1 anymore").arg(b.opid);
+                if (auto s = sourceFor(b.from))
+                    s->busy = false;
+            }
+        }
+
+        schedule();
+        checkFinished();
+    });
+}
+
+// Give every idle source the next batch its confirmed funds can pay for
+void PayoutEngine::schedule() {
+    if (!running || rpc->getConnection() == nullptr)
+        return;
+
+    int  blockNumber = Settings::getInstance()->getBlockNumber();
+    auto snapshot    = rpc->getSnapshot();
+
+    QHash<QString, Amount> funds;
+    for (const auto& s : sources)
+        funds.insert(s.addr, Amount());
+    for (const auto& u : snapshot->utxos) {
+        if (u.spendable && u.confirmations > 0 && funds.contains(u.address))
+            funds[u.address] += u.amount;
+    }
+
+    for (auto& s : sources) {
+        if (s.busy || blockNumber < s.readyAtBlock)
+            continue;
+
+        // The snapshot's UTXOs may still be from before the last batch, and count the coins it spent. Other
+        // parts of the snapshot can be newer, so this goes by when the UTXOs themselves were fetched.
+        if (snapshot->utxosBlock < s.readyAtBlock)
+            continue;
+
+        for (int i = 0; i < batches.size(); i++) {
+            if (batches.at(i).status == PayoutBatch::Pending && batches.at(i).total + fee <= funds.value(s.addr)) {
+                submit(i, s);
+                break;
+            }
+        }
+    }
+}
+
+void PayoutEngine::submit(int index, Source& source) {
+    auto& b    = batches[index];
+    b.status   = PayoutBatch::Submitting;
+    b.from     = source.addr;
+    b.attempts++;
+    source.busy = true;
+
+    // On disk before it goes out, so a crash in between can never make it look unsent
+    journal(Submitting, index, source.addr);
+    log.sync();
+
+    rpc->executeTransaction(makeTx(b),
+        [=] (QString opid) {
+            batches[index].status = PayoutBatch::Submitted;
+            batches[index].opid   = opid;
+            journal(Submitted, index, opid);
+            log.sync();
+        },
+        [=] (QString, QString txid) {
+            batchDone(index, txid);
+        },
+        // komodod refused it right away or the operation failed, so nothing was sent
+        [=] (QString, QString err) {
+            batchFailed(index, err);
+        },
+        [=] (QString err) {
+            batchLost(index, tr("The request to komodod failed: %1").arg(err));
+        });
+}
+
+void PayoutEngine::batchDone(int index, const QString& txid) {
+    auto& b  = batches[index];
+    b.status = PayoutBatch::Done;
+    b.txid   = txid;
+    journal(Done, index, txid);
+
+    // The change isn't spendable until it's mined
+    if (auto s = sourceFor(b.from)) {
+        s->busy         = false;
+        s->readyAtBlock = Settings::getInstance()->getBlockNumber() + 1;
+    }
+
+    emit progress(count(PayoutBatch::Done), count(PayoutBatch::Failed), batches.size());
+    schedule();
+    checkFinished();
+}
+
+void PayoutEngine::batchFailed(int index, const QString& err) {
+    auto& b  = batches[index];
+    b.error  = err;
+    b.status = b.attempts >= maxAttempts ? PayoutBatch::Failed : PayoutBatch::Pending;
+    journal(Failed, index, err);
+
+    // Most likely its funds were still unconfirmed change, so give it a block before trying again
+    if (auto s = sourceFor(b.from)) {
+        s->busy         = false;
+        s->readyAtBlock = Settings::getInstance()->getBlockNumber() + 1;
+    }
+
+    emit progress(count(PayoutBatch::Done), count(PayoutBatch::Failed), batches.size());
+    schedule();
+    checkFinished();
+}
+
+// The request failed on the way to komodod or back, or its result couldn't be read, so it may have gone out.
+// Like a batch the wallet stopped in the middle of sending, it's never sent again.
+void PayoutEngine::batchLost(int index, const QString& err) {
+    auto& b  = batches[index];
+    b.status = PayoutBatch::Unknown;
+    b.error  = err;
+    journal(Lost, index, err);
+    log.sync();
+
+    if (auto s = sourceFor(b.from)) {
+        s->busy         = false;
+        s->readyAtBlock = Settings::getInstance()->getBlockNumber() + 1;
+    }
+
+    emit progress(count(PayoutBatch::Done), count(PayoutBatch::Failed), batches.size());
+    schedule();
+    checkFinished();
+}
+
+// Done once nothing is on its way anymore, and there's nothing left to send or it was stopped
+void PayoutEngine::checkFinished() {
+    if (count(PayoutBatch::Submitting) > 0 || count(PayoutBatch::Submitted) > 0)
+        return;
+    if (running && count(PayoutBatch::Pending) > 0)
+        return;
+    if (!log.isOpen())
+        return;
+
+    running = false;
+    log.sync();
+    log.close();
+
+    LOG_INFO("Payout finished", {{"paid", QString::number(count(PayoutBatch::Done))},
+                                 {"failed", QString::number(count(PayoutBatch::Failed))},
+                                 {"unknown", QString::number(count(PayoutBatch::Unknown))},
+                                 {"batches", QString::number(batches.size())}});
+    emit finished(count(PayoutBatch::Done) == batches.size());
+}
+
+int PayoutEngine::count(PayoutBatch::Status status) const {
+    int n = 0;
+    for (const auto& b : batches) {
+        if (b.status == status)
+            n++;
+    }
+    return n;
+}
+
+Amount PayoutEngine::totalAmount() const {
+    Amount sum;
+    for (const auto& b : batches)
+        sum += b.total;
+    return sum;
+}
+
+double PayoutEngine::throughput() const {
+    int paid = 0;
+    for (const auto& b : batches) {
+        if (b.status == PayoutBatch::Done)
+            paid += b.count;
+    }
+
+    double minutes = elapsed.isValid() ? elapsed.elapsed() / 60000.0 : 0;
+    return minutes > 0 ? (paid - rowsPaidAtStart) / minutes : 0;
+}
+
+QString PayoutEngine::report() const {
+    int    paid = 0;
+    Amount paidAmount;
+    for (const auto& b : batches) {
+        if (b.status == PayoutBatch::Done) {
+            paid       += b.count;
+            paidAmount += b.total;
+        }
+    }
+
+    QStringList lines;
+    lines << tr("%1 of %2 recipients paid, %3 in %4 of %5 transactions")
+                .arg(paid).arg(rows.size()).arg(Settings::getZECDisplayFormat(paidAmount))
+                .arg(count(PayoutBatch::Done)).arg(batches.size());
+    lines << tr("%1 recipients per minute").arg(throughput(), 0, 'f', 1);
+
+    for (const auto& b : batches) {
+        if (b.status == PayoutBatch::Failed)
+            lines << linesOf(rows, b) % ": " % tr("Failed after %1 attempts: %2").arg(b.attempts).arg(b.error);
+        else if (b.status == PayoutBatch::Unknown)
+            lines << linesOf(rows, b) % ": " % tr("May have been paid from %1 (%2). Check its transactions before paying these again.")
+                                                   .arg(b.from).arg(b.error);
+        else if (b.status == PayoutBatch::Pending)
+            lines << linesOf(rows, b) % ": " % tr("Not paid yet");
+    }
+
+    return lines.join("\n");
+}
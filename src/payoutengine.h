@@ -0,0 +1,141 @@
+#ifndef PAYOUTENGINE_H
+#define PAYOUTENGINE_H
+
+#include "precompiled.h"
+#include "amount.h"
+#include "recordlog.h"
+#include "walletdiff.h"
+
+class RPC;
+struct Tx;
+
+// One recipient line of a payout file
+struct PayoutRow {
+    QString addr;
+    Amount  amount;
+    QString memo;
+    int     line        = 0;    // In the file, for errors
+};
+
+// A run of consecutive rows that is paid with one z_sendmany
+struct PayoutBatch {
+    enum Status : quint8 {
+        Pending = 0,
+        Submitting,         // Being sent to komodod right now
+        Submitted,          // komodod is computing it, under opid
+        Done,
+        Failed,             // Given up on after maxAttempts
+        Unknown             // Went out but the result was lost. Has to be checked by hand, it's never resent.
+    };
+
+    int     first       = 0;
+    int     count       = 0;
+    Amount  total;
+
+    Status  status      = Pending;
+    QString from;
+    QString opid;
+    QString txid;
+    QString error;
+    int     attempts    = 0;
+};
+
+/**
+ * Pays out a CSV file of "address,amount[,memo]" lines to thousands of recipients.
+ *
+ * The whole file is read and checked up front (the addresses in parallel, with AddressValidator), and
+ * split into batches that fit in one z_sendmany. Batches are sent from several funded addresses at once:
+ * each source address has one batch out at a time, and waits for the next block before its next one,
+ * so its change is confirmed and can be spent again.
+ *
+ * Every step is written to a journal before it's taken, so a payout can be stopped, or the wallet can
+ * crash, and opening the same file again carries on where it left off. A batch that may have gone out
+ * without its result being recorded is marked Unknown and never sent again, so nobody is paid twice.
+ */
+class PayoutEngine : public QObject
+{
+    Q_OBJECT
+public:
+    PayoutEngine(RPC* rpc, QObject* parent = nullptr);
+    ~PayoutEngine();
+
+    // Read and check every row. On error, says which line is wrong and returns no rows.
+    static QList<PayoutRow>     readFile(const QString& fileName, QByteArray& hash, QString& error);
+    static QList<PayoutBatch>   planBatches(const QList<PayoutRow>& rows);
+
+    // Start the payout, or resume it if there is a journal for this file. fee is paid by each batch.
+    bool    start(const QString& fileName, const QStringList& sources, Amount fee, QString& error);
+
+    // Stop sending new batches. The ones komodod is already computing still finish and are recorded.
+    void    stop();
+
+    bool    isRunning() const           { return running; }
+    bool    isResumed() const           { return resumed; }
+
+    int     rowCount() const            { return rows.size(); }
+    int     batchCount() const          { return batches.size(); }
+    int     count(PayoutBatch::Status status) const;
+    Amount  totalAmount() const;
+
+    // Recipients paid per minute since start()
+    double  throughput() const;
+
+    QString report() const;
+
+    // The most recipients and shielded recipients that go into one z_sendmany
+    static const int maxOutputs     = 400;
+    static const int maxZOutputs    = 50;
+
+    static const int maxAttempts    = 3;
+
+signals:
+    void    progress(int batchesDone, int batchesFailed, int batches);
+    void    finished(bool allPaid);
+
+private:
+    enum Op : quint8 {
+        Plan        = 1,
+        Submitting,
+        Submitted,
+        Done,
+        Failed,
+        Lost                // May have gone out, but komodod's answer was lost or unreadable
+    };
+
+    struct Source {
+        QString addr;
+        bool    busy            = false;
+        int     readyAtBlock    = 0;    // Its change from the last batch is spendable from this block on
+    };
+
+    bool    openJournal(const QByteArray& hash, QString& error);
+    void    replay(const QByteArray& record);
+    void    journal(Op op, int batch, const QString& a = QString(), const QString& b = QString());
+
+    void    resumeSubmitted();
+    void    schedule();
+    void    submit(int batch, Source& source);
+    void    batchDone(int batch, const QString& txid);
+    void    batchFailed(int batch, const QString& error);
+    void    batchLost(int batch, const QString& error);
+    void    checkFinished();
+
+    Source* sourceFor(const QString& addr);
+    Tx      makeTx(const PayoutBatch& b) const;
+
+    RPC*                    rpc;
+    RecordLog               log;
+
+    QString                 fileName;
+    QList<PayoutRow>        rows;
+    QList<PayoutBatch>      batches;
+    QList<Source>           sources;
+    Amount                  fee;
+
+    bool                    running     = false;
+    bool                    resumed     = false;
+    QElapsedTimer           elapsed;
+    int                     rowsPaidAtStart = 0;
+};
+
+#endif // PAYOUTENGINE_H
@@ -6,6 +6,11 @@
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
+#include <cstring>
+#include <atomic>
+#include <array>
+#include <numeric>
+#include <initializer_list>
 
 #include <QtGlobal>
 
@@ -20,6 +25,8 @@
 #include <QStringBuilder>
 #include <QAbstractItemModel>
 #include <QTableView>
+#include <QTableWidget>
+#include <QListWidget>
 #include <QHeaderView>
 #include <QMessageBox>
 #include <QCheckBox>
@@ -28,15 +35,29 @@
 #include <QStandardItem>
 #include <QScrollBar>
 #include <QPainter>
+#include <QImage>
+#include <QCache>
+#include <QPdfWriter>
+#include <QFileInfo>
 #include <QMovie>
 #include <QPair>
+#include <QSet>
 #include <QVersionNumber>
 #include <QDir>
 #include <QMenu>
 #include <QCompleter>
+#include <QStringListModel>
 #include <QPushButton>
 #include <QDateTime>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QReadWriteLock>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QtEndian>
 #include <QSettings>
 #include <QStyle>
 #include <QFile>
@@ -50,8 +71,14 @@
 #include <QPlainTextEdit>
 #include <QLabel>
 #include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QDateEdit>
+#include <QSpinBox>
+#include <QPointer>
 #include <QInputDialog>
 #include <QFileDialog>
+#include <QProgressDialog>
 #include <QDebug>
 #include <QUrl>
 #include <QQueue>
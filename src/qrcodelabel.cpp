@@ -1,5 +1,15 @@
 #include "qrcodelabel.h"
 
+namespace {
+
+// Enough for every address in a wallet's receive tab. Each one is well under a KB.
+const int       cachedCodes = 256;
+
+QMutex                      cacheLock;
+QCache<QString, QImage>     cache(cachedCodes);
+
+}
+
 QRCodeLabel::QRCodeLabel(QWidget *parent) :
     QLabel(parent)
 {
@@ -19,39 +29,64 @@ void QRCodeLabel::resizeEvent(QResizeEvent*)
         QLabel::setPixmap(scaledPixmap());
 }
 
+QImage QRCodeLabel::moduleImage(const QString& text) {
+    {
+        QMutexLocker locker(&cacheLock);
+        if (auto cached = cache.object(text))
+            return *cached;
+    }
+
+    QImage img = encodeImage(text);
+
+    QMutexLocker locker(&cacheLock);
+    cache.insert(text, new QImage(img));
+    return img;
+}
+
+QImage QRCodeLabel::encodeImage(const QString& text) {
+    try {
+        qrcodegen::QrCode qr = qrcodegen::QrCode::encodeText(text.toUtf8().constData(), qrcodegen::QrCode::Ecc::LOW);
+        const int s = qr.getSize()>0?qr.getSize():1;
+
+        // Index 0 is white, 1 is black, so a fill with 0 is the border
+        QImage img(s + 2, s + 2, QImage::Format_Mono);
+        img.setColor(0, qRgb(255, 255, 255));
+        img.setColor(1, qRgb(0, 0, 0));
+        img.fill(0);
+
+        for(int y=0; y<s; y++) {
+            for(int x=0; x<s; x++) {
+                if (qr.getModule(x, y))
+                    img.setPixel(x + 1, y + 1, 1);
+            }
+        }
+
+        return img;
+    } catch (const std::length_error&) {
+        return QImage();    // Too long for the largest QR code
+    }
+}
+
 QPixmap QRCodeLabel::scaledPixmap() const {
     QPixmap pm(size());
     pm.fill(Qt::white);
+    if (modules.isNull())
+        return pm;
+
+    // A whole number of pixels per module, so every module is the same size and the edges stay sharp
+    const int n     = modules.width();
+    const int scale = qMax(1, qMin(pm.width(), pm.height()) / n);
+    const int side  = n * scale;
+
     QPainter painter(&pm);
-    
-    qrcodegen::QrCode qr = qrcodegen::QrCode::encodeText(str.toUtf8().constData(), qrcodegen::QrCode::Ecc::LOW);
-    const int    s      = qr.getSize()>0?qr.getSize():1;
-    const double w      = pm.width();
-    const double h      = pm.height();
-    const double aspect = w/h;
-    const double size   = ((aspect>1.0)?h:w);
-    const double scale  = size/(s+2);
-    const double woff   = (w - size) > 0 ? (w - size) / 2 : 0;
-    const double hoff   = (h - size) > 0 ? (h - size) / 2 : 0;
-    
-    // NOTE: For performance reasons my implementation only draws the foreground parts    
-    painter.setPen(Qt::NoPen);
-    painter.setBrush(QColor(Qt::black));
-    for(int y=0; y<s; y++) {
-        for(int x=0; x<s; x++) {
-            const int color=qr.getModule(x, y);  // 0 for white, 1 for black
-            if(0!=color) {
-                const double rx1=(x+1)*scale + woff, ry1=(y+1)*scale + hoff;
-                QRectF r(rx1, ry1, scale, scale);
-                painter.drawRects(&r,1);
-            }
-        }
-    }
-    
+    painter.drawImage(QPoint((pm.width() - side) / 2, (pm.height() - side) / 2),
+                      modules.scaled(side, side, Qt::IgnoreAspectRatio, Qt::FastTransformation));
+
     return pm;
 }
 
 void QRCodeLabel::setQrcodeString(QString stra) {
-    str = stra;
+    str     = stra;
+    modules = str.isEmpty() ? QImage() : moduleImage(str);
     QLabel::setPixmap(scaledPixmap());
-}
\ No newline at end of file
+}
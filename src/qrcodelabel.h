@@ -12,11 +12,21 @@ public:
     
     void            setQrcodeString(QString address);
     QPixmap         scaledPixmap() const;
+
+    // The QR code for text as a 1 bit image, one pixel per module, with a 1 module white border.
+    // Encoding is the slow part, so the images for recently shown strings are cached.
+    static QImage   moduleImage(const QString& text);
+
+    // The same image, encoded without going through the cache, for one-off codes like a printed sheet.
+    // Safe to call from any thread. Returns a null image if the text doesn't fit in a QR code.
+    static QImage   encodeImage(const QString& text);
+
 public slots:    
     void resizeEvent(QResizeEvent *);
 
 private:
     QString str;
+    QImage  modules;        // moduleImage(str)
 };
 
 
@@ -0,0 +1,273 @@
+#include "qrsheet.h"
+#include "qrcodelabel.h"
+#include "addressvalidator.h"
+#include "paymenturi.h"
+#include "recordlog.h"
+
+namespace {
+
+// Codes encoded per round on the thread pool. Enough to keep every core busy, without holding
+// the images for thousands of codes at once.
+const int batchSize = 256;
+
+// Page margins, in mm
+const double marginMM = 10;
+
+struct EncodeProgress {
+    QMutex          lock;
+    QWaitCondition  finished;
+    int             pending = 0;
+};
+
+class EncodeTask : public QRunnable {
+public:
+    EncodeTask(const QrSheetItem* i, int n, QImage* o, EncodeProgress* p)
+        : items(i), count(n), out(o), progress(p) {}
+
+    void run() override {
+        for (int i = 0; i < count; i++)
+            out[i] = QRCodeLabel::encodeImage(items[i].text);
+
+        QMutexLocker locker(&progress->lock);
+        if (--progress->pending == 0)
+            progress->finished.wakeAll();
+    }
+
+private:
+    const QrSheetItem*  items;
+    int                 count;
+    QImage*             out;
+    EncodeProgress*     progress;
+};
+
+}
+
+QrSheetWriter::QrSheetWriter(QrSheetOptions opts, QList<QrSheetItem> list, QObject* parent)
+    : QThread(parent), options(opts), items(list.toVector()) {
+    cancelled = false;
+
+    options.columns = qMax(1, options.columns);
+    options.rows    = qMax(1, options.rows);
+    options.dpi     = qBound(72, options.dpi, 1200);
+}
+
+QrSheetWriter::~QrSheetWriter() {
+    cancel();
+    wait();
+}
+
+QrSheetFormat QrSheetWriter::formatForFile(const QString& fileName) {
+    if (fileName.endsWith(".png", Qt::CaseInsensitive))
+        return QrSheetFormat::PNG;
+
+    return QrSheetFormat::PDF;
+}
+
+QString QrSheetWriter::pageFileName(const QString& fileName, int page, int pages) {
+    if (pages <= 1)
+        return fileName;
+
+    QFileInfo fi(fileName);
+    QString suffix = fi.suffix().isEmpty() ? QString("png") : fi.suffix();
+    return fi.dir().filePath(fi.completeBaseName() % "-" % QString("%1").arg(page, 3, 10, QChar('0')) % "." % suffix);
+}
+
+QList<QrSheetItem> QrSheetWriter::readItems(const QString& fileName, QString& error) {
+    QList<QrSheetItem> list;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        error = file.errorString();
+        return list;
+    }
+
+    QTextStream in(&file);
+    for (int lineNo = 1; !in.atEnd(); lineNo++) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        QrSheetItem item;
+        int comma = line.indexOf(',');
+        item.text  = (comma < 0 ? line : line.left(comma)).trimmed();
+        item.label = comma < 0 ? QString() : line.mid(comma + 1).trimmed();
+
+        bool ok = item.text.startsWith("thc:", Qt::CaseInsensitive) ? PaymentURI::parse(item.text).isValid()
+                                                                     : AddressValidator::isValid(item.text);
+        if (!ok) {
+            error = tr("Line %1 is not an address or a payment URI").arg(lineNo);
+            return QList<QrSheetItem>();
+        }
+
+        list.push_back(item);
+    }
+
+    return list;
+}
+
+bool QrSheetWriter::encodeBatch(int first, int count, QVector<QImage>& images, QString& error) {
+    images.clear();
+    images.resize(count);
+
+    // Each task encodes its own slice of the batch into its own part of images
+    EncodeProgress progress;
+    int threads = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    int chunk   = qMax(8, (count + threads - 1) / threads);
+    progress.pending = (count + chunk - 1) / chunk;
+
+    const QrSheetItem* src = &items.at(first);
+    for (int start = 0; start < count; start += chunk) {
+        QThreadPool::globalInstance()->start(
+            new EncodeTask(src + start, qMin(chunk, count - start), images.data() + start, &progress));
+    }
+
+    {
+        QMutexLocker locker(&progress.lock);
+        while (progress.pending > 0)
+            progress.finished.wait(&progress.lock);
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (images.at(i).isNull()) {
+            error = tr("Code %1 is too long to fit in a QR code").arg(first + i + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+void QrSheetWriter::paintPage(QPainter& painter, const QRect& area, const QImage* images, int first, int count) {
+    const int cellW  = area.width()  / options.columns;
+    const int cellH  = area.height() / options.rows;
+    const int labelH = cellH / 6;
+
+    QFont font = painter.font();
+    font.setPixelSize(qMax(1, labelH / 2));
+    painter.setFont(font);
+    QFontMetrics fm(font, painter.device());
+
+    for (int i = 0; i < count; i++) {
+        QRect cell(area.x() + (i % options.columns) * cellW, area.y() + (i / options.columns) * cellH, cellW, cellH);
+
+        // A whole number of device pixels per module, so the modules stay sharp when printed
+        const QImage& img  = images[i];
+        const int     room = qMin(cellW, cellH - labelH) * 9 / 10;
+        const int     side = qMax(1, room / img.width()) * img.width();
+        painter.drawImage(QRect(cell.x() + (cellW - side) / 2, cell.y() + (cellH - labelH - side) / 2, side, side), img);
+
+        const QrSheetItem& item = items.at(first + i);
+        QString label = item.label.isEmpty() ? item.text : item.label;
+        painter.drawText(QRect(cell.x(), cell.bottom() - labelH, cellW, labelH), Qt::AlignHCenter | Qt::AlignTop,
+                         fm.elidedText(label, Qt::ElideMiddle, cellW * 9 / 10));
+    }
+}
+
+void QrSheetWriter::run() {
+    if (items.isEmpty()) {
+        emit done(false, tr("There are no codes to print"));
+        return;
+    }
+
+    const int total   = items.size();
+    const int perPage = options.columns * options.rows;
+    const int pages   = (total + perPage - 1) / perPage;
+    const bool pdf    = options.format == QrSheetFormat::PDF;
+
+    // Everything is written to .tmp files first, which replace the targets once the whole sheet is done
+    QStringList targets;
+    QString     error;
+
+    QFile                       pdfFile(options.fileName % ".tmp");
+    std::unique_ptr<QPdfWriter> pdfWriter;
+    QPainter                    pdfPainter;
+    if (pdf) {
+        if (!pdfFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            emit done(false, pdfFile.errorString());
+            return;
+        }
+
+        pdfWriter.reset(new QPdfWriter(&pdfFile));
+        pdfWriter->setCreator("HempPAY");
+        pdfWriter->setResolution(options.dpi);
+        pdfWriter->setPageSize(QPageSize(QPageSize::A4));
+        pdfWriter->setPageMargins(QMarginsF(marginMM, marginMM, marginMM, marginMM), QPageLayout::Millimeter);
+        pdfPainter.begin(pdfWriter.get());
+        targets.push_back(options.fileName);
+    }
+
+    // PNG pages are painted into the same image one after the other
+    QImage page;
+    int    margin = qRound(marginMM / 25.4 * options.dpi);
+    if (!pdf) {
+        page = QImage(QPageSize(QPageSize::A4).sizePixels(options.dpi), QImage::Format_RGB32);
+        page.setDotsPerMeterX(qRound(options.dpi / 0.0254));
+        page.setDotsPerMeterY(qRound(options.dpi / 0.0254));
+    }
+
+    QVector<QImage> images;
+    int             batchFirst = 0;
+    const int       batchPages = qMax(1, batchSize / perPage);
+
+    for (int p = 0; p < pages && !cancelled; p++) {
+        int first = p * perPage;
+        int count = qMin(perPage, total - first);
+
+        // Batches are whole pages, so a page's codes are always in the current batch
+        if (p % batchPages == 0) {
+            batchFirst = first;
+            if (!encodeBatch(first, qMin(batchPages * perPage, total - first), images, error))
+                break;
+        }
+        const QImage* pageImages = images.constData() + (first - batchFirst);
+
+        if (pdf) {
+            if (p > 0 && !pdfWriter->newPage()) {
+                error = tr("Could not start page %1").arg(p + 1);
+                break;
+            }
+            paintPage(pdfPainter, QRect(0, 0, pdfWriter->width(), pdfWriter->height()), pageImages, first, count);
+        } else {
+            page.fill(Qt::white);
+            {
+                QPainter painter(&page);
+                paintPage(painter, page.rect().adjusted(margin, margin, -margin, -margin), pageImages, first, count);
+            }
+
+            QString target = pageFileName(options.fileName, p + 1, pages);
+            QFile   file(target % ".tmp");
+            targets.push_back(target);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || !page.save(&file, "PNG") ||
+                    !RecordLog::syncToDisk(file)) {
+                error = tr("Could not write %1").arg(target) % "\n" % file.errorString();
+                break;
+            }
+        }
+
+        emit progress(first + count, total);
+    }
+
+    if (pdf) {
+        pdfPainter.end();
+        pdfWriter.reset();
+        if (error.isEmpty() && !cancelled && !RecordLog::syncToDisk(pdfFile))
+            error = pdfFile.errorString();
+        pdfFile.close();
+    }
+
+    if (cancelled || !error.isEmpty()) {
+        for (const auto& target : targets)
+            QFile::remove(target % ".tmp");
+
+        emit done(false, error);
+        return;
+    }
+
+    for (const auto& target : targets) {
+        if (!RecordLog::replaceFile(target % ".tmp", target)) {
+            emit done(false, tr("Could not replace %1").arg(target));
+            return;
+        }
+    }
+
+    emit done(true, QString());
+}
@@ -0,0 +1,69 @@
+#ifndef QRSHEET_H
+#define QRSHEET_H
+
+#include "precompiled.h"
+
+enum class QrSheetFormat {
+    PDF = 1,
+    PNG                 // One image per page
+};
+
+struct QrSheetItem {
+    QString text;       // The address or payment URI that is encoded
+    QString label;      // Printed under the code. The text itself if empty.
+};
+
+struct QrSheetOptions {
+    QString         fileName;
+    QrSheetFormat   format      = QrSheetFormat::PDF;
+
+    // Codes per page, on A4
+    int             columns     = 4;
+    int             rows        = 6;
+    int             dpi         = 300;
+};
+
+/**
+ * Prints a list of QR codes onto pages of stickers, on a worker thread.
+ *
+ * The codes are encoded a batch at a time, spread over the thread pool, and each page is painted and
+ * written out as soon as its codes are ready, so only a batch of codes and one page are ever held
+ * in memory. The output is written to temp files that replace the targets at the end, so a cancelled
+ * or failed run leaves nothing behind.
+ */
+class QrSheetWriter : public QThread
+{
+    Q_OBJECT
+public:
+    QrSheetWriter(QrSheetOptions options, QList<QrSheetItem> items, QObject* parent = nullptr);
+    ~QrSheetWriter();
+
+    void    cancel()                { cancelled = true; }
+    bool    isCancelled() const     { return cancelled.load(); }
+
+    static  QrSheetFormat formatForFile(const QString& fileName);
+
+    // One code per line, as "text" or "text,label". Blank lines and lines starting with # are skipped.
+    static  QList<QrSheetItem> readItems(const QString& fileName, QString& error);
+
+    // The file a page of a PNG sheet goes to. Sheets of more than one page get numbered files.
+    static  QString pageFileName(const QString& fileName, int page, int pages);
+
+signals:
+    void    progress(int codesWritten, int total);
+    void    done(bool success, QString error);
+
+protected:
+    void    run() override;
+
+private:
+    bool    encodeBatch(int first, int count, QVector<QImage>& images, QString& error);
+    void    paintPage(QPainter& painter, const QRect& area, const QImage* images, int first, int count);
+
+    QrSheetOptions      options;
+    QVector<QrSheetItem> items;     // Contiguous, so each encode task can take a slice
+
+    std::atomic<bool>   cancelled;
+};
+
+#endif // QRSHEET_H
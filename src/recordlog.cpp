@@ -0,0 +1,313 @@
+#include "recordlog.h"
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+namespace {
+
+const char  Magic[]     = "HPRLOG01";
+const int   MagicSize   = 8;
+const int   HeaderSize  = 8;                    // length + crc
+const int   MaxRecord   = 16 * 1024 * 1024;     // Anything bigger is a corrupted length
+
+struct Crc32Table {
+    quint32 entries[256];
+
+    Crc32Table() {
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+    }
+};
+
+quint32 crc32(const char* data, int len) {
+    // Also used from the compaction thread, so this relies on the thread safe static init
+    static const Crc32Table table;
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (int i = 0; i < len; i++)
+        crc = table.entries[(crc ^ (quint8)data[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+}
+
+/**
+ * Writes the compacted log into a temp file on a worker thread, and hands the result back to the
+ * RecordLog on its own thread.
+ */
+class CompactionTask : public QRunnable {
+public:
+    CompactionTask(RecordLog* l, QString tmp, QList<QByteArray> recs, quint64 gen) :
+        log(l), tmpName(tmp), records(recs), generation(gen) {}
+
+    void run() override {
+        QFile out(tmpName);
+        bool ok = out.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+                  out.write(Magic, MagicSize) == MagicSize;
+        for (const auto& rec : records) {
+            if (!ok)
+                break;
+            ok = RecordLog::writeRecord(out, rec);
+        }
+        ok = ok && RecordLog::syncToDisk(out);
+        out.close();
+
+        QMetaObject::invokeMethod(log, "finishCompaction", Qt::QueuedConnection,
+                                  Q_ARG(quint64, generation), Q_ARG(bool, ok));
+
+        QMutexLocker locker(&log->taskMutex);
+        log->taskRunning = false;
+        log->taskDone.wakeAll();
+    }
+
+private:
+    RecordLog*          log;
+    QString             tmpName;
+    QList<QByteArray>   records;
+    quint64             generation;
+};
+
+RecordLog::RecordLog(QObject* parent) : QObject(parent) {
+    syncTimer.setSingleShot(true);
+    syncTimer.setInterval(syncDelay);
+    QObject::connect(&syncTimer, &QTimer::timeout, this, &RecordLog::sync);
+}
+
+RecordLog::~RecordLog() {
+    // The compaction task posts back to this object, so it has to be done before we go away
+    {
+        QMutexLocker locker(&taskMutex);
+        while (taskRunning)
+            taskDone.wait(&taskMutex);
+    }
+
+    close();
+}
+
+bool RecordLog::open(const QString& fileName, QList<QByteArray>* records) {
+    close();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadWrite))
+        return false;
+
+    // Map the file instead of reading it in, so the records are copied out only once
+    qint64      size   = file.size();
+    uchar*      mapped = size > 0 ? file.map(0, size) : nullptr;
+    QByteArray  all;
+    if (mapped == nullptr && size > 0) {
+        all  = file.readAll();
+        size = all.size();
+    }
+    const char* p    = mapped != nullptr ? (const char*)mapped : all.constData();
+    qint64      good = MagicSize;
+
+    count = 0;
+    if (size < MagicSize) {
+        // New file, or one that didn't even get its header written
+        if (mapped != nullptr)
+            file.unmap(mapped);
+        file.resize(0);
+        file.seek(0);
+        file.write(Magic, MagicSize);
+        file.flush();
+    } else if (memcmp(p, Magic, MagicSize) != 0) {
+        qDebug() << "Not a record log:" << fileName;
+        if (mapped != nullptr)
+            file.unmap(mapped);
+        file.close();
+        return false;
+    } else {
+        while (good + HeaderSize <= size) {
+            quint32 len = qFromLittleEndian<quint32>(p + good);
+            quint32 crc = qFromLittleEndian<quint32>(p + good + 4);
+            if (len > (quint32)MaxRecord || good + HeaderSize + len > size)
+                break;
+            if (crc32(p + good + HeaderSize, (int)len) != crc)
+                break;
+
+            if (records != nullptr)
+                records->push_back(QByteArray(p + good + HeaderSize, (int)len));
+
+            good += HeaderSize + len;
+            count++;
+        }
+
+        if (mapped != nullptr)
+            file.unmap(mapped);
+
+        // Cut off a torn write at the end, so new records are appended after the last good one
+        if (good < size) {
+            qDebug() << "Dropping" << (size - good) << "bytes of incomplete records from" << fileName;
+            file.resize(good);
+        }
+    }
+
+    file.seek(file.size());
+    return true;
+}
+
+void RecordLog::close() {
+    // Any compaction in flight is for the old file
+    generation++;
+    compacting = false;
+    appendedDuringCompaction.clear();
+
+    if (file.isOpen()) {
+        sync();
+        file.close();
+    }
+}
+
+bool RecordLog::writeRecord(QFile& f, const QByteArray& record) {
+    char header[HeaderSize];
+    qToLittleEndian<quint32>((quint32)record.size(), header);
+    qToLittleEndian<quint32>(crc32(record.constData(), record.size()), header + 4);
+
+    if (f.write(header, HeaderSize) != HeaderSize || f.write(record) != record.size())
+        return false;
+
+    // Hand it to the OS right away, so only the fsync is deferred
+    return f.flush();
+}
+
+bool RecordLog::append(const QByteArray& record) {
+    if (!file.isOpen())
+        return false;
+
+    if (!writeRecord(file, record)) {
+        qDebug() << "Failed to append to" << file.fileName() << file.errorString();
+        return false;
+    }
+    count++;
+
+    if (compacting)
+        appendedDuringCompaction.push_back(record);
+
+    if (!syncTimer.isActive())
+        syncTimer.start();
+
+    return true;
+}
+
+bool RecordLog::clear() {
+    if (!file.isOpen())
+        return false;
+
+    generation++;
+    compacting = false;
+    appendedDuringCompaction.clear();
+
+    file.resize(0);
+    file.seek(0);
+    bool ok = file.write(Magic, MagicSize) == MagicSize;
+    ok = ok && syncToDisk(file);
+    count = 0;
+
+    return ok;
+}
+
+bool RecordLog::sync() {
+    syncTimer.stop();
+    return file.isOpen() && syncToDisk(file);
+}
+
+void RecordLog::compact(const QList<QByteArray>& live) {
+    if (!file.isOpen() || compacting)
+        return;
+
+    // Only one task at a time, since they all write to the same temp file
+    {
+        QMutexLocker locker(&taskMutex);
+        if (taskRunning)
+            return;
+        taskRunning = true;
+    }
+
+    compacting = true;
+    appendedDuringCompaction.clear();
+
+    auto task = new CompactionTask(this, file.fileName() % ".compact", live, generation);
+    task->setAutoDelete(true);
+    QThreadPool::globalInstance()->start(task);
+}
+
+void RecordLog::finishCompaction(quint64 gen, bool ok) {
+    QString name = file.fileName();
+    QString tmp  = name % ".compact";
+
+    // A compaction for a file that has since been cleared or reopened is just dropped. Its temp
+    // file gets overwritten by the next one.
+    if (gen != generation || !compacting)
+        return;
+
+    if (!ok) {
+        QFile::remove(tmp);
+        compacting = false;
+        return;
+    }
+    compacting = false;
+
+    // Carry over everything that was appended while the worker was writing
+    QFile out(tmp);
+    bool done = out.open(QIODevice::Append);
+    for (const auto& rec : appendedDuringCompaction) {
+        if (!done)
+            break;
+        done = writeRecord(out, rec);
+    }
+    done = done && syncToDisk(out);
+    out.close();
+
+    if (!done) {
+        QFile::remove(tmp);
+        appendedDuringCompaction.clear();
+        return;
+    }
+
+    // Swap the files. Until the rename, the old file is still complete on disk.
+    sync();
+    file.close();
+
+    if (!replaceFile(tmp, name)) {
+        qDebug() << "Couldn't replace" << name << "with the compacted log";
+        QFile::remove(tmp);
+    }
+
+    appendedDuringCompaction.clear();
+
+    // The records are already in memory with the owner, so only the count needs to be read back
+    open(name, nullptr);
+
+    emit compacted();
+}
+
+bool RecordLog::syncToDisk(QFile& f) {
+    if (!f.flush())
+        return false;
+
+#ifdef Q_OS_WIN
+    return _commit(f.handle()) == 0;
+#else
+    return ::fsync(f.handle()) == 0;
+#endif
+}
+
+bool RecordLog::replaceFile(const QString& from, const QString& to) {
+#ifdef Q_OS_WIN
+    return MoveFileExW((const wchar_t*)from.utf16(), (const wchar_t*)to.utf16(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
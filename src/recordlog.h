@@ -0,0 +1,76 @@
+#ifndef RECORDLOG_H
+#define RECORDLOG_H
+
+#include "precompiled.h"
+
+/**
+ * Append-only file of checksummed binary records.
+ *
+ * Each record is written as [length][crc32][payload]. On open, all intact records are read back and
+ * a torn record at the end (from a crash in the middle of a write) is cut off. Appends go straight
+ * to the end of the file, and the fsync for everything appended within syncDelay ms is done once,
+ * from a timer, instead of once per record.
+ *
+ * The owner knows which records are still live, so it triggers compaction by handing over the
+ * records to keep. The new file is written on a worker thread and swapped in atomically, and any
+ * records appended in the meantime are carried over.
+ */
+class RecordLog : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RecordLog(QObject* parent = nullptr);
+    ~RecordLog();
+
+    bool    open(const QString& fileName, QList<QByteArray>* records);
+    void    close();
+    bool    isOpen() const          { return file.isOpen(); }
+    QString fileName() const        { return file.fileName(); }
+
+    bool    append(const QByteArray& record);
+
+    // Remove all records
+    bool    clear();
+
+    // Force the pending appends to disk now, instead of waiting for the sync timer
+    bool    sync();
+
+    // Rewrite the log in the background with just these records
+    void    compact(const QList<QByteArray>& live);
+    bool    isCompacting() const    { return compacting; }
+
+    int     recordCount() const     { return count; }
+
+    static const int syncDelay = 200;  // ms
+
+    // fsync a file, and atomically rename one file over another. Also used for the other files the
+    // wallet writes whole.
+    static bool       syncToDisk(QFile& f);
+    static bool       replaceFile(const QString& from, const QString& to);
+
+signals:
+    void    compacted();
+
+private:
+    Q_INVOKABLE void finishCompaction(quint64 generation, bool ok);
+
+    static bool       writeRecord(QFile& f, const QByteArray& record);
+
+    friend class CompactionTask;
+
+    QFile               file;
+    QTimer              syncTimer;
+    int                 count           = 0;
+
+    // Bumped whenever the file is cleared or reopened, so a compaction that started before it is discarded
+    quint64             generation      = 0;
+
+    bool                compacting      = false;
+    QList<QByteArray>   appendedDuringCompaction;
+
+    QMutex              taskMutex;
+    QWaitCondition      taskDone;
+    bool                taskRunning     = false;
+};
+
+#endif // RECORDLOG_H
@@ -13,8 +13,13 @@ void Recurring::showEditDialog(QWidget* parent, MainWindow* main, Tx tx) {
 
     // Add all the from addresses
     auto allBalances = main->getRPC()->getAllBalances();
-    for (QString addr : allBalances->keys()) {
-        ui.cmbFromAddress->addItem(addr, allBalances->value(addr));
+    QList<QPair<QString, Amount>> fromAddrs;
+    for (auto it = allBalances->constBegin(); it != allBalances->constEnd(); ++it) {
+        fromAddrs.push_back(qMakePair(it.key(), it.value()));
+    }
+    std::sort(fromAddrs.begin(), fromAddrs.end());
+    for (const auto& from : fromAddrs) {
+        ui.cmbFromAddress->addItem(from.first, from.second);
     }
     
     if (!tx.fromAddr.isEmpty()) {
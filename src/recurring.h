@@ -16,7 +16,7 @@ struct RecurringPaymentInfo {
     QString         desc;
     QString         fromAddr;
     QString         toAddr;
-    double          amt;
+    Amount          amt;
     QString         currency;
     Schedule        schedule;
     int             numPayments;
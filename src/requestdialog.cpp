@@ -2,6 +2,7 @@
 #include "ui_requestdialog.h"
 #include "settings.h"
 #include "addressbook.h"
+#include "addresslistmodel.h"
 #include "mainwindow.h"
 #include "rpc.h"
 #include "settings.h"
@@ -31,12 +32,7 @@ void RequestDialog::setupDialog(MainWindow* main, QDialog* d, Ui_RequestDialog*
     if (!main || !main->getRPC() || !main->getRPC()->getAllZAddresses() || !main->getRPC()->getAllBalances())
         return;
 
-    for (auto addr : *main->getRPC()->getAllZAddresses()) {
-        auto bal = main->getRPC()->getAllBalances()->value(addr);
-        if (Settings::getInstance()->isSaplingAddress(addr)) {
-            req->cmbMyAddress->addItem(addr, bal);
-        }
-    }
+    req->cmbMyAddress->setModel(AddressListModel::get(AddressListModel::SaplingAddresses));
     req->cmbMyAddress->setCurrentText(main->getRPC()->getDefaultSaplingAddress());
 
     QIcon icon(":/icons/res/paymentreq.gif");
@@ -52,6 +48,13 @@ void RequestDialog::showPaymentConfirmation(MainWindow* main, QString paymentURI
         return;
     }
 
+    // The dialog only has room for one payee, so requests to pay several go straight to the send tab
+    if (payInfo.recipients.size() > 1) {
+        main->payZcashURI(paymentURI);
+        return;
+    }
+    const auto& payee = payInfo.recipients.first();
+
     QDialog d(main);
     Ui_RequestDialog req;
     setupDialog(main, &d, &req);    
@@ -70,10 +73,10 @@ void RequestDialog::showPaymentConfirmation(MainWindow* main, QString paymentURI
     // No "address is visible" warning
     req.lblAddressInfo->setVisible(false);
 
-    req.txtFrom->setText(payInfo.addr);
-    req.txtMemo->setPlainText(payInfo.memo);
-    req.txtAmount->setText(payInfo.amt);
-    req.txtAmountUSD->setText(Settings::getUSDFormat(req.txtAmount->text().toDouble()));
+    req.txtFrom->setText(payee.addr);
+    req.txtMemo->setPlainText(payee.memo);
+    req.txtAmount->setText(Settings::getDecimalString(payee.amount));
+    req.txtAmountUSD->setText(Settings::getUSDFormat(Amount::fromString(req.txtAmount->text())));
 
     req.buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Pay"));
 
@@ -112,9 +115,9 @@ void RequestDialog::showRequestZcash(MainWindow* main) {
     // Amount textbox
     req.txtAmount->setValidator(main->getAmountValidator());
     QObject::connect(req.txtAmount, &QLineEdit::textChanged, [=] (auto text) {
-        req.txtAmountUSD->setText(Settings::getUSDFormat(text.toDouble()));
+        req.txtAmountUSD->setText(Settings::getUSDFormat(Amount::fromString(text)));
     });
-    req.txtAmountUSD->setText(Settings::getUSDFormat(req.txtAmount->text().toDouble()));
+    req.txtAmountUSD->setText(Settings::getUSDFormat(Amount::fromString(req.txtAmount->text())));
 
     req.txtMemo->setAcceptButton(req.buttonBox->button(QDialogButtonBox::Ok));
     req.txtMemo->setLenDisplayLabel(req.lblMemoLen);
@@ -125,7 +128,7 @@ void RequestDialog::showRequestZcash(MainWindow* main) {
     if (d.exec() == QDialog::Accepted) {
         // Construct a zcash Payment URI with the data and pay it immediately.
         QString memoURI = "thc:" + req.cmbMyAddress->currentText()
-                    + "?amt=" + Settings::getDecimalString(req.txtAmount->text().toDouble())
+                    + "?amt=" + Settings::getDecimalString(Amount::fromString(req.txtAmount->text()))
                     + "&memo=" + QUrl::toPercentEncoding(req.txtMemo->toPlainText());
 
         QString sendURI = "thc:" + AddressBook::addressFromAddressLabel(req.txtFrom->text()) 
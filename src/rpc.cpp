@@ -1,11 +1,15 @@
 #include "rpc.h"
 
 #include "addressbook.h"
+#include "addresspool.h"
+#include "invoicestore.h"
 #include "settings.h"
 #include "senttxstore.h"
 #include "turnstile.h"
 #include "version.h"
 #include "websockets.h"
+#include "walletstate.h"
+#include "walletdiff.h"
 
 using json = nlohmann::json;
 
@@ -19,6 +23,7 @@ RPC::RPC(MainWindow* main) {
     this->ui = main->ui;
 
     this->turnstile = new Turnstile(this, main);
+    this->addressPool = new AddressPool(this);
 
     // Setup balances table model
     balancesTableModel = new BalancesTableModel(main->ui->balancesTable);
@@ -29,6 +34,17 @@ RPC::RPC(MainWindow* main) {
     main->ui->transactionsTable->setModel(transactionsTableModel);
     main->ui->transactionsTable->horizontalHeader()->setSectionResizeMode(3, QHeaderView::Stretch);
 
+    // Show what we had last time, until the node is up and the first refresh is done
+    showSavedState();
+
+    // The state is saved a little after a refresh, once all the parts of it have come in
+    stateTimer = new QTimer(main);
+    stateTimer->setSingleShot(true);
+    stateTimer->setInterval(5 * 1000);
+    QObject::connect(stateTimer, &QTimer::timeout, [=]() {
+        saveState();
+    });
+
     // Set up timer to refresh Price
     priceTimer = new QTimer(main);
     QObject::connect(priceTimer, &QTimer::timeout, [=]() {
@@ -53,22 +69,36 @@ RPC::RPC(MainWindow* main) {
     // Start at every 10s. When an operation is pending, this will change to every second
     txTimer->start(Settings::updateSpeed);  
 
-    usedAddresses = new QMap<QString, bool>();
+    // Show newly sent z txs (or a cleared history) right away, without waiting for the next refresh
+    QObject::connect(SentTxStore::getInstance(), &SentTxStore::changed, main, [=]() {
+        if (conn != nullptr)
+            refreshSentZTrans();
+    });
+
+    // Each refresh publishes a new snapshot, and the views update just the rows that changed in it
+    QObject::connect(WalletDiff::getInstance(), &WalletDiff::changed, main, [=] (const WalletChangeSet& changes) {
+        balancesTableModel->applyChanges(changes);
+        transactionsTableModel->applyChanges(changes);
+        InvoiceStore::getInstance()->applyChanges(changes);
+
+        if (changes.has(WalletDelta::BalanceChanged) || changes.has(WalletDelta::AddressAdded))
+            main->updateFromCombo();
+    });
+
+    usedAddresses = new AddressMap<bool>();
 }
 
 RPC::~RPC() {
     delete timer;
     delete txTimer;
+    delete stateTimer;
 
     delete transactionsTableModel;
     delete balancesTableModel;
     delete turnstile;
+    delete addressPool;
 
-    delete utxos;
-    delete allBalances;
     delete usedAddresses;
-    delete zaddresses;
-    delete taddresses;
 
     delete conn;
 }
@@ -265,7 +295,7 @@ void RPC::getTransactions(const std::function<void(json)>& cb) {
 }
 
 void RPC::sendZTransaction(json params, const std::function<void(json)>& cb, 
-    const std::function<void(QString)>& err) {
+    const std::function<void(QString, bool)>& err) {
     json payload = {
         {"jsonrpc", "1.0"},
         {"id", "someid"},
@@ -274,10 +304,12 @@ void RPC::sendZTransaction(json params, const std::function<void(json)>& cb,
     };
 
     conn->doRPC(payload, cb,  [=] (auto reply, auto parsed) {
-        if (!parsed.is_discarded() && !parsed["error"]["message"].is_null()) {
-            err(QString::fromStdString(parsed["error"]["message"]));    
+        // Only a JSON-RPC error object means komodod looked at it and turned it down. A timeout, a reset
+        // connection or a reply that can't be read says nothing about whether it was sent.
+        if (parsed.is_object() && parsed["error"].is_object() && parsed["error"]["message"].is_string()) {
+            err(QString::fromStdString(parsed["error"]["message"]), true);
         } else {
-            err(reply->errorString());
+            err(reply->errorString(), false);
         }
     });
 }
@@ -383,9 +415,7 @@ void RPC::fillTxJsonParams(json& params, Tx tx) {
         // Construct the JSON params
         json rec = json::object();
         rec["address"]      = toAddr.addr.toStdString();
-        // Force it through string for rounding. Without this, decimal points beyond 8 places
-        // will appear, causing an "invalid amount" error
-        rec["amount"]       = Settings::getDecimalString(toAddr.amount).toStdString(); //.toDouble(); 
+        rec["amount"]       = toAddr.amount.toJson();
         if (toAddr.addr.startsWith("z") && !toAddr.encodedMemo.trimmed().isEmpty())
             rec["memo"]     = toAddr.encodedMemo.toStdString();
 
@@ -399,7 +429,7 @@ void RPC::fillTxJsonParams(json& params, Tx tx) {
     // Add fees if custom fees are allowed.
     if (Settings::getInstance()->getAllowCustomFees()) {
         params.push_back(1); // minconf
-        params.push_back(tx.fee);
+        params.push_back(tx.fee.toJsonNumber());
     }
 }
 
@@ -412,12 +442,14 @@ void RPC::noConnection() {
     main->statusLabel->setToolTip("");
     main->ui->statusBar->showMessage(QObject::tr("No Connection"), 1000);
 
-    // Clear balances table.
-    QMap<QString, double> emptyBalances;
-    QList<UnspentOutput>  emptyOutputs;
-    balancesTableModel->setNewData(&emptyBalances, &emptyOutputs);
+    // Nothing is known about the wallet without a node
+    WalletSnapshots::getInstance()->update([] (WalletSnapshot& s) {
+        s = WalletSnapshot();
+    });
+
+    // Clear the tables, in case they are still showing the saved state
+    balancesTableModel->setNewData(std::make_shared<WalletSnapshot>());
 
-    // Clear Transactions table.
     QList<TransactionItem> emptyTxs;
     transactionsTableModel->addTData(emptyTxs);
     transactionsTableModel->addZRecvData(emptyTxs);
@@ -432,9 +464,6 @@ void RPC::noConnection() {
     ui->balSheilded->setToolTip("");
     ui->balTransparent->setToolTip("");
     ui->balTotal->setToolTip("");
-
-    // Clear send tab from address
-    ui->inputsCombo->clear();
 }
 
 // Refresh received z txs by calling z_listreceivedbyaddress/gettransaction
@@ -442,10 +471,22 @@ void RPC::refreshReceivedZTrans(QList<QString> zaddrs) {
     if  (conn == nullptr) 
         return noConnection();
 
-    // We'll only refresh the received Z txs if settings allows us.
-    if (!Settings::getInstance()->getSaveZtxs()) {
-        QList<TransactionItem> emptylist;
-        transactionsTableModel->addZRecvData(emptylist);
+    // We'll only refresh the received Z txs if settings allows us. Except for the payments to open invoices,
+    // which are needed to tell if they're paid. Those are listed without their memos.
+    bool withMemos = Settings::getInstance()->getSaveZtxs();
+    if (!withMemos) {
+        zaddrs.clear();
+        for (const auto& addr : InvoiceStore::getInstance()->openAddresses()) {
+            if (!Settings::isTAddress(addr))
+                zaddrs.push_back(addr);
+        }
+    }
+
+    if (zaddrs.isEmpty()) {
+        WalletSnapshots::getInstance()->update([] (WalletSnapshot& s) {
+            s.zRecvTxs.clear();
+            s.hasZRecvTxs = true;
+        });
         return;
     }
         
@@ -454,8 +495,9 @@ void RPC::refreshReceivedZTrans(QList<QString> zaddrs) {
     // Additionally, it has to be done in batches, because there are multiple z-Addresses, 
     // and each z-Addr can have multiple received txs. 
 
-    // 1. For each z-Addr, get list of received txs    
-    conn->doBatchRPC<QString>(zaddrs,
+    // 1. For each z-Addr, get list of received txs. These all go in one request, so a refresh doesn't cost a
+    // round trip per address.
+    conn->doBatchRPCInOneRequest<QString>(zaddrs,
         [=] (QString zaddr) {
             json payload = {
                 {"jsonrpc", "1.0"},
@@ -473,6 +515,9 @@ void RPC::refreshReceivedZTrans(QList<QString> zaddrs) {
             QMap<QString, QString> memos;
             for (auto it = zaddrTxids->constBegin(); it != zaddrTxids->constEnd(); it++) {
                 auto zaddr = it.key();
+                if (!it.value().is_array())     // The call for this address failed
+                    continue;
+
                 for (auto& i : it.value().get<json::array_t>()) {   
                     // Mark the address as used
                     usedAddresses->insert(zaddr, true);
@@ -484,7 +529,7 @@ void RPC::refreshReceivedZTrans(QList<QString> zaddrs) {
 
                         // Check for Memos
                         QString memoBytes = QString::fromStdString(i["memo"].get<json::string_t>());
-                        if (!memoBytes.startsWith("f600"))  {
+                        if (withMemos && !memoBytes.startsWith("f600"))  {
                             QString memo(QByteArray::fromHex(
                                             QByteArray::fromStdString(i["memo"].get<json::string_t>())));
                             if (!memo.trimmed().isEmpty())
@@ -511,6 +556,9 @@ void RPC::refreshReceivedZTrans(QList<QString> zaddrs) {
 
                     // Combine them both together. For every zAddr's txid, get the amount, fee, confirmations and time
                     for (auto it = zaddrTxids->constBegin(); it != zaddrTxids->constEnd(); it++) {                        
+                        if (!it.value().is_array())
+                            continue;
+
                         for (auto& i : it.value().get<json::array_t>()) {   
                             // Filter out change txs
                             if (i["change"].get<json::boolean_t>())
@@ -529,16 +577,19 @@ void RPC::refreshReceivedZTrans(QList<QString> zaddrs) {
                                 timestamp = txidInfo["blocktime"].get<json::number_unsigned_t>();
                             }
                             
-                            auto amount        = i["amount"].get<json::number_float_t>();
+                            auto amount        = Amount::fromJson(i["amount"]);
                             auto confirmations = (unsigned long)txidInfo["confirmations"].get<json::number_unsigned_t>();                            
 
                             TransactionItem tx{ QString("receive"), timestamp, zaddr, txid, amount, 
-                                                confirmations, "", memos.value(zaddr + txid, "") };
+                                                confirmations, "", memos.value(zaddr + txid, ""), outputIndex(i) };
                             txdata.push_front(tx);
                         }
                     }
 
-                    transactionsTableModel->addZRecvData(txdata);
+                    WalletSnapshots::getInstance()->update([&] (WalletSnapshot& s) {
+                        s.zRecvTxs    = txdata;
+                        s.hasZRecvTxs = true;
+                    });
 
                     // Cleanup both responses;
                     delete zaddrTxids;
@@ -554,6 +605,8 @@ void RPC::refresh(bool force) {
     if  (conn == nullptr) 
         return noConnection();
 
+    TRACE_SPAN("RPC::refresh");
+
     getInfoThenRefresh(force);
 }
 
@@ -573,12 +626,17 @@ void RPC::getInfoThenRefresh(bool force) {
 
     static bool prevCallSucceeded = false;
     conn->doRPC(payload, [=] (const json& reply) {   
+        TRACE_SPAN("RPC::getInfoThenRefresh reply");
         prevCallSucceeded = true;
         // Testnet?
         if (!reply["testnet"].is_null()) {
             Settings::getInstance()->setTestnet(reply["testnet"].get<json::boolean_t>());
         };
 
+        // The saved state that's showing is from the other network
+        if (showingSavedState && savedStateTestnet != Settings::getInstance()->isTestnet())
+            clearSavedState();
+
         // Connected, so display checkmark.
         QIcon i(":/icons/res/connected.gif");
         main->statusIcon->setPixmap(i.pixmap(16, 16));
@@ -704,7 +762,7 @@ void RPC::getInfoThenRefresh(bool force) {
                 " THC/USD=$" % QString::number( (double) Settings::getInstance()->getZECPrice() );
             main->statusLabel->setText(statusText);   
 
-            auto zecPrice = Settings::getUSDFormat(1);
+            auto zecPrice = Settings::getUSDFormat(Amount::fromZats(Amount::COIN));
             QString tooltip;
             if (connections > 0) {
                 tooltip = QObject::tr("Connected to thcd");
@@ -742,39 +800,49 @@ void RPC::refreshAddresses() {
     if  (conn == nullptr) 
         return noConnection();
     
-    auto newzaddresses = new QList<QString>();
-
     getZAddresses([=] (json reply) {
+        QList<QString> newzaddresses;
         for (auto& it : reply.get<json::array_t>()) {   
             auto addr = QString::fromStdString(it.get<json::string_t>());
-            newzaddresses->push_back(addr);
+            newzaddresses.push_back(addr);
         }
 
-        delete zaddresses;
-        zaddresses = newzaddresses;
+        // The pooled addresses aren't shown until they're handed out
+        addressPool->filter(AddressPool::Sapling, newzaddresses);
+
+        WalletSnapshots::getInstance()->update([&] (WalletSnapshot& s) {
+            s.zaddresses    = newzaddresses;
+            s.hasZAddresses = true;
+        });
 
         // Refresh the sent and received txs from all these z-addresses
         refreshSentZTrans();
-        refreshReceivedZTrans(*zaddresses);
+        refreshReceivedZTrans(newzaddresses);
     });
 
-    
-    auto newtaddresses = new QList<QString>();
     getTAddresses([=] (json reply) {
+        QList<QString> newtaddresses;
         for (auto& it : reply.get<json::array_t>()) {   
             auto addr = QString::fromStdString(it.get<json::string_t>());
             if (Settings::isTAddress(addr))
-                newtaddresses->push_back(addr);
+                newtaddresses.push_back(addr);
         }
 
-        delete taddresses;
-        taddresses = newtaddresses;
+        addressPool->filter(AddressPool::Transparent, newtaddresses);
 
-        // If there are no t Addresses, create one
-        newTaddr([=] (json reply) {
-            // What if taddress gets deleted before this executes?
-            taddresses->append(QString::fromStdString(reply.get<json::string_t>()));
+        WalletSnapshots::getInstance()->update([&] (WalletSnapshot& s) {
+            s.taddresses    = newtaddresses;
+            s.hasTAddresses = true;
         });
+
+        // If there are no t Addresses, hand one out. The pool adds it to the list. Refreshes that come in while
+        // it's on its way don't ask for another one.
+        if (newtaddresses.isEmpty() && !creatingTAddr) {
+            creatingTAddr = true;
+            addressPool->take(AddressPool::Transparent, [=] (QString) {
+                creatingTAddr = false;
+            });
+        }
     });
 }
 
@@ -782,15 +850,18 @@ void RPC::refreshAddresses() {
 void RPC::updateUI(bool anyUnconfirmed) {    
     ui->unconfirmedWarning->setVisible(anyUnconfirmed);
 
-    // Update balances model data, which will update the table too
-    balancesTableModel->setNewData(allBalances, utxos);
+    // The balances table has already picked up the new snapshot's changes
+    balancesTableModel->setStale(false);
 
-    // Update from address
-    main->updateFromCombo();
+    if (showingSavedState) {
+        showingSavedState = false;
+        ui->statusBar->clearMessage();
+    }
+    scheduleStateSave();
 };
 
 // Function to process reply of the listunspent and z_listunspent API calls, used below.
-bool RPC::processUnspent(const json& reply, QMap<QString, double>* balancesMap, QList<UnspentOutput>* newUtxos) {
+bool RPC::processUnspent(const json& reply, AddressMap<Amount>* balancesMap, QList<UnspentOutput>* newUtxos) {
     bool anyUnconfirmed = false;
     for (auto& it : reply.get<json::array_t>()) {
         QString qsAddr = QString::fromStdString(it["address"]);
@@ -799,12 +870,12 @@ bool RPC::processUnspent(const json& reply, QMap<QString, double>* balancesMap,
             anyUnconfirmed = true;
         }
 
+        auto amount = Amount::fromJson(it["amount"]);
         newUtxos->push_back(
-            UnspentOutput{ qsAddr, QString::fromStdString(it["txid"]),
-                            Settings::getDecimalString(it["amount"].get<json::number_float_t>()),
-                            (int)confirmations, it["spendable"].get<json::boolean_t>() });
+            UnspentOutput{ qsAddr, QString::fromStdString(it["txid"]), amount,
+                            (int)confirmations, it["spendable"].get<json::boolean_t>(), outputIndex(it) });
 
-        (*balancesMap)[qsAddr] = (*balancesMap)[qsAddr] + it["amount"].get<json::number_float_t>();
+        (*balancesMap)[AddressRegistry::getInstance()->intern(qsAddr)] += amount;
     }
     return anyUnconfirmed;
 };
@@ -815,9 +886,9 @@ void RPC::refreshBalances() {
 
     // 1. Get the Balances
     getBalance([=] (json reply) {    
-        auto balT      = QString::fromStdString(reply["transparent"]).toDouble();
-        auto balZ      = QString::fromStdString(reply["private"]).toDouble();
-        auto balTotal  = QString::fromStdString(reply["total"]).toDouble();
+        auto balT      = Amount::fromJson(reply["transparent"]);
+        auto balZ      = Amount::fromJson(reply["private"]);
+        auto balTotal  = Amount::fromJson(reply["total"]);
 
         AppDataModel::getInstance()->setBalances(balT, balZ);
 
@@ -834,23 +905,30 @@ void RPC::refreshBalances() {
     });
 
     // 2. Get the UTXOs
-    // First, create a new UTXO list. It will be replacing the existing list when everything is processed.
-    auto newUtxos = new QList<UnspentOutput>();
-    auto newBalances = new QMap<QString, double>();
+    // First, create a new UTXO list. It will be published in the next snapshot when everything is processed.
+    auto newUtxos = std::make_shared<QList<UnspentOutput>>();
+    auto newBalances = std::make_shared<AddressMap<Amount>>();
+
+    // The UTXOs are at least as new as the block we know of now
+    int utxosBlock = Settings::getInstance()->getBlockNumber();
 
     // Call the Transparent and Z unspent APIs serially and then, once they're done, update the UI
     getTransparentUnspent([=] (json reply) {
-        auto anyTUnconfirmed = processUnspent(reply, newBalances, newUtxos);
+        auto anyTUnconfirmed = processUnspent(reply, newBalances.get(), newUtxos.get());
 
         getZUnspent([=] (json reply) {
-            auto anyZUnconfirmed = processUnspent(reply, newBalances, newUtxos);
-
-            // Swap out the balances and UTXOs
-            delete allBalances;
-            delete utxos;
-
-            allBalances = newBalances;
-            utxos       = newUtxos;
+            TRACE_SPAN("RPC::refreshBalances update");
+            auto anyZUnconfirmed = processUnspent(reply, newBalances.get(), newUtxos.get());
+
+            // Publish the balances and UTXOs together, so no reader sees one without the other
+            WalletSnapshots::getInstance()->update([&] (WalletSnapshot& s) {
+                s.balances      = *newBalances;
+                s.utxos         = *newUtxos;
+                s.utxosBlock    = utxosBlock;
+                s.balT          = AppDataModel::getInstance()->getTBalance();
+                s.balZ          = AppDataModel::getInstance()->getZBalance();
+                s.hasBalances   = true;
+            });
 
             updateUI(anyTUnconfirmed || anyZUnconfirmed);
 
@@ -864,32 +942,190 @@ void RPC::refreshTransactions() {
         return noConnection();
 
     getTransactions([=] (json reply) {
+        TRACE_SPAN("RPC::refreshTransactions update");
         QList<TransactionItem> txdata;
 
         for (auto& it : reply.get<json::array_t>()) {  
-            double fee = 0;
-            if (!it["fee"].is_null()) {
-                fee = it["fee"].get<json::number_float_t>();
-            }
+            TransactionItem tx = parseTransparentTx(it);
 
-            QString address = (it["address"].is_null() ? "" : QString::fromStdString(it["address"]));
+            txdata.push_back(tx);
+            if (!tx.address.isEmpty())
+                usedAddresses->insert(tx.address, true);
+        }
 
-            TransactionItem tx{
-                QString::fromStdString(it["category"]),
-                (qint64)it["time"].get<json::number_unsigned_t>(),
-                address,
-                QString::fromStdString(it["txid"]),
-                it["amount"].get<json::number_float_t>() + fee,
-                (unsigned long)it["confirmations"].get<json::number_unsigned_t>(),
-                "", "" };
+        // Publish them, which updates the table view with whatever changed
+        WalletSnapshots::getInstance()->update([&] (WalletSnapshot& s) {
+            s.tTxs    = txdata;
+            s.hasTTxs = true;
+        });
+        transactionsTableModel->setStale(false);
+        scheduleStateSave();
+    });
+}
 
-            txdata.push_back(tx);
-            if (!address.isEmpty())
-                usedAddresses->insert(address, true);
+// Fill the tables from the state saved by the last run. It's shown greyed out, and replaced piece by 
+// piece as the live data comes in.
+void RPC::showSavedState() {
+    WalletState state;
+    if (!WalletStateFile::load(state))
+        return;
+
+    showingSavedState = true;
+    savedStateTestnet = state.testnet;
+
+    // Only shown, not published, since nothing should act on these balances
+    auto saved = std::make_shared<WalletSnapshot>();
+    saved->blockNumber  = state.blockNumber;
+    saved->balT         = state.balT;
+    saved->balZ         = state.balZ;
+    saved->balances     = state.balances;
+    saved->utxos        = state.utxos;
+    balancesTableModel->setNewData(saved);
+    balancesTableModel->setStale(true);
+
+    transactionsTableModel->addTData(state.tTxs);
+    transactionsTableModel->addZSentData(state.zSentTxs);
+    transactionsTableModel->addZRecvData(state.zRecvTxs);
+    transactionsTableModel->setStale(true);
+
+    ui->balSheilded   ->setText(Settings::getZECDisplayFormat(state.balZ));
+    ui->balTransparent->setText(Settings::getZECDisplayFormat(state.balT));
+    ui->balTotal      ->setText(Settings::getZECDisplayFormat(state.balT + state.balZ));
+    ui->blockheight   ->setText(QString::number(state.blockNumber));
+
+    ui->statusBar->showMessage(QObject::tr("Showing the wallet as of block %1, waiting for the node...")
+                                .arg(state.blockNumber));
+}
+
+// Take the saved state off the screen before the live data comes in, because it belongs to another network
+void RPC::clearSavedState() {
+    showingSavedState = false;
+
+    balancesTableModel->setNewData(std::make_shared<WalletSnapshot>());
+    transactionsTableModel->addTData(QList<TransactionItem>());
+    transactionsTableModel->addZSentData(QList<TransactionItem>());
+    transactionsTableModel->addZRecvData(QList<TransactionItem>());
+
+    ui->balSheilded   ->setText(Settings::getZECDisplayFormat(Amount()));
+    ui->balTransparent->setText(Settings::getZECDisplayFormat(Amount()));
+    ui->balTotal      ->setText(Settings::getZECDisplayFormat(Amount()));
+    ui->statusBar->clearMessage();
+}
+
+// The shielded txs were cleared or aren't to be kept anymore, so they can't stay in the saved state either.
+// The next refresh saves it again, without them.
+void RPC::discardSavedState() {
+    stateTimer->stop();
+    WalletStateFile::remove();
+}
+
+void RPC::scheduleStateSave() {
+    if (!stateTimer->isActive())
+        stateTimer->start();
+}
+
+void RPC::saveState() {
+    // Nothing live to save yet
+    auto snapshot = getSnapshot();
+    if (showingSavedState || !snapshot->hasBalances)
+        return;
+
+    WalletState state;
+    state.blockNumber   = Settings::getInstance()->getBlockNumber();
+    state.testnet       = Settings::getInstance()->isTestnet();
+    state.savedAt       = QDateTime::currentMSecsSinceEpoch() / 1000;
+    state.balT          = snapshot->balT;
+    state.balZ          = snapshot->balZ;
+    state.balances      = snapshot->balances;
+    state.utxos         = snapshot->utxos;
+    state.zaddresses    = snapshot->zaddresses;
+    state.taddresses    = snapshot->taddresses;
+
+    state.tTxs          = snapshot->tTxs;
+
+    // The shielded txs and their memos are only written to disk if the user wants them kept
+    if (Settings::getInstance()->getSaveZtxs()) {
+        state.zSentTxs  = snapshot->zSentTxs;
+        state.zRecvTxs  = snapshot->zRecvTxs;
+    }
+
+    WalletStateFile::save(state);
+}
+
+// Convert one entry of the listtransactions reply into a TransactionItem
+TransactionItem RPC::parseTransparentTx(const json& it) {
+    Amount fee;
+    if (!it["fee"].is_null()) {
+        fee = Amount::fromJson(it["fee"]);
+    }
+
+    QString address = (it["address"].is_null() ? "" : QString::fromStdString(it["address"]));
+
+    return TransactionItem{
+        QString::fromStdString(it["category"]),
+        (qint64)it["time"].get<json::number_unsigned_t>(),
+        address,
+        QString::fromStdString(it["txid"]),
+        Amount::fromJson(it["amount"]) + fee,
+        (unsigned long)it["confirmations"].get<json::number_unsigned_t>(),
+        "", "", outputIndex(it) };
+}
+
+// The index of the output an RPC reply entry is about. The transparent calls call it vout, the sapling ones
+// outindex, and a sprout output is numbered by its joinsplit, which has two outputs each.
+int RPC::outputIndex(const json& it) {
+    for (auto name : { "vout", "outindex" }) {
+        auto f = it.find(name);
+        if (f != it.end() && f->is_number_integer())
+            return f->get<int>();
+    }
+
+    auto js  = it.find("jsindex");
+    auto out = it.find("jsoutindex");
+    if (js != it.end() && out != it.end() && js->is_number_integer() && out->is_number_integer())
+        return js->get<int>() * 2 + out->get<int>();
+
+    return -1;
+}
+
+/**
+ * Page through the complete transparent transaction history, not just the latest entries that 
+ * refreshTransactions() loads. The callback is called once per page, with last = true on the final one.
+ */
+void RPC::fetchTransparentHistory(int pageSize, const std::function<void(QList<TransactionItem>, bool)>& cb,
+    const std::function<void(QString)>& err) {
+    fetchTransparentHistoryPage(pageSize, 0, cb, err);
+}
+
+void RPC::fetchTransparentHistoryPage(int pageSize, int skip, 
+    const std::function<void(QList<TransactionItem>, bool)>& cb, const std::function<void(QString)>& err) {
+    if (conn == nullptr)
+        return err(QObject::tr("No Connection"));
+
+    json payload = {
+        {"jsonrpc", "1.0"},
+        {"id", "someid"},
+        {"method", "listtransactions"},
+        {"params", {"*", pageSize, skip}}
+    };
+
+    conn->doRPC(payload, [=] (const json& reply) {
+        QList<TransactionItem> page;
+        for (auto& it : reply.get<json::array_t>()) {
+            page.push_back(parseTransparentTx(it));
         }
 
-        // Update model data, which updates the table view
-        transactionsTableModel->addTData(txdata);        
+        bool last = (int)reply.size() < pageSize;
+        cb(page, last);
+
+        if (!last)
+            fetchTransparentHistoryPage(pageSize, skip + pageSize, cb, err);
+    }, [=] (QNetworkReply* reply, const json& parsed) {
+        if (!parsed.is_discarded() && !parsed["error"]["message"].is_null()) {
+            err(QString::fromStdString(parsed["error"]["message"]));
+        } else {
+            err(reply->errorString());
+        }
     });
 }
 
@@ -898,22 +1134,32 @@ void RPC::refreshSentZTrans() {
     if  (conn == nullptr) 
         return noConnection();
 
-    auto sentZTxs = SentTxStore::readSentTxFile();
-
-    // If there are no sent z txs, then empty the table. 
-    // This happens when you clear history.
-    if (sentZTxs.isEmpty()) {
-        transactionsTableModel->addZSentData(sentZTxs);
-        return;
-    }
+    auto store    = SentTxStore::getInstance();
+    auto sentZTxs = store->getAll();
+    auto curBlock = Settings::getInstance()->getBlockNumber();
 
+    // Txs that are already final have their block recorded, so only the recent ones need to be looked up
     QList<QString> txids;
+    for (TransactionItem& sentTx: sentZTxs) {
+        auto height = store->getConfirmedHeight(sentTx.txid);
+        if (height > 0) {
+            sentTx.confirmations = curBlock >= height ? curBlock - height + 1 : 0;
+        } else {
+            txids.push_back(sentTx.txid);
+        }
+    }
 
-    for (auto sentTx: sentZTxs) {
-        txids.push_back(sentTx.txid);
+    // If there is nothing to look up (including when there are no sent z txs at all, 
+    // which happens when you clear history), then just show what we have. 
+    if (txids.isEmpty()) {
+        WalletSnapshots::getInstance()->update([&] (WalletSnapshot& s) {
+            s.zSentTxs    = sentZTxs;
+            s.hasZSentTxs = true;
+        });
+        return;
     }
 
-    // Look up all the txids to get the confirmation count for them. 
+    // Look up the remaining txids to get the confirmation count for them. 
     conn->doBatchRPC<QString>(txids,
         [=] (QString txid) {
             json payload = {
@@ -928,19 +1174,28 @@ void RPC::refreshSentZTrans() {
         [=] (QMap<QString, json>* txidList) {
             auto newSentZTxs = sentZTxs;
             // Update the original sent list with the confirmation count
-            // TODO: This whole thing is kinda inefficient. We should probably just update the file
-            // with the confirmed block number, so we don't have to keep calling gettransaction for the
-            // sent items.
             for (TransactionItem& sentTx: newSentZTxs) {
+                if (!txidList->contains(sentTx.txid))
+                    continue;
                 auto j = txidList->value(sentTx.txid);
-                if (j.is_null())
+                if (j.is_null() || j["confirmations"].is_null())
+                    continue;
+
+                auto confirmations = j["confirmations"].get<json::number_integer_t>();
+                if (confirmations <= 0)
                     continue;
-                auto error = j["confirmations"].is_null();
-                if (!error)
-                    sentTx.confirmations = j["confirmations"].get<json::number_unsigned_t>();
+
+                sentTx.confirmations = confirmations;
+
+                // Deep enough to not be reorged out, so remember the block and don't ask again
+                if (confirmations >= SentTxStore::finalConfirmations)
+                    SentTxStore::getInstance()->setConfirmedHeight(sentTx.txid, curBlock - confirmations + 1);
             }
             
-            transactionsTableModel->addZSentData(newSentZTxs);
+            WalletSnapshots::getInstance()->update([&] (WalletSnapshot& s) {
+                s.zSentTxs    = newSentZTxs;
+                s.hasZSentTxs = true;
+            });
             delete txidList;
         }
      );
@@ -957,7 +1212,10 @@ void RPC::addNewTxToWatch(const QString& newOpid, WatchedTx wtx) {
 void RPC::executeTransaction(Tx tx, 
         const std::function<void(QString opid)> submitted,
         const std::function<void(QString opid, QString txid)> computed,
-        const std::function<void(QString opid, QString errStr)> error) {
+        const std::function<void(QString opid, QString errStr)> error,
+        const std::function<void(QString errStr)> lost) {
+    TRACE_SPAN("RPC::executeTransaction");
+
     // First, create the json params
     json params = json::array();
     fillTxJsonParams(params, tx);
@@ -970,8 +1228,11 @@ void RPC::executeTransaction(Tx tx,
         addNewTxToWatch( opid, WatchedTx { opid, tx, computed, error} );
         submitted(opid);
     },
-    [=](QString errStr) {
-        error("", errStr);
+    [=](QString errStr, bool rejected) {
+        if (rejected || !lost)
+            error("", errStr);
+        else
+            lost(errStr);
     });
 }
 
@@ -988,6 +1249,7 @@ void RPC::watchTxStatus() {
     };
 
     conn->doRPCIgnoreError(payload, [=] (const json& reply) {
+        TRACE_SPAN("RPC::watchTxStatus reply");
         // There's an array for each item in the status
         for (auto& it : reply.get<json::array_t>()) {  
             // If we were watching this Tx and its status became "success", then we'll show a status bar alert
@@ -1000,7 +1262,7 @@ void RPC::watchTxStatus() {
                 if (status == "success") {
                     auto txid = QString::fromStdString(it["result"]["txid"]);
                     
-                    SentTxStore::addToSentTx(watchingOps[id].tx, txid);
+                    SentTxStore::getInstance()->addToSentTx(watchingOps[id].tx, txid);
 
                     auto wtx = watchingOps[id];
                     watchingOps.remove(id);
@@ -1035,6 +1297,25 @@ void RPC::watchTxStatus() {
     });
 }
 
+// The status of just these operations. Operations komodod doesn't know about (anymore) are left out.
+void RPC::getOperationStatus(const QStringList& opids, const std::function<void(json)>& cb) {
+    if  (conn == nullptr) 
+        return noConnection();
+
+    json ids = json::array();
+    for (const auto& opid : opids)
+        ids.push_back(opid.toStdString());
+
+    json payload = {
+        {"jsonrpc", "1.0"},
+        {"id", "someid"},
+        {"method", "z_getoperationstatus"},
+        {"params", json::array({ids})}
+    };
+
+    conn->doRPCWithDefaultErrorHandling(payload, cb);
+}
+
 void RPC::checkForUpdate(bool silent) {
     qDebug() << "checking for updates";
 
@@ -1173,6 +1454,8 @@ void RPC::refreshZECPrice() {
 }
 
 void RPC::shutdownZcashd() {
+    TRACE_SPAN("RPC::shutdownZcashd");
+
     // Shutdown embedded zcashd if it was started
     if (ezcashd == nullptr || ezcashd->processId() == 0 || conn == nullptr) {
         // No zcashd running internally, just return
@@ -1288,7 +1571,7 @@ void RPC::getZboardTopics(std::function<void(QMap<QString, QString>)> cb) {
  * Get a Sapling address from the user's wallet
  */ 
 QString RPC::getDefaultSaplingAddress() {
-    for (QString addr: *zaddresses) {
+    for (QString addr: getSnapshot()->zaddresses) {
         if (Settings::getInstance()->isSaplingAddress(addr))
             return addr;
     }
@@ -1297,8 +1580,30 @@ QString RPC::getDefaultSaplingAddress() {
 }
 
 QString RPC::getDefaultTAddress() {
-    if (getAllTAddresses()->length() > 0)
-        return getAllTAddresses()->at(0);
+    auto snapshot = getSnapshot();
+    if (snapshot->taddresses.length() > 0)
+        return snapshot->taddresses.at(0);
     else 
         return QString();
 }
+
+// The publisher keeps the current snapshot alive, so these stay valid until the next update
+const QList<QString>* RPC::getAllZAddresses() {
+    auto snapshot = getSnapshot();
+    return snapshot->hasZAddresses ? &snapshot->zaddresses : nullptr;
+}
+
+const QList<QString>* RPC::getAllTAddresses() {
+    auto snapshot = getSnapshot();
+    return snapshot->hasTAddresses ? &snapshot->taddresses : nullptr;
+}
+
+const QList<UnspentOutput>* RPC::getUTXOs() {
+    auto snapshot = getSnapshot();
+    return snapshot->hasBalances ? &snapshot->utxos : nullptr;
+}
+
+const AddressMap<Amount>* RPC::getAllBalances() {
+    auto snapshot = getSnapshot();
+    return snapshot->hasBalances ? &snapshot->balances : nullptr;
+}
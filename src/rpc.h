@@ -4,25 +4,18 @@
 #include "precompiled.h"
 
 #include "balancestablemodel.h"
+#include "walletsnapshot.h"
 #include "txtablemodel.h"
 #include "ui_mainwindow.h"
 #include "mainwindow.h"
 #include "connection.h"
+#include "addressregistry.h"
+#include "amount.h"
 
 using json = nlohmann::json;
 
 class Turnstile;
-
-struct TransactionItem {
-    QString         type;
-    qint64            datetime;
-    QString         address;
-    QString         txid;
-    double          amount;
-    unsigned long   confirmations;
-    QString         fromAddr;
-    QString         memo;
-};
+class AddressPool;
 
 struct WatchedTx {
     QString opid;
@@ -44,29 +37,46 @@ public:
     void refresh(bool force = false);
 
     void refreshAddresses();    
+
+    // Delete the wallet state saved for the next start, after the shielded history is cleared or turned off
+    void discardSavedState();
+
+    void fetchTransparentHistory(int pageSize, const std::function<void(QList<TransactionItem>, bool)>& cb,
+                                 const std::function<void(QString)>& err);
     
     void checkForUpdate(bool silent = true);
     void refreshZECPrice();
     void getZboardTopics(std::function<void(QMap<QString, QString>)> cb);
 
+    // If the z_sendmany request fails without komodod refusing it, the tx may have gone out. That goes to
+    // lost if it's given, and to error otherwise.
     void executeTransaction(Tx tx, 
         const std::function<void(QString opid)> submitted,
         const std::function<void(QString opid, QString txid)> computed,
-        const std::function<void(QString opid, QString errStr)> error);
+        const std::function<void(QString opid, QString errStr)> error,
+        const std::function<void(QString errStr)> lost = nullptr);
 
     void fillTxJsonParams(json& params, Tx tx);
-    void sendZTransaction(json params, const std::function<void(json)>& cb, const std::function<void(QString)>& err);
+
+    // err is told whether komodod refused the tx. If not, the request or its reply was lost on the way,
+    // and the tx may have gone out anyway.
+    void sendZTransaction(json params, const std::function<void(json)>& cb, const std::function<void(QString, bool)>& err);
     void watchTxStatus();
+    void getOperationStatus(const QStringList& opids, const std::function<void(json)>& cb);
 
     const QMap<QString, WatchedTx> getWatchingTxns() { return watchingOps; }
     void addNewTxToWatch(const QString& newOpid, WatchedTx wtx); 
 
     const TxTableModel*               getTransactionsModel() { return transactionsTableModel; }
-    const QList<QString>*             getAllZAddresses()     { return zaddresses; }
-    const QList<QString>*             getAllTAddresses()     { return taddresses; }
-    const QList<UnspentOutput>*       getUTXOs()             { return utxos; }
-    const QMap<QString, double>*      getAllBalances()       { return allBalances; }
-    const QMap<QString, bool>*        getUsedAddresses()     { return usedAddresses; }
+    WalletSnapshotPtr                 getSnapshot()          { return WalletSnapshots::getInstance()->current(); }
+
+    // These point into the current snapshot, and are only valid until the next refresh. Code that
+    // holds on to the data, or runs off the UI thread, should take a snapshot instead.
+    const QList<QString>*             getAllZAddresses();
+    const QList<QString>*             getAllTAddresses();
+    const QList<UnspentOutput>*       getUTXOs();
+    const AddressMap<Amount>*         getAllBalances();
+    const AddressMap<bool>*           getUsedAddresses()     { return usedAddresses; }
 
     void newZaddr(bool sapling, const std::function<void(json)>& cb);
     void newTaddr(const std::function<void(json)>& cb);
@@ -87,6 +97,7 @@ public:
     void getAllPrivKeys(const std::function<void(QList<QPair<QString, QString>>)>);
 
     Turnstile*  getTurnstile()  { return turnstile; }
+    AddressPool* getAddressPool() { return addressPool; }
     Connection* getConnection() { return conn; }
 
 private:
@@ -96,11 +107,22 @@ private:
     void refreshSentZTrans();
     void refreshReceivedZTrans(QList<QString> zaddresses);
 
-    bool processUnspent     (const json& reply, QMap<QString, double>* newBalances, QList<UnspentOutput>* newUtxos);
+    void fetchTransparentHistoryPage(int pageSize, int skip, const std::function<void(QList<TransactionItem>, bool)>& cb,
+                                     const std::function<void(QString)>& err);
+
+    static TransactionItem parseTransparentTx(const json& it);
+    static int             outputIndex(const json& it);
+
+    bool processUnspent     (const json& reply, AddressMap<Amount>* newBalances, QList<UnspentOutput>* newUtxos);
     void updateUI           (bool anyUnconfirmed);
 
     void getInfoThenRefresh(bool force);
 
+    void showSavedState();
+    void clearSavedState();
+    void scheduleStateSave();
+    void saveState();
+
     void getBalance(const std::function<void(json)>& cb);
 
     void getTransparentUnspent  (const std::function<void(json)>& cb);
@@ -112,11 +134,7 @@ private:
     Connection*                 conn                        = nullptr;
     std::shared_ptr<QProcess>   ezcashd                     = nullptr;
 
-    QList<UnspentOutput>*       utxos                       = nullptr;
-    QMap<QString, double>*      allBalances                 = nullptr;
-    QMap<QString, bool>*        usedAddresses               = nullptr;
-    QList<QString>*             zaddresses                  = nullptr;
-    QList<QString>*             taddresses                  = nullptr;
+    AddressMap<bool>*           usedAddresses               = nullptr;
     
     QMap<QString, WatchedTx>    watchingOps;
 
@@ -126,10 +144,19 @@ private:
     QTimer*                     timer;
     QTimer*                     txTimer;
     QTimer*                     priceTimer;
+    QTimer*                     stateTimer;
+
+    // The tables are showing the state saved by the last run, until the first refresh is done
+    bool                        showingSavedState           = false;
+    bool                        savedStateTestnet           = false;
+
+    // A t-address is being handed out because the wallet has none
+    bool                        creatingTAddr               = false;
 
     Ui::MainWindow*             ui;
     MainWindow*                 main;
     Turnstile*                  turnstile;
+    AddressPool*                addressPool;
 
     // Current balance in the UI. If this number updates, then refresh the UI
     QString                     currentBalance;
@@ -1,6 +1,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "addressbook.h"
+#include "addresslistmodel.h"
 #include "ui_confirm.h"
 #include "ui_memodialog.h"
 #include "ui_newrecurring.h"
@@ -23,6 +24,9 @@ void MainWindow::setupSendTab() {
     // Cancel Button
     QObject::connect(ui->cancelSendButton, &QPushButton::clicked, this, &MainWindow::cancelButton);
 
+    // The from addresses come from the shared model, which keeps itself up to date
+    ui->inputsCombo->setModel(AddressListModel::get(AddressListModel::Balances));
+
     // Input Combobox current text changed
     QObject::connect(ui->inputsCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
         this, &MainWindow::inputComboTextChanged);
@@ -44,10 +48,14 @@ void MainWindow::setupSendTab() {
     });
     setMemoEnabled(1, false);
 
+    // One completer is shared by all the address fields, and follows the address book's changes
+    labelCompleter = new LabelCompleter(this);
+    ui->Address1->setCompleter(labelCompleter);
+
     // This is the damnest thing ever. If we do AddressBook::readFromStorage() directly, the whole file
     // doesn't get read. It needs to run in a timer after everything has finished to be able to read
     // the file properly. 
-    QTimer::singleShot(2000, [=]() { updateLabelsAutoComplete(); });
+    QTimer::singleShot(2000, [=]() { labelCompleter->reload(); });
 
     // The first address book button
     QObject::connect(ui->AddressBook1, &QPushButton::clicked, [=] () {
@@ -63,7 +71,7 @@ void MainWindow::setupSendTab() {
     // Disable custom fees if settings say no
     ui->minerFeeAmt->setReadOnly(!Settings::getInstance()->getAllowCustomFees());
     QObject::connect(ui->minerFeeAmt, &QLineEdit::textChanged, [=](auto txt) {
-        ui->lblMinerFeeUSD->setText(Settings::getUSDFormat(txt.toDouble()));
+        ui->lblMinerFeeUSD->setText(Settings::getUSDFormat(Amount::fromString(txt)));
     });
     ui->minerFeeAmt->setText(Settings::getDecimalString(Settings::getMinerFee()));    
 
@@ -71,7 +79,7 @@ void MainWindow::setupSendTab() {
     QObject::connect(ui->tabWidget, &QTabWidget::currentChanged, [=] (int pos) {
         if (pos == 1) {
             QString txt = ui->minerFeeAmt->text();
-            ui->lblMinerFeeUSD->setText(Settings::getUSDFormat(txt.toDouble()));
+            ui->lblMinerFeeUSD->setText(Settings::getUSDFormat(Amount::fromString(txt)));
         }
     });
     
@@ -113,28 +121,9 @@ void MainWindow::editSchedule() {
 
 }
 
-void MainWindow::updateLabelsAutoComplete() {
-    QList<QString> list;
-    auto labels = AddressBook::getInstance()->getAllAddressLabels();
-    
-    std::transform(labels.begin(), labels.end(), std::back_inserter(list), [=] (auto la) -> QString {
-        return la.first % "/" % la.second;
-    });
-    
-    delete labelCompleter;
-    labelCompleter = new QCompleter(list, this);
-    labelCompleter->setCaseSensitivity(Qt::CaseInsensitive);
-
-    // Then, find all the address fields and update the completer.
-    QRegExp re("Address[0-9]+", Qt::CaseInsensitive);
-    for (auto target: ui->sendToWidgets->findChildren<QLineEdit *>(re)) {
-        target->setCompleter(labelCompleter);
-    }
-}
-
 void MainWindow::setDefaultPayFrom() {
     auto findMax = [=] (QString startsWith) {
-        double max_amt = 0;
+        Amount max_amt;
         int    idx     = -1;
 
         for (int i=0; i < ui->inputsCombo->count(); i++) {
@@ -166,30 +155,19 @@ void MainWindow::updateFromCombo() {
     if (!rpc || !rpc->getAllBalances())
         return;
 
-    auto lastFromAddr = ui->inputsCombo->currentText();
-
-    ui->inputsCombo->clear();
-    auto i = rpc->getAllBalances()->constBegin();
-
-    // Add all the addresses into the inputs combo box
-    while (i != rpc->getAllBalances()->constEnd()) {
-        ui->inputsCombo->addItem(i.key(), i.value());
-        if (i.key() == lastFromAddr) ui->inputsCombo->setCurrentText(i.key());
-
-        ++i;
-    }
-
-    if (lastFromAddr.isEmpty()) {
+    // The combo's rows follow the balances by themselves, and keep the selected address across
+    // updates. All that's left is to pick the default the first time there is anything to pick.
+    if (!payFromDefaulted && ui->inputsCombo->count() > 0) {
         setDefaultPayFrom();
+        payFromDefaulted = true;
     }
-    else {
-        ui->inputsCombo->setCurrentText(lastFromAddr);
-    }
+
+    // The selected row's balance may have changed
+    inputComboTextChanged(ui->inputsCombo->currentIndex());
 }
 
 void MainWindow::inputComboTextChanged(int index) {
-    auto addr   = ui->inputsCombo->itemText(index);
-    auto bal    = rpc->getAllBalances()->value(addr);
+    auto bal    = AddressListModel::get(AddressListModel::Balances)->balance(index);
     auto balFmt = Settings::getZECDisplayFormat(bal);
 
     ui->sendAddressBalance->setText(balFmt);
@@ -307,7 +285,7 @@ void MainWindow::addressChanged(int itemNumber, const QString& text) {
 
 void MainWindow::amountChanged(int item, const QString& text) {
     auto usd = ui->sendToWidgets->findChild<QLabel*>(QString("AmtUSD") % QString::number(item));
-    usd->setText(Settings::getUSDFormat(text.toDouble()));
+    usd->setText(Settings::getUSDFormat(Amount::fromString(text)));
 }
 
 void MainWindow::setMemoEnabled(int number, bool enabled) {
@@ -444,18 +422,18 @@ void MainWindow::maxAmountChecked(int checked) {
         if (rpc->getAllBalances() == nullptr) return;
            
         // Calculate maximum amount
-        double sumAllAmounts = 0.0;
+        Amount sumAllAmounts;
         // Calculate all other amounts
         int totalItems = ui->sendToWidgets->children().size() - 2;   // The last one is a spacer, so ignore that        
         // Start counting the sum skipping the first one, because the MAX button is on the first one, and we don't
         // want to include it in the sum. 
         for (int i=1; i < totalItems; i++) {
             auto amt  = ui->sendToWidgets->findChild<QLineEdit*>(QString("Amount")  % QString::number(i+1));
-            sumAllAmounts += amt->text().toDouble();
+            sumAllAmounts += Amount::fromString(amt->text());
         }
 
         if (Settings::getInstance()->getAllowCustomFees()) {
-            sumAllAmounts = ui->minerFeeAmt->text().toDouble();
+            sumAllAmounts = Amount::fromString(ui->minerFeeAmt->text());
         }
         else {
             sumAllAmounts += Settings::getMinerFee();
@@ -464,7 +442,7 @@ void MainWindow::maxAmountChecked(int checked) {
         auto addr = ui->inputsCombo->currentText();
 
         auto maxamount  = rpc->getAllBalances()->value(addr) - sumAllAmounts;
-        maxamount       = (maxamount < 0) ? 0 : maxamount;
+        maxamount       = maxamount.isNegative() ? Amount() : maxamount;
             
         ui->Amount1->setText(Settings::getDecimalString(maxamount));
     } else if (checked == Qt::Unchecked) {
@@ -474,7 +452,7 @@ void MainWindow::maxAmountChecked(int checked) {
 }
 
 // Create a Tx from the current state of the send page. 
-Tx MainWindow::createTxFromSendPage() {
+Tx MainWindow::createTxFromSendPage(QString* error) {
     Tx tx;
 
     bool sendChangeToSapling = Settings::getInstance()->getAutoShield();
@@ -485,7 +463,7 @@ Tx MainWindow::createTxFromSendPage() {
 
     // For each addr/amt in the sendTo tab
     int totalItems = ui->sendToWidgets->children().size() - 2;   // The last one is a spacer, so ignore that        
-    double totalAmt = 0;
+    Amount totalAmt;
     for (int i=0; i < totalItems; i++) {
         QString addr = ui->sendToWidgets->findChild<QLineEdit*>(QString("Address") % QString::number(i+1))->text().trimmed();
         // Remove label if it exists
@@ -494,7 +472,12 @@ Tx MainWindow::createTxFromSendPage() {
         // If address is sprout, then we can't send change to sapling, because of turnstile.
         //sendChangeToSapling = sendChangeToSapling && !Settings::getInstance()->isSproutAddress(addr);
 
-        double  amt  = ui->sendToWidgets->findChild<QLineEdit*>(QString("Amount")  % QString::number(i+1))->text().trimmed().toDouble();        
+        // An empty amount is a memo-only send, anything else has to be a plain number
+        QString amtText = ui->sendToWidgets->findChild<QLineEdit*>(QString("Amount")  % QString::number(i+1))->text().trimmed();
+        bool    ok      = true;
+        Amount  amt     = amtText.isEmpty() ? Amount() : Amount::fromString(amtText, &ok);
+        if (!ok && error != nullptr && error->isEmpty())
+            *error = tr("Amount '%1' for recipient %2 is invalid!").arg(amtText).arg(i + 1);
         totalAmt += amt;
         QString memo = ui->sendToWidgets->findChild<QLabel*>(QString("MemoTxt")  % QString::number(i+1))->text().trimmed();
         
@@ -502,7 +485,10 @@ Tx MainWindow::createTxFromSendPage() {
     }
 
     if (Settings::getInstance()->getAllowCustomFees()) {
-        tx.fee = ui->minerFeeAmt->text().toDouble();
+        bool ok = true;
+        tx.fee = Amount::fromString(ui->minerFeeAmt->text(), &ok);
+        if (!ok && error != nullptr && error->isEmpty())
+            *error = tr("Miner fee '%1' is invalid!").arg(ui->minerFeeAmt->text());
     }
     else {
         tx.fee = Settings::getMinerFee();
@@ -525,9 +511,9 @@ Tx MainWindow::createTxFromSendPage() {
         });
 
         if (saplingAddr != rpc->getAllZAddresses()->end()) {
-            double change = rpc->getAllBalances()->value(tx.fromAddr) - totalAmt - tx.fee;
+            Amount change = rpc->getAllBalances()->value(tx.fromAddr) - totalAmt - tx.fee;
 
-            if (Settings::getDecimalString(change) != "0") {
+            if (!change.isZero()) {
                 QString changeMemo = tr("Change from ") + tx.fromAddr;
                 tx.toAddrs.push_back(ToFields{ *saplingAddr, change, changeMemo, changeMemo.toUtf8().toHex() });
             }
@@ -575,7 +561,7 @@ bool MainWindow::confirmTx(Tx tx) {
     
     // For each addr/amt/memo, construct the JSON and also build the confirm dialog box    
     int row = 0;
-    double totalSpending = 0;
+    Amount totalSpending;
 
     for (int i=0; i < tx.toAddrs.size(); i++) {
         auto toAddr = tx.toAddrs[i];
@@ -687,9 +673,11 @@ bool MainWindow::confirmTx(Tx tx) {
 
 // Send button clicked
 void MainWindow::sendButton() {
-    Tx tx = createTxFromSendPage();
+    QString error;
+    Tx tx = createTxFromSendPage(&error);
 
-    QString error = doSendTxValidations(tx);
+    if (error.isEmpty())
+        error = doSendTxValidations(tx);
     if (!error.isEmpty()) {
         // Something went wrong, so show an error and exit
         QMessageBox msg(QMessageBox::Critical, tr("Transaction Error"), error,
@@ -735,8 +723,8 @@ QString MainWindow::doSendTxValidations(Tx tx) {
 
         // This technically shouldn't be possible, but issue #62 seems to have discovered a bug
         // somewhere, so just add a check to make sure. 
-        if (toAddr.amount < 0) {
-            return QString(tr("Amount '%1' is invalid!").arg(toAddr.amount));
+        if (toAddr.amount.isNegative()) {
+            return QString(tr("Amount '%1' is invalid!").arg(toAddr.amount.toDecimalString()));
         }
     }
 
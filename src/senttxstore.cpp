@@ -1,55 +1,139 @@
 #include "senttxstore.h"
 #include "settings.h"
 
-/// Get the location of the app data file to be written. 
-QString SentTxStore::writeableFile() {
-    auto filename = QStringLiteral("senttxstore.dat");
+SentTxStore* SentTxStore::instance = nullptr;
 
-    auto dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
-    if (!dir.exists())
-        QDir().mkpath(dir.absolutePath());
+SentTxStore* SentTxStore::getInstance() {
+    if (instance == nullptr)
+        instance = new SentTxStore();
 
-    if (Settings::getInstance()->isTestnet()) {
-        return dir.filePath("testnet-" % filename);
-    } else {
-        return dir.filePath(filename);
-    }
+    return instance;
 }
 
-// delete the sent history. 
-void SentTxStore::deleteHistory() {
-    QFile data(writeableFile());
-    data.remove();
-    data.close();
+// Make sure the txs for the current network are loaded. Mainnet and testnet have separate tables,
+// and which one we're on is only known once we're connected.
+void SentTxStore::load() {
+    auto t = WalletStore::getInstance()->table(QStringLiteral("senttx"));
+    if (t == table)
+        return;
+
+    table = t;
+    items.clear();
+    heights.clear();
+
+    // Each tx is stored under its txid
+    for (auto it = table->all().constBegin(); it != table->all().constEnd(); it++) {
+        QDataStream in(it.value());
+        TransactionItem item{"send", 0, "", QString::fromUtf8(it.key()), Amount(), 0, "", ""};
+        qint64 zats;
+        qint32 height;
+        in >> item.datetime >> item.fromAddr >> item.address >> zats >> item.memo >> height;
+        item.amount = Amount::fromZats(zats);
+
+        items.push_back(item);
+        if (height > 0)
+            heights[item.txid] = height;
+    }
+
+    importOldFile();
+
+    std::sort(items.begin(), items.end(), [] (const auto& a, const auto& b) {
+        return a.datetime < b.datetime;
+    });
 }
 
-QList<TransactionItem> SentTxStore::readSentTxFile() {
-    QFile data(writeableFile());
-    if (!data.exists()) {
-        return QList<TransactionItem>();
+// Move the txs saved by earlier versions, which rewrote the whole list as JSON every time, into the table.
+// The old file is the only copy of this history, so it's kept for the next start if anything goes wrong.
+void SentTxStore::importOldFile() {
+    QFile data(WalletStore::writeableFile(QStringLiteral("senttxstore.dat")));
+    if (!data.exists())
+        return;
+
+    if (!data.open(QFile::ReadOnly)) {
+        LOG_WARNING("Couldn't open the old sent txs", {{"file", data.fileName()}, {"error", data.errorString()}});
+        return;
     }
-    
-    QJsonDocument jsonDoc;
-    
-    data.open(QFile::ReadOnly);    
-    jsonDoc = QJsonDocument::fromJson(data.readAll());
+
+    QJsonParseError parseError;
+    auto jsonDoc = QJsonDocument::fromJson(data.readAll(), &parseError);
+    bool readOk  = data.error() == QFileDevice::NoError;
     data.close();
 
-    QList<TransactionItem> items;
+    if (!readOk || parseError.error != QJsonParseError::NoError || !jsonDoc.isArray()) {
+        LOG_WARNING("Couldn't read the old sent txs", {{"file", data.fileName()}, {"error", parseError.errorString()}});
+        return;
+    }
 
+    table->beginBatch();
     for (auto i : jsonDoc.array()) {
         auto sentTx = i.toObject();
         TransactionItem t{"send", (qint64)sentTx["datetime"].toVariant().toLongLong(), 
                           sentTx["address"].toString(), 
                           sentTx["txid"].toString(), 
-                          sentTx["amount"].toDouble() + sentTx["fee"].toDouble(), 
+                          Amount::fromDouble(sentTx["amount"].toDouble()) + Amount::fromDouble(sentTx["fee"].toDouble()), 
                           0, sentTx["from"].toString(), ""};
+
+        // Already brought over by an earlier start that couldn't finish the import
+        if (table->contains(t.txid.toUtf8()))
+            continue;
+
         items.push_back(t);
+        save(t);
     }
+    bool ok = table->commit();
+
+    // Only drop the old file once everything is safely on disk
+    if (ok && table->sync()) {
+        data.remove();
+    } else {
+        LOG_WARNING("Couldn't save the old sent txs, will try again", {{"file", data.fileName()}});
+    }
+}
 
+void SentTxStore::save(const TransactionItem& item) {
+    QByteArray value;
+    QDataStream out(&value, QIODevice::WriteOnly);
+    out << item.datetime << item.fromAddr << item.address << item.amount.toZats() << item.memo
+        << (qint32)heights.value(item.txid, 0);
+
+    table->put(item.txid.toUtf8(), value);
+}
+
+const QList<TransactionItem>& SentTxStore::getAll() {
+    load();
     return items;
 }
 
+// delete the sent history. 
+void SentTxStore::deleteHistory() {
+    load();
+
+    items.clear();
+    heights.clear();
+    table->clear();
+
+    emit changed();
+}
+
+int SentTxStore::getConfirmedHeight(const QString& txid) {
+    load();
+    return heights.value(txid, 0);
+}
+
+void SentTxStore::setConfirmedHeight(const QString& txid, int height) {
+    load();
+    if (heights.value(txid, 0) == height)
+        return;
+
+    heights[txid] = height;
+    for (const auto& item : items) {
+        if (item.txid == txid) {
+            save(item);
+            break;
+        }
+    }
+}
+
 void SentTxStore::addToSentTx(Tx tx, QString txid) {
     // Save transactions only if the settings are allowed
     if (!Settings::getInstance()->getSaveZtxs())
@@ -60,26 +144,10 @@ void SentTxStore::addToSentTx(Tx tx, QString txid) {
     if (!tx.fromAddr.startsWith("z")) 
         return;
 
-    QFile data(writeableFile());
-    QJsonDocument jsonDoc;
-
-    // If data doesn't exist, then create a blank one
-    if (!data.exists()) {
-        QJsonArray a;
-        jsonDoc.setArray(a);
-
-        QFile newFile(writeableFile());
-        newFile.open(QFile::WriteOnly);
-        newFile.write(jsonDoc.toJson());
-        newFile.close();
-    } else {
-        data.open(QFile::ReadOnly);    
-        jsonDoc = QJsonDocument().fromJson(data.readAll());
-        data.close();
-    }
+    load();
 
     // Calculate total amount in this tx
-    double totalAmount = 0;
+    Amount totalAmount;
     for (auto i : tx.toAddrs) {
         totalAmount += i.amount;
     }
@@ -94,24 +162,11 @@ void SentTxStore::addToSentTx(Tx tx, QString txid) {
         }
     }
 
-    auto list = jsonDoc.array();
-    QJsonObject txItem;
-    txItem["type"]      = "sent";
-    txItem["from"]      = tx.fromAddr;
-    txItem["datetime"]  = QDateTime::currentMSecsSinceEpoch() / (qint64)1000;
-    txItem["address"]   = toAddresses;
-    txItem["txid"]      = txid;
-    txItem["amount"]    = -totalAmount;
-    txItem["fee"]       = -tx.fee;
     // TODO: store all outgoing memos
-    txItem["memo"]      = tx.toAddrs[0].txtMemo;
-    list.append(txItem);
-
-    jsonDoc.setArray(list);
+    TransactionItem t{"send", QDateTime::currentMSecsSinceEpoch() / (qint64)1000, toAddresses, txid,
+                      -totalAmount - tx.fee, 0, tx.fromAddr, tx.toAddrs[0].txtMemo};
+    items.push_back(t);
+    save(t);
 
-    QFile writer(writeableFile());
-    if (writer.open(QFile::WriteOnly | QFile::Truncate)) {
-        writer.write(jsonDoc.toJson());
-    } 
-    writer.close();
+    emit changed();
 }
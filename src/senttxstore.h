@@ -4,17 +4,49 @@
 #include "precompiled.h"
 #include "mainwindow.h"
 #include "rpc.h"
+#include "walletstore.h"
 
-class SentTxStore {
+/**
+ * The z-transactions sent from this wallet, which komodod doesn't keep track of.
+ *
+ * They're kept in memory, and every change is written to the "senttx" wallet table, so saving a new
+ * tx doesn't rewrite the whole history. Once a tx is deep enough in the chain, the block it was mined in is
+ * recorded too, so its confirmations can be worked out from the block number without asking komodod.
+ */
+class SentTxStore : public QObject
+{
+    Q_OBJECT
 public:
-    static void deleteHistory();
+    static SentTxStore* getInstance();
 
-    static QList<TransactionItem> readSentTxFile();
-    static void                   addToSentTx(Tx tx, QString txid);
+    const QList<TransactionItem>& getAll();
+
+    void    addToSentTx(Tx tx, QString txid);
+    void    deleteHistory();
+
+    // Block the tx was mined in, or 0 if it isn't final yet
+    int     getConfirmedHeight(const QString& txid);
+    void    setConfirmedHeight(const QString& txid, int height);
+
+    // After this many confirmations, a tx is not expected to be reorged out anymore
+    static const int finalConfirmations = 10;
+
+signals:
+    // A tx was added or the history was deleted
+    void    changed();
 
 private:
-    static QString writeableFile();
-    
+    SentTxStore() = default;
+
+    void    load();
+    void    importOldFile();
+    void    save(const TransactionItem& item);
+
+    static SentTxStore*     instance;
+
+    WalletTable*            table = nullptr;
+    QList<TransactionItem>  items;
+    QHash<QString, int>     heights;
 };
 
 #endif // SENTTXSTORE_H
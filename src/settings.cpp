@@ -1,5 +1,7 @@
 #include "mainwindow.h"
 #include "settings.h"
+#include "displayformat.h"
+#include "addressvalidator.h"
 
 Settings* Settings::instance = nullptr;
 
@@ -63,11 +65,7 @@ void Settings::setTestnet(bool isTestnet) {
 }
 
 bool Settings::isSaplingAddress(QString addr) {
-    if (!isValidAddress(addr))
-        return false;
-
-    return ( isTestnet() && addr.startsWith("ztestsapling")) ||
-           (!isTestnet() && addr.startsWith("zs1"));
+    return AddressValidator::check(addr) == (isTestnet() ? AddressValidator::SaplingTestnet : AddressValidator::Sapling);
 }
 
 bool Settings::isSproutAddress(QString addr) {
@@ -78,17 +76,12 @@ bool Settings::isSproutAddress(QString addr) {
 }
 
 bool Settings::isZAddress(QString addr) {
-    if (!isValidAddress(addr))
-        return false;
-        
-    return addr.startsWith("z");
+    auto kind = AddressValidator::check(addr);
+    return kind == AddressValidator::Sapling || kind == AddressValidator::SaplingTestnet;
 }
 
 bool Settings::isTAddress(QString addr) {
-    if (!isValidAddress(addr))
-        return false;
-        
-    return addr.startsWith("t");
+    return AddressValidator::check(addr) == AddressValidator::Transparent;
 }
 
 int Settings::getZcashdVersion() {
@@ -168,43 +161,35 @@ void Settings::saveRestore(QDialog* d) {
     });
 }
 
-QString Settings::getUSDFormat(double bal) {
-    return "$" + QLocale(QLocale::English).toString(bal * Settings::getInstance()->getZECPrice(), 'f', 2);
+QString Settings::getUSDFormat(Amount bal) {
+    return DisplayFormat().fiat(bal, Settings::getInstance()->getZECPrice()).toString();
 }
 
-QString Settings::getDecimalString(double amt) {
-    QString f = QString::number(amt, 'f', 8);
-
-    while (f.contains(".") && (f.right(1) == "0" || f.right(1) == ".")) {
-        f = f.left(f.length() - 1);
-    }
-    if (f == "-0")
-        f = "0";
-
-    return f;
+QString Settings::getDecimalString(Amount amt) {
+    return amt.toDecimalString();
 }
 
-QString Settings::getZECDisplayFormat(double bal) {
-    // This is idiotic. Why doesn't QString have a way to do this?
-    return getDecimalString(bal) % " " % Settings::getTokenName();
+QString Settings::getZECDisplayFormat(Amount bal) {
+    return DisplayFormat().coins(bal).toString();
 }
 
-QString Settings::getZECUSDDisplayFormat(double bal) {
-    auto usdFormat = getUSDFormat(bal);
-    if (!usdFormat.isEmpty())
-        return getZECDisplayFormat(bal) % " (" % getUSDFormat(bal) % ")";
-    else
-        return getZECDisplayFormat(bal);
+QString Settings::getZECUSDDisplayFormat(Amount bal) {
+    // Built in one buffer, instead of formatting the parts separately and concatenating them
+    return DisplayFormat().coins(bal)
+                          .latin1(" (")
+                          .fiat(bal, Settings::getInstance()->getZECPrice())
+                          .latin1(")")
+                          .toString();
 }
 
 const QString Settings::txidStatusMessage = QString(QObject::tr("Tx submitted (right click to copy) txid:"));
 
 QString Settings::getTokenName() {
-    if (Settings::getInstance()->isTestnet()) {
-        return "THCT";
-    } else {
-        return "THC";
-    }
+    return QString::fromLatin1(Settings::getInstance()->getTokenNameLatin1());
+}
+
+const char* Settings::getTokenNameLatin1() {
+    return _isTestnet ? "THCT" : "THC";
 }
 
 QString Settings::getDonationAddr(bool sapling) {
@@ -261,12 +246,12 @@ bool Settings::removeFromZcashConf(QString confLocation, QString option) {
     return true;
 }
 
-double Settings::getMinerFee() {
-    return 0.0001;
+Amount Settings::getMinerFee() {
+    return Amount::fromZats(10000);
 }
 
-double Settings::getZboardAmount() {
-    return 0.0001;
+Amount Settings::getZboardAmount() {
+    return Amount::fromZats(10000);
 }
 
 QString Settings::getZboardAddr() {
@@ -288,68 +273,28 @@ bool Settings::isValidSaplingPrivateKey(QString pk) {
     }
 }
 
+// Checks the checksum too, see AddressValidator
 bool Settings::isValidAddress(QString addr) {
-    QRegExp zsexp("^zs1[a-z0-9]{75}$",  Qt::CaseInsensitive);
-    QRegExp ztsexp("^ztestsapling[a-z0-9]{76}", Qt::CaseInsensitive);
-    QRegExp texp("^R[a-z0-9]{33}$", Qt::CaseInsensitive);
-    //qDebug() << "isValidAddress(" << addr << ")";
-
-    return  texp.exactMatch(addr) || ztsexp.exactMatch(addr) || zsexp.exactMatch(addr);
+    return AddressValidator::isValid(addr);
 }
 
 // Get a pretty string representation of this Payment URI
 QString Settings::paymentURIPretty(PaymentURI uri) {
-    return QString() + "Payment Request\n" + "Pay: " + uri.addr + "\nAmount: " + getZECDisplayFormat(uri.amt.toDouble()) 
-        + "\nMemo:" + QUrl::fromPercentEncoding(uri.memo.toUtf8());
+    if (!uri.error.isEmpty())
+        return uri.error;
+
+    QString pretty = "Payment Request";
+    for (const auto& r : uri.recipients) {
+        pretty = pretty % "\nPay: " % r.addr % "\nAmount: " % getZECDisplayFormat(r.amount);
+        if (!r.memo.isEmpty())
+            pretty = pretty % "\nMemo: " % r.memo;
+    }
+    return pretty;
 }
 
 // Parse a payment URI string into its components
 PaymentURI Settings::parseURI(QString uri) {
-    PaymentURI ans;
-
-    if (!uri.startsWith("thc:")) {
-        ans.error = "Not a THC payment URI";
-        return ans;
-    }
-
-    uri = uri.right(uri.length() - QString("thc:").length());
-    
-    QRegExp re("([a-zA-Z0-9]+)");
-    int pos;
-    if ( (pos = re.indexIn(uri)) == -1 ) {
-        ans.error = "Couldn't find an address";
-        return ans;
-    }
-
-    ans.addr = re.cap(1);
-    if (!Settings::isValidAddress(ans.addr)) {
-        ans.error = "Could not understand address";
-        return ans;
-    }
-    uri = uri.right(uri.length() - ans.addr.length());
-
-    if (!uri.isEmpty()) {
-        uri = uri.right(uri.length() - 1); // Eat the "?"
-
-        QStringList args = uri.split("&");
-        for (QString arg: args) {
-            QStringList kv = arg.split("=");
-            if (kv.length() != 2) {
-                ans.error = "No value argument was seen";
-                return ans;
-            }
-
-            if (kv[0].toLower() == "amt" || kv[0].toLower() == "amount") {
-                ans.amt = kv[1];
-            } else if (kv[0].toLower() == "memo" || kv[0].toLower() == "message" || kv[0].toLower() == "msg") {
-                ans.memo = QUrl::fromPercentEncoding(kv[1].toUtf8());
-            } else {
-                // Ignore unknown fields, since some developers use it to pass extra data.
-            }
-        }
-    }
-
-    return ans;
+    return PaymentURI::parse(uri);
 }
 
 const QString Settings::labelRegExp("[a-zA-Z0-9\\-_]{0,40}");
@@ -2,6 +2,8 @@
 #define SETTINGS_H
 
 #include "precompiled.h"
+#include "amount.h"
+#include "paymenturi.h"
 
 struct Config {
     QString host;
@@ -13,15 +15,6 @@ struct Config {
 struct ToFields;
 struct Tx;
 
-struct PaymentURI {
-    QString addr;
-    QString amt;
-    QString memo;
-
-    // Any errors are stored here
-    QString error;
-};
-
 class Settings
 {
 public:
@@ -68,6 +61,9 @@ public:
     void    setUsingZcashConf(QString confLocation);
     const   QString& getZcashdConfLocation() { return _confLocation; }
 
+    // The token name as a static string, for formatting without creating a QString
+    const char* getTokenNameLatin1();
+
     void    setZECPrice(double p) { zecPrice = p; }
     double  getZECPrice();
 
@@ -86,16 +82,16 @@ public:
     static bool    isZAddress(QString addr);
     static bool    isTAddress(QString addr);
 
-    static QString getDecimalString(double amt);
-    static QString getUSDFormat(double bal);
-    static QString getZECDisplayFormat(double bal);
-    static QString getZECUSDDisplayFormat(double bal);
+    static QString getDecimalString(Amount amt);
+    static QString getUSDFormat(Amount bal);
+    static QString getZECDisplayFormat(Amount bal);
+    static QString getZECUSDDisplayFormat(Amount bal);
 
     static QString getTokenName();
     static QString getDonationAddr(bool sapling);
 
-    static double  getMinerFee();
-    static double  getZboardAmount();
+    static Amount  getMinerFee();
+    static Amount  getZboardAmount();
     static QString getZboardAddr();
 
     static int     getMaxMobileAppTxns() { return 30; }
@@ -0,0 +1,163 @@
+#include "stallwatchdog.h"
+#include "logger.h"
+#include "trace.h"
+
+using json = nlohmann::json;
+
+StallWatchdog* StallWatchdog::instance = nullptr;
+
+/**
+ * Checks on the heartbeat from its own thread, and notes which span the UI thread is stuck in.
+ */
+class StallMonitor : public QThread {
+public:
+    explicit StallMonitor(StallWatchdog* w) : watchdog(w) {}
+
+    void stop() { stopping.store(true); }
+
+protected:
+    void run() override {
+        while (!stopping.load()) {
+            msleep(StallWatchdog::heartbeatInterval / 2);
+
+            qint64 since = watchdog->clock.elapsed() - watchdog->lastBeatAt.load();
+            if (since > StallWatchdog::heartbeatInterval + StallWatchdog::stallThreshold &&
+                    watchdog->stalledIn.load() == nullptr) {
+                const char* span = Trace::currentUISpan();
+                watchdog->stalledIn.store(span != nullptr ? span : "(no span)");
+            }
+        }
+    }
+
+private:
+    StallWatchdog*      watchdog;
+    std::atomic<bool>   stopping { false };
+};
+
+StallWatchdog* StallWatchdog::getInstance() {
+    if (instance == nullptr)
+        instance = new StallWatchdog();
+
+    return instance;
+}
+
+// Must be called from the UI thread
+void StallWatchdog::start(bool trackSpans) {
+    if (running)
+        return;
+
+    running       = true;
+    trackingSpans = trackSpans;
+
+    clock.start();
+    lastBeat = 0;
+    lastBeatAt.store(0);
+
+    heartbeat.setInterval(heartbeatInterval);
+    QObject::connect(&heartbeat, &QTimer::timeout, this, &StallWatchdog::beat, Qt::UniqueConnection);
+    heartbeat.start();
+
+    // Without the spans there's nothing for the monitor to look at, the stalls are still caught by the beat
+    if (trackSpans) {
+        Trace::trackUISpans();
+
+        monitor = new StallMonitor(this);
+        monitor->start(QThread::LowPriority);
+    }
+}
+
+void StallWatchdog::stop() {
+    heartbeat.stop();
+    running = false;
+
+    if (monitor != nullptr) {
+        monitor->stop();
+        monitor->wait();
+        delete monitor;
+        monitor = nullptr;
+    }
+}
+
+void StallWatchdog::beat() {
+    qint64 now  = clock.elapsed();
+    qint64 late = now - lastBeat - heartbeatInterval;
+
+    lastBeat = now;
+    lastBeatAt.store(now);
+
+    const char* span = stalledIn.exchange(nullptr);
+    if (late < stallThreshold)
+        return;
+
+    // If the stall was over before the monitor looked, we don't know where it was
+    QString spanName = span != nullptr ? QString::fromLatin1(span) :
+                       trackingSpans   ? QStringLiteral("(unknown)") : QStringLiteral("(not tracked)");
+
+    stalls++;
+    totalStallMs += late;
+    maxStallMs    = std::max(maxStallMs, late);
+    histogram[late < 500 ? 0 : late < 1000 ? 1 : late < 5000 ? 2 : 3]++;
+
+    auto& stats = bySpan[spanName];
+    stats.count++;
+    stats.totalMs += late;
+    stats.maxMs    = std::max(stats.maxMs, late);
+
+    LOG_WARNING("Event loop stalled", {{"ms", QString::number(late)}, {"span", spanName}});
+    Trace::instant("stall", "watchdog", {{"ms", late}, {"span", spanName.toStdString()}});
+}
+
+json StallWatchdog::report() const {
+    json spans = json::array();
+    for (auto it = bySpan.constBegin(); it != bySpan.constEnd(); ++it) {
+        spans.push_back({
+            {"span",     it.key().toStdString()},
+            {"count",    it.value().count},
+            {"total_ms", it.value().totalMs},
+            {"max_ms",   it.value().maxMs}
+        });
+    }
+
+    // Worst offenders first
+    std::sort(spans.begin(), spans.end(), [] (const json& a, const json& b) {
+        return a["total_ms"].get<qint64>() > b["total_ms"].get<qint64>();
+    });
+
+    return {
+        {"threshold_ms",    stallThreshold},
+        {"stalls",          stalls},
+        {"total_ms",        totalStallMs},
+        {"max_ms",          maxStallMs},
+        {"histogram",       {
+            {"under_500ms",  histogram[0]},
+            {"under_1s",     histogram[1]},
+            {"under_5s",     histogram[2]},
+            {"over_5s",      histogram[3]}
+        }},
+        {"spans",           spans}
+    };
+}
+
+bool StallWatchdog::writeReport(const QString& fileName) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    file.write(QByteArray::fromStdString(report().dump(2)));
+    file.close();
+
+    return true;
+}
+
+void StallWatchdog::logSummary() const {
+    LOG_INFO("Event loop stalls", {{"count",    QString::number(stalls)},
+                                   {"total_ms", QString::number(totalStallMs)},
+                                   {"max_ms",   QString::number(maxStallMs)}});
+
+    auto spans = report()["spans"];
+    for (size_t i = 0; i < spans.size() && i < 5; i++) {
+        LOG_INFO("Stalled in", {{"span",     QString::fromStdString(spans[i]["span"].get<std::string>())},
+                                {"count",    QString::number(spans[i]["count"].get<int>())},
+                                {"total_ms", QString::number(spans[i]["total_ms"].get<qint64>())}});
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include "precompiled.h"
+
+class StallMonitor;
+
+/**
+ * Watches for the UI thread's event loop getting stuck.
+ *
+ * A heartbeat timer on the UI thread should fire every heartbeatInterval ms. When it fires late by more
+ * than stallThreshold ms, the event loop was blocked, by a long model rebuild, a blocking call or a
+ * sleep. A modal dialog isn't a stall, its nested event loop keeps the heartbeat going (see
+ * TraceNestedLoop). When spans are tracked, a monitor thread checks on the heartbeat while the UI thread is stuck,
+ * so it can record the trace span the UI thread was in at the time. Tracking costs every span on the UI
+ * thread an atomic exchange, so it's only turned on when a report was asked for.
+ *
+ * Each stall is logged, and added to per-span statistics that are logged at exit and can be written
+ * out as JSON with --stall-report.
+ */
+class StallWatchdog : public QObject
+{
+    Q_OBJECT
+public:
+    static StallWatchdog* getInstance();
+
+    void    start(bool trackSpans);
+    void    stop();
+
+    // Stall statistics as JSON
+    nlohmann::json  report() const;
+    bool            writeReport(const QString& fileName) const;
+    void            logSummary() const;
+
+    static const int heartbeatInterval  = 100;     // ms
+    static const int stallThreshold     = 250;     // ms
+
+private:
+    StallWatchdog() = default;
+
+    void    beat();
+
+    struct SpanStats {
+        int     count   = 0;
+        qint64  totalMs = 0;
+        qint64  maxMs   = 0;
+    };
+
+    friend class StallMonitor;
+
+    QTimer                  heartbeat;
+    QElapsedTimer           clock;
+    qint64                  lastBeat        = 0;
+    bool                    running         = false;
+    bool                    trackingSpans   = false;
+    StallMonitor*           monitor         = nullptr;
+
+    // Written by the UI thread on every beat, read by the monitor thread
+    std::atomic<qint64>     lastBeatAt      { 0 };
+
+    // Set by the monitor thread while the UI thread is stuck
+    std::atomic<const char*> stalledIn      { nullptr };
+
+    // Durations in ms: < 500, < 1000, < 5000, and longer
+    std::array<int, 4>      histogram       {{ 0, 0, 0, 0 }};
+    int                     stalls          = 0;
+    qint64                  totalStallMs    = 0;
+    qint64                  maxStallMs      = 0;
+    QHash<QString, SpanStats> bySpan;
+
+    static StallWatchdog*   instance;
+};
+
+#endif // STALLWATCHDOG_H
@@ -0,0 +1,118 @@
+#include "trace.h"
+#include "logger.h"
+
+using json = nlohmann::json;
+
+std::atomic<int>        Trace::modes    { 0 };
+std::atomic<const char*> Trace::uiSpan  { nullptr };
+Qt::HANDLE              Trace::uiThread = nullptr;
+std::atomic<quint64>    Trace::nextId   { 1 };
+QElapsedTimer           Trace::clock;
+QString                 Trace::fileName;
+QMutex                  Trace::mutex;
+QVector<Trace::Event>   Trace::events;
+
+void Trace::start(const QString& file) {
+    QMutexLocker locker(&mutex);
+
+    fileName = file;
+    events.clear();
+    clock.start();
+
+    modes.fetch_or(Record);
+}
+
+void Trace::trackUISpans() {
+    uiThread = QThread::currentThreadId();
+    modes.fetch_or(TrackUI);
+}
+
+qint64 Trace::now() {
+    return clock.nsecsElapsed() / 1000;
+}
+
+void Trace::add(Event e) {
+    e.tid = (quint64)reinterpret_cast<quintptr>(QThread::currentThreadId());
+
+    QMutexLocker locker(&mutex);
+    if (events.size() < maxEvents)
+        events.push_back(e);
+}
+
+void Trace::complete(const char* name, const char* cat, qint64 begin, qint64 end, const json& args) {
+    if (!isEnabled())
+        return;
+
+    add(Event{ QByteArray(name), cat, 'X', begin, end - begin, 0, 0, args });
+}
+
+quint64 Trace::asyncBegin(const QByteArray& name, const char* cat) {
+    if (!isEnabled())
+        return 0;
+
+    quint64 id = nextId.fetch_add(1, std::memory_order_relaxed);
+    add(Event{ name, cat, 'b', now(), 0, 0, id, json() });
+    return id;
+}
+
+void Trace::asyncEnd(const QByteArray& name, const char* cat, quint64 id) {
+    if (!isEnabled() || id == 0)
+        return;
+
+    add(Event{ name, cat, 'e', now(), 0, 0, id, json() });
+}
+
+void Trace::instant(const QByteArray& name, const char* cat, const json& args) {
+    if (!isEnabled())
+        return;
+
+    add(Event{ name, cat, 'i', now(), 0, 0, 0, args });
+}
+
+// Write out everything recorded so far in the Chrome trace event format
+void Trace::stop() {
+    if ((modes.fetch_and(~Record) & Record) == 0)
+        return;
+
+    QMutexLocker locker(&mutex);
+
+    json traceEvents = json::array();
+    for (const auto& e : events) {
+        json j = {
+            {"name", e.name.toStdString()},
+            {"cat",  e.cat},
+            {"ph",   std::string(1, e.phase)},
+            {"ts",   e.ts},
+            {"pid",  (qint64)QCoreApplication::applicationPid()},
+            {"tid",  e.tid}
+        };
+
+        if (e.phase == 'X')
+            j["dur"] = e.dur;
+        if (e.phase == 'b' || e.phase == 'e')
+            j["id"] = e.id;
+        if (e.phase == 'i')
+            j["s"] = "p";       // Process wide, so it shows across all the threads
+        if (!e.args.is_null())
+            j["args"] = e.args;
+
+        traceEvents.push_back(j);
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        LOG_ERROR("Couldn't write the trace", {{"file", fileName}, {"error", file.errorString()}});
+        return;
+    }
+
+    json out = { {"traceEvents", traceEvents}, {"displayTimeUnit", "ms"} };
+    file.write(QByteArray::fromStdString(out.dump()));
+    file.close();
+
+    events.clear();
+}
+
+void TraceSpan::arg(const char* key, const QString& value) {
+    if (active)
+        args[key] = value.toStdString();
+}
@@ -0,0 +1,156 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "precompiled.h"
+
+/**
+ * Records timed spans of what the wallet is doing, and writes them out as a Chrome trace
+ * (chrome://tracing or ui.perfetto.dev) when the app exits. Turned on with --trace-file.
+ *
+ * When tracing is off, a span costs one relaxed atomic load.
+ *
+ * Separately from recording, the name of the innermost span running on the UI thread can be tracked,
+ * so the stall watchdog can tell what the UI thread was busy with.
+ */
+class Trace
+{
+public:
+    enum Mode {
+        Record      = 1,
+        TrackUI     = 2
+    };
+
+    static int      mode()          { return modes.load(std::memory_order_relaxed); }
+    static bool     isEnabled()     { return (mode() & Record) != 0; }
+
+    static void     start(const QString& fileName);
+    static void     stop();
+
+    // Microseconds since tracing started
+    static qint64   now();
+
+    // A span that has finished on the current thread
+    static void     complete(const char* name, const char* cat, qint64 begin, qint64 end, const nlohmann::json& args);
+
+    // A span that starts and ends in different callbacks, like an RPC call waiting for its reply.
+    // asyncBegin returns the id to pass to asyncEnd.
+    static quint64  asyncBegin(const QByteArray& name, const char* cat);
+    static void     asyncEnd(const QByteArray& name, const char* cat, quint64 id);
+
+    // A point in time, like a detected stall
+    static void     instant(const QByteArray& name, const char* cat, const nlohmann::json& args);
+
+    // Start keeping track of the innermost span on the calling thread, which has to be the UI thread
+    static void     trackUISpans();
+    static bool     isUIThread()    { return QThread::currentThreadId() == uiThread; }
+
+    // The span the UI thread is in right now, or null. Can be read from any thread.
+    static const char* currentUISpan() { return uiSpan.load(std::memory_order_acquire); }
+
+    static const int maxEvents = 1000000;
+
+private:
+    friend class TraceSpan;
+    friend class TraceNestedLoop;
+
+    struct Event {
+        QByteArray  name;
+        const char* cat;
+        char        phase;
+        qint64      ts;
+        qint64      dur;
+        quint64     tid;
+        quint64     id;
+        nlohmann::json args;
+    };
+
+    static void     add(Event e);
+
+    static std::atomic<int>     modes;
+    static std::atomic<const char*> uiSpan;
+    static Qt::HANDLE           uiThread;
+    static std::atomic<quint64> nextId;
+    static QElapsedTimer        clock;
+    static QString              fileName;
+    static QMutex               mutex;
+    static QVector<Event>       events;
+};
+
+/**
+ * Times the scope it's declared in.
+ */
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* n, const char* c = "wallet") : name(n), cat(c) {
+        int m = Trace::mode();
+        if (m == 0)
+            return;
+
+        if ((m & Trace::Record) != 0) {
+            active = true;
+            begin  = Trace::now();
+        }
+        if ((m & Trace::TrackUI) != 0 && Trace::isUIThread()) {
+            tracked = true;
+            parent  = Trace::uiSpan.exchange(name, std::memory_order_acq_rel);
+        }
+    }
+
+    ~TraceSpan() {
+        if (active)
+            Trace::complete(name, cat, begin, Trace::now(), args);
+        if (tracked)
+            Trace::uiSpan.store(parent, std::memory_order_release);
+    }
+
+    void arg(const char* key, const QString& value);
+    void arg(const char* key, qint64 value)         { if (active) arg(key, QString::number(value)); }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    const char* name;
+    const char* cat;
+    bool        active  = false;
+    bool        tracked = false;
+    const char* parent  = nullptr;
+    qint64      begin   = 0;
+    nlohmann::json args;
+};
+
+/**
+ * Declared around a nested event loop on the UI thread, like a modal dialog. The nested loop keeps the
+ * stall watchdog's heartbeat going, so it isn't a stall itself, but the events it handles have nothing to
+ * do with the spans around it. So those are taken off the tracked UI span until the loop returns, and a
+ * stall inside it is put down to the handler's own span, or to no span.
+ */
+class TraceNestedLoop
+{
+public:
+    TraceNestedLoop() {
+        if ((Trace::mode() & Trace::TrackUI) != 0 && Trace::isUIThread()) {
+            tracked = true;
+            outer   = Trace::uiSpan.exchange(nullptr, std::memory_order_acq_rel);
+        }
+    }
+
+    ~TraceNestedLoop() {
+        if (tracked)
+            Trace::uiSpan.store(outer, std::memory_order_release);
+    }
+
+private:
+    Q_DISABLE_COPY(TraceNestedLoop)
+
+    bool        tracked = false;
+    const char* outer   = nullptr;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+
+// Time the rest of the current scope
+#define TRACE_SPAN(...)     TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(__VA_ARGS__)
+
+#endif // TRACE_H
@@ -19,75 +19,135 @@ void printPlan(QList<TurnstileMigrationItem> plan) {
     }
 }
 
-QString Turnstile::writeableFile() {
-    auto filename = QStringLiteral("turnstilemigrationplan.dat");
-
-    auto dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
-    if (!dir.exists())
-        QDir().mkpath(dir.absolutePath());
-
-    if (Settings::getInstance()->isTestnet()) {
-        return dir.filePath("testnet-" % filename);
-    } else {
-        return dir.filePath(filename);
-    }
-}
-
-void Turnstile::removeFile() {
-    QFile(writeableFile()).remove();
-}
-
-// Data stream write/read methods for migration items
+// Data stream write/read methods for migration items. The amount is kept as a double on disk, so
+// existing plans can still be read.
 QDataStream &operator<<(QDataStream& ds, const TurnstileMigrationItem& item) {
     return ds << QString("v1") << item.fromAddr << item.intTAddr 
-                 << item.destAddr << item.amount << item.blockNumber << item.status;
+                 << item.destAddr << item.amount.toDouble() << item.blockNumber << item.status;
 }
 
 QDataStream &operator>>(QDataStream& ds, TurnstileMigrationItem& item) {
     QString version;
-    return ds >> version >> item.fromAddr >> item.intTAddr 
-                 >> item.destAddr >> item.amount >> item.blockNumber >> item.status;
+    double  amount;
+    ds >> version >> item.fromAddr >> item.intTAddr 
+       >> item.destAddr >> amount >> item.blockNumber >> item.status;
+    item.amount = Amount::fromDouble(amount);
+    return ds;
 }
 
-void Turnstile::writeMigrationPlan(QList<TurnstileMigrationItem> plan) {
-    //qDebug() << QString("Writing plan");
-    printPlan(plan);
-
-    QFile file(writeableFile());
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate);
-    QDataStream out(&file);   // we will serialize the data into the file
-    out << plan;
-    file.close();
+namespace {
+    QByteArray encodeItem(const TurnstileMigrationItem& item) {
+        QByteArray value;
+        QDataStream out(&value, QIODevice::WriteOnly);
+        out << item;
+        return value;
+    }
 }
 
-QList<TurnstileMigrationItem> Turnstile::readMigrationPlan() {
-    QFile file(writeableFile());
-    
-    QList<TurnstileMigrationItem> plan;
-    if (!file.exists()) return plan;
+// Load the plan for the current network, if it isn't already. The table is read once, and after that
+// the in-memory plan is the source of truth.
+void Turnstile::loadPlan() {
+    auto t = WalletStore::getInstance()->table(QStringLiteral("turnstile"));
+    if (t == table)
+        return;
 
-    file.open(QIODevice::ReadOnly);
-    QDataStream in(&file);    // read the data serialized from the file
-    in >> plan; 
+    table = t;
+    plan.clear();
+    pendingSteps.clear();
 
-    file.close();
+    // Each item is stored under its intermediate t-addr, which is unique in a plan
+    for (const auto& value : table->all()) {
+        QDataStream in(value);
+        TurnstileMigrationItem item;
+        in >> item;
+        plan.push_back(item);
+    }
+
+    importOldFile();
 
     // Sort to see when the next step is.
     std::sort(plan.begin(), plan.end(), [&] (auto a, auto b) {
         return a.blockNumber < b.blockNumber;
     });        
+}
+
+// A plan written by earlier versions, which rewrote the whole file on every step
+void Turnstile::importOldFile() {
+    QFile oldFile(WalletStore::writeableFile(QStringLiteral("turnstilemigrationplan.dat")));
+    if (!oldFile.exists())
+        return;
+
+    if (!plan.isEmpty()) {
+        oldFile.remove();
+        return;
+    }
+
+    if (!oldFile.open(QIODevice::ReadOnly)) {
+        LOG_WARNING("Couldn't open the old migration plan", {{"file", oldFile.fileName()}, {"error", oldFile.errorString()}});
+        return;
+    }
+
+    QList<TurnstileMigrationItem> oldPlan;
+    QDataStream in(&oldFile);
+    in >> oldPlan;
+    bool readOk = in.status() == QDataStream::Ok;
+    oldFile.close();
+
+    if (readOk && writeMigrationPlan(oldPlan) && table->sync()) {
+        oldFile.remove();
+    } else {
+        LOG_WARNING("Couldn't move the old migration plan, will try again", {{"file", oldFile.fileName()}});
+    }
+}
+
+bool Turnstile::writeMigrationPlan(QList<TurnstileMigrationItem> newPlan) {
+    //qDebug() << QString("Writing plan");
+    printPlan(newPlan);
+
+    loadPlan();
+    plan = newPlan;
+
+    // The new plan replaces the old one in a single commit
+    table->beginBatch();
+    table->clear();
+    for (const auto& item : plan) {
+        table->put(item.intTAddr.toUtf8(), encodeItem(item));
+    }
+    return table->commit();
+}
+
+void Turnstile::setStatus(const QString& intTAddr, int status) {
+    loadPlan();
 
+    for (auto& item : plan) {
+        if (item.intTAddr == intTAddr) {
+            item.status = status;
+            table->put(item.intTAddr.toUtf8(), encodeItem(item));
+        }
+    }
+}
+
+const QList<TurnstileMigrationItem>& Turnstile::readMigrationPlan() {
+    loadPlan();
     return plan;
 }
 
+void Turnstile::removeFile() {
+    loadPlan();
+
+    plan.clear();
+    pendingSteps.clear();
+    table->clear();
+}
+
 void Turnstile::planMigration(QString zaddr, QString destAddr, int numsplits, int numBlocks) {
     // First, get the balance and split up the amounts
-    auto bal = rpc->getAllBalances()->value(zaddr);
+    auto bal = rpc->getSnapshot()->balances.value(zaddr);
     auto splits = splitAmount(bal, numsplits);
 
     // Then, generate an intermediate t-address for each part using getBatchRPC
-    rpc->getConnection()->doBatchRPC<double>(splits,
-        [=] (double /*unused*/) {
+    rpc->getConnection()->doBatchRPC<Amount>(splits,
+        [=] (Amount /*unused*/) {
             json payload = {
                 {"jsonrpc", "1.0"},
                 {"id", "someid"},
@@ -95,7 +155,7 @@ void Turnstile::planMigration(QString zaddr, QString destAddr, int numsplits, in
             };
             return payload;
         },
-        [=] (QMap<double, json>* newAddrs) {
+        [=] (QMap<Amount, json>* newAddrs) {
             // Get block numbers
             auto curBlock = Settings::getInstance()->getBlockNumber();
             auto blockNumbers = getBlockNumbers(curBlock, curBlock + numBlocks, splits.size());
@@ -146,10 +206,10 @@ QList<int> Turnstile::getBlockNumbers(int start, int end, int count) {
 }
 
     // Need at least 0.0005 ZEC for this
-double Turnstile::minMigrationAmount = 0.0005;
+Amount Turnstile::minMigrationAmount = Amount::fromZats(50000);
 
-QList<double> Turnstile::splitAmount(double amount, int parts) {
-    QList<double> amounts;
+QList<Amount> Turnstile::splitAmount(Amount amount, int parts) {
+    QList<Amount> amounts;
 
     if (amount < minMigrationAmount)
         return amounts;
@@ -158,19 +218,21 @@ QList<double> Turnstile::splitAmount(double amount, int parts) {
     //qDebug() << amounts;
 
     // Ensure they all add up!
-    double sumofparts = 0;
+    Amount sumofparts;
     for (auto a : amounts) {
         sumofparts += a;
     }
     
     // Add the Tx fees
-    sumofparts += amounts.size() * Settings::getMinerFee();
+    sumofparts += Settings::getMinerFee() * amounts.size();
 
     return amounts;
 }
 
-void Turnstile::fillAmounts(QList<double>& amounts, double amount, int count) {
-    if (count == 1 || amount < 0.01) {
+void Turnstile::fillAmounts(QList<Amount>& amounts, Amount amount, int count) {
+    const Amount cent = Amount::fromZats(Amount::COIN / 100);
+
+    if (count == 1 || amount < cent) {
         // Also account for the fees needed to send all these transactions
         auto actual = amount - (Settings::getMinerFee() * (amounts.size() + 1));
 
@@ -179,56 +241,52 @@ void Turnstile::fillAmounts(QList<double>& amounts, double amount, int count) {
     }
 
     // Get a random amount off the total amount and call recursively.
-    // Multiply by hundred, because we'll operate on 0.01 ZEC minimum. We'll divide by 100 later on 
-    // in this function.
-    double curAmount = std::rand() % (int)std::floor(amount * 100);
+    // We'll operate on 0.01 ZEC minimum, so pick a random number of cents.
+    qint64 cents = std::rand() % (amount.toZats() / cent.toZats());
 
     // Try to round it off
-    auto places = (int)std::floor(std::log10(curAmount));
-    if (places > 0) {
-        auto a = std::pow(10, places);
-        curAmount = std::floor(curAmount / a) * a;
+    qint64 a = 1;
+    while (a * 10 <= cents)
+        a *= 10;
+    if (a > 1) {
+        cents = (cents / a) * a;
     }
 
-    // And divide by 100
-    curAmount = curAmount / 100;
+    auto curAmount = cent * cents;
 
-    if (curAmount > 0)
+    if (curAmount.isPositive())
         amounts.push_back(curAmount);
 
     fillAmounts(amounts, amount - curAmount, count - 1);
 }
 
-QList<TurnstileMigrationItem>::Iterator
-Turnstile::getNextStep(QList<TurnstileMigrationItem>& plan) {
-    // Get to the next unexecuted step
-    auto fnIsEligibleItem = [&] (auto item) {
-        return     item.status == TurnstileMigrationItemStatus::NotStarted || 
+namespace {
+    bool isEligibleItem(const TurnstileMigrationItem& item) {
+        return  item.status == TurnstileMigrationItemStatus::NotStarted || 
                 item.status == TurnstileMigrationItemStatus::SentToT;
-    };
-
-    // Find the next step
-    auto nextStep = std::find_if(plan.begin(), plan.end(), fnIsEligibleItem);
-    return nextStep;
+    }
 }
 
 bool Turnstile::isMigrationPresent() {
-    auto plan = readMigrationPlan();
-    return !plan.isEmpty();
+    return !readMigrationPlan().isEmpty();
 }
 
 ProgressReport Turnstile::getPlanProgress() {
-    auto plan = readMigrationPlan();
-
-    auto nextStep = getNextStep(plan);
-
-    auto step = std::distance(plan.begin(), nextStep) * 2;    // 2 steps per item
-    if (nextStep != plan.end() && 
-        nextStep->status == TurnstileMigrationItemStatus::SentToT)
-        step++;
+    loadPlan();
+
+    // Steps can run out of order, so count what each item has done. 2 steps per item, and an 
+    // item that failed counts as done, since nothing more will happen with it.
+    int step = 0;
+    for (const auto& item : plan) {
+        if (item.status == TurnstileMigrationItemStatus::SentToT)
+            step += 1;
+        else if (!isEligibleItem(item))
+            step += 2;
+    }
     
     auto total = plan.size();
 
+    auto nextStep  = std::find_if(plan.begin(), plan.end(), isEligibleItem);
     auto nextBlock = nextStep == plan.end() ? 0 : nextStep->blockNumber;
 
     bool hasErrors = std::find_if(plan.begin(), plan.end(), [=] (auto i) {
@@ -238,7 +296,7 @@ ProgressReport Turnstile::getPlanProgress() {
 
     auto stepData = (nextStep == plan.end() ? std::prev(nextStep) : nextStep);
 
-    return ProgressReport{(int)step, total*2, nextBlock, hasErrors, stepData->fromAddr, stepData->destAddr, stepData->intTAddr};
+    return ProgressReport{step, total*2, nextBlock, hasErrors, stepData->fromAddr, stepData->destAddr, stepData->intTAddr};
 }
 
 void Turnstile::executeMigrationStep() {
@@ -246,121 +304,140 @@ void Turnstile::executeMigrationStep() {
     if (Settings::getInstance()->isSyncing())
         return;
 
-    auto plan = readMigrationPlan();
+    loadPlan();
 
     //qDebug() << QString("Executing step");
     printPlan(plan);
 
-    // Get to the next unexecuted step
-    auto fnIsEligibleItem = [&] (auto item) {
-        return  item.status == TurnstileMigrationItemStatus::NotStarted || 
-                item.status == TurnstileMigrationItemStatus::SentToT;
-    };
+    // Work from one snapshot for the whole pass, so all the steps see the same balances and UTXOs
+    auto snapshot = rpc->getSnapshot();
 
     // Fn to find if there are any unconfirmed funds for this address.
     auto fnHasUnconfirmed = [=] (QString addr) {
-        auto utxoset = rpc->getUTXOs();
-        return std::find_if(utxoset->begin(), utxoset->end(), [=] (auto utxo) {
+        const auto& utxoset = snapshot->utxos;
+        return std::find_if(utxoset.begin(), utxoset.end(), [=] (const auto& utxo) {
                     return utxo.address == addr && utxo.confirmations == 0 && utxo.spendable;
-                }) != utxoset->end();
+                }) != utxoset.end();
     };
 
-    // Find the next step
-    auto nextStep = std::find_if(plan.begin(), plan.end(), fnIsEligibleItem);
+    auto curBlock = Settings::getInstance()->getBlockNumber();
+    auto notStarted = std::count_if(plan.begin(), plan.end(), [] (auto item) {
+        return item.status == TurnstileMigrationItemStatus::NotStarted;
+    });
+
+    // Run every step that is due. The second half of each item sends from its own intermediate t-addr,
+    // so those can all go out in the same block. The first half sends from the z-addr, and the change
+    // from that stays unconfirmed, so only one of those per z-addr can go out per block.
+    QSet<QString> zaddrsUsed;
+
+    // Take a copy, since the tx callbacks change the status of the items in the plan
+    const auto steps = plan;
+    for (const auto& nextStep : steps) {
+        if (nextStep.blockNumber > curBlock) 
+            break;      // The plan is sorted, so nothing after this is due either
+
+        if (!isEligibleItem(nextStep))
+            continue;
+
+        if (pendingSteps.contains(nextStep.intTAddr)) {
+            if (nextStep.status == TurnstileMigrationItemStatus::NotStarted)
+                zaddrsUsed.insert(nextStep.fromAddr);
+            continue;
+        }
 
-    if (nextStep == plan.end()) 
-        return; // Nothing to do    
-    
-    if (nextStep->blockNumber > Settings::getInstance()->getBlockNumber()) 
-        return;
+        // Execute this step
+        if (nextStep.status == TurnstileMigrationItemStatus::NotStarted) {
+            if (zaddrsUsed.contains(nextStep.fromAddr))
+                continue;
+            zaddrsUsed.insert(nextStep.fromAddr);
 
-    // Is this the last step for this address?
-    auto lastStep = std::find_if(std::next(nextStep), plan.end(), fnIsEligibleItem) == plan.end();
+            // Does this z addr have enough balance?
+            if (fnHasUnconfirmed(nextStep.fromAddr)) {
+                //qDebug() << QString("unconfirmed, waiting");
+                continue;
+            }
 
-    // Execute this step
-    if (nextStep->status == TurnstileMigrationItemStatus::NotStarted) {
-        // Does this z addr have enough balance?
-        if (fnHasUnconfirmed(nextStep->fromAddr)) {
-            //qDebug() << QString("unconfirmed, waiting");
-            return;
-        }
+            auto balance = snapshot->balances.value(nextStep.fromAddr);
+            if (nextStep.amount > balance) {
+                qDebug() << "Not enough balance!";
+                setStatus(nextStep.intTAddr, TurnstileMigrationItemStatus::NotEnoughBalance);
+                continue;
+            }
 
-        auto balance = rpc->getAllBalances()->value(nextStep->fromAddr);
-        if (nextStep->amount > balance) {
-            qDebug() << "Not enough balance!";
-            nextStep->status = TurnstileMigrationItemStatus::NotEnoughBalance;
-            writeMigrationPlan(plan);
-            return;
-        }
+            auto to = ToFields{ nextStep.intTAddr, nextStep.amount, "", "" };
 
-        auto to = ToFields{ nextStep->intTAddr, nextStep->amount, "", "" };
+            // If this is the last step, then send the remaining amount instead of the actual amount.
+            if (notStarted == 1) {
+                auto remainingAmount = balance - Settings::getMinerFee();
+                if (remainingAmount.isPositive()) {
+                    to.amount = remainingAmount;
+                }
+            }
 
-        // If this is the last step, then send the remaining amount instead of the actual amount.
-        if (lastStep) {
-            auto remainingAmount = balance - Settings::getMinerFee();
-            if (remainingAmount > 0) {
-                to.amount = remainingAmount;
+            // Create the Tx
+            auto tx = Tx{ nextStep.fromAddr, { to }, Settings::getMinerFee() };
+
+            // And send it
+            auto intTAddr = nextStep.intTAddr;
+            doSendTx(tx, intTAddr, [=] () {
+                // Update status and save it
+                setStatus(intTAddr, TurnstileMigrationItemStatus::SentToT);
+            });
+        } else if (nextStep.status == TurnstileMigrationItemStatus::SentToT) {
+            // First thing to do is check to see if the funds are confirmed. Only the intermediate 
+            // t-addr matters here, the z-addr may well have the next step's change in flight.
+            if (fnHasUnconfirmed(nextStep.intTAddr)) {
+                //qDebug() << QString("unconfirmed, waiting");
+                continue;
             }
-        }
 
-        // Create the Tx
-        auto tx = Tx{ nextStep->fromAddr, { to }, Settings::getMinerFee() };
+            // Sometimes, we check too quickly, and the unspent UTXO is not updated yet, so we'll
+            // double check to see if there is enough balance. 
+            if (!snapshot->balances.contains(nextStep.intTAddr)) {
+                //qDebug() << QString("The intermediate t-address doesn't have balance, even though it seems to be confirmed");
+                continue;
+            }
 
-        // And send it
-        doSendTx(tx, [=] () {
-            // Update status and write plan to disk
-            nextStep->status = TurnstileMigrationItemStatus::SentToT;
-            writeMigrationPlan(plan);
-        });
-    } else if (nextStep->status == TurnstileMigrationItemStatus::SentToT) {
-        // First thing to do is check to see if the funds are confirmed. 
-        // We'll check both the original sprout address and the intermediate t-addr for safety.
-        if (fnHasUnconfirmed(nextStep->intTAddr) || fnHasUnconfirmed(nextStep->fromAddr)) {
-            //qDebug() << QString("unconfirmed, waiting");
-            return;
-        }
+            // Send it to the final destination address.
+            auto bal = snapshot->balances.value(nextStep.intTAddr);
+            auto sendAmt = bal - Settings::getMinerFee();
 
-        // Sometimes, we check too quickly, and the unspent UTXO is not updated yet, so we'll
-        // double check to see if there is enough balance. 
-        if (!rpc->getAllBalances()->keys().contains(nextStep->intTAddr)) {
-            //qDebug() << QString("The intermediate t-address doesn't have balance, even though it seems to be confirmed");
-            return;
-        }
+            if (sendAmt.isNegative()) {
+                qDebug() << "Not enough balance!." << bal.toDecimalString() << ":" << sendAmt.toDecimalString();
+                setStatus(nextStep.intTAddr, TurnstileMigrationItemStatus::NotEnoughBalance);
+                continue;
+            }
+            
+            QList<ToFields> to = { ToFields{ nextStep.destAddr, sendAmt, "", "" } };
 
-        // Send it to the final destination address.
-        auto bal = rpc->getAllBalances()->value(nextStep->intTAddr);
-        auto sendAmt = bal - Settings::getMinerFee();
+            // Create the Tx
+            auto tx = Tx{ nextStep.intTAddr, to, Settings::getMinerFee()};
 
-        if (sendAmt < 0) {
-            qDebug() << "Not enough balance!." << bal << ":" << sendAmt;
-            nextStep->status = TurnstileMigrationItemStatus::NotEnoughBalance;
-            writeMigrationPlan(plan);
-            return;
+            // And send it
+            auto intTAddr = nextStep.intTAddr;
+            doSendTx(tx, intTAddr, [=] () {
+                // Update status and save it
+                setStatus(intTAddr, TurnstileMigrationItemStatus::SentToZS);
+            });
         }
-        
-        QList<ToFields> to = { ToFields{ nextStep->destAddr, sendAmt, "", "" } };
-
-        // Create the Tx
-        auto tx = Tx{ nextStep->intTAddr, to, Settings::getMinerFee()};
-
-        // And send it
-        doSendTx(tx, [=] () {
-            // Update status and write plan to disk
-            nextStep->status = TurnstileMigrationItemStatus::SentToZS;
-            writeMigrationPlan(plan);
-        });
     }
 }
 
-void Turnstile::doSendTx(Tx tx, std::function<void(void)> cb) {
+// Send the tx for a step. Until it either goes through or fails, the step is marked as pending, so
+// the next block doesn't send it again.
+void Turnstile::doSendTx(Tx tx, QString step, std::function<void(void)> cb) {
+    pendingSteps.insert(step);
+
     rpc->executeTransaction(tx, [=] (QString opid) {
             mainwindow->ui->statusBar->showMessage(QObject::tr("Computing Tx: ") % opid);
         },
         [=] (QString /*opid*/, QString txid) { 
             mainwindow->ui->statusBar->showMessage(Settings::txidStatusMessage + " " + txid);
+            pendingSteps.remove(step);
             cb();
         },
         [=] (QString opid, QString errStr) {
+            pendingSteps.remove(step);
             mainwindow->ui->statusBar->showMessage(QObject::tr(" Tx ") % opid % QObject::tr(" failed"), 15 * 1000);
 
             if (!opid.isEmpty())
@@ -2,6 +2,8 @@
 #define TURNSTILE_H
 
 #include "precompiled.h"
+#include "amount.h"
+#include "walletstore.h"
 
 class RPC;
 class MainWindow;
@@ -13,7 +15,7 @@ struct TurnstileMigrationItem {
     QString        intTAddr;
     QString        destAddr;
     int            blockNumber;
-    double        amount;
+    Amount        amount;
     int         status;
 };
 
@@ -35,35 +37,46 @@ struct ProgressReport {
     QString via;
 };
 
+/**
+ * The migration plan is kept in memory, and loaded from disk only once per network. Every change to it
+ * (a new plan, a step changing status, an abort) is written through to the "turnstile" wallet table as
+ * it happens, so the per-block check for due steps never touches the disk.
+ */
 class Turnstile
 {
 public:
     Turnstile(RPC* _rpc, MainWindow* mainwindow);
 
     void               planMigration(QString zaddr, QString destAddr, int splits, int numBlocks);
-    QList<double>      splitAmount(double amount, int parts);
-    void               fillAmounts(QList<double>& amounts, double amount, int count);
+    QList<Amount>      splitAmount(Amount amount, int parts);
+    void               fillAmounts(QList<Amount>& amounts, Amount amount, int count);
 
-    QList<TurnstileMigrationItem> readMigrationPlan();
-    void               writeMigrationPlan(QList<TurnstileMigrationItem> plan);
+    const QList<TurnstileMigrationItem>& readMigrationPlan();
+    bool               writeMigrationPlan(QList<TurnstileMigrationItem> plan);
     void               removeFile();
     
     void               executeMigrationStep();
     ProgressReport     getPlanProgress();
     bool               isMigrationPresent();
 
-    static double       minMigrationAmount;
+    static Amount       minMigrationAmount;
 private:
     QList<int>          getBlockNumbers(int start, int end, int count);
-    QString             writeableFile();
 
-    void                doSendTx(Tx tx, std::function<void(void)> cb);
+    void                loadPlan();
+    void                importOldFile();
+    void                setStatus(const QString& intTAddr, int status);
 
-
-    QList<TurnstileMigrationItem>::Iterator getNextStep(QList<TurnstileMigrationItem>& plan);    
+    void                doSendTx(Tx tx, QString step, std::function<void(void)> cb);
 
     RPC*         rpc;    
     MainWindow* mainwindow;
+
+    WalletTable*                    table = nullptr;
+    QList<TurnstileMigrationItem>   plan;
+
+    // Steps that have a tx being computed right now, by their intermediate t-addr
+    QSet<QString>                   pendingSteps;
 };
 
 #endif
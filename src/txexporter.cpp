@@ -0,0 +1,278 @@
+#include "txexporter.h"
+#include "rpc.h"
+
+namespace {
+
+// Flush the output buffer to disk once it grows past this many bytes
+const int FlushSize = 64 * 1024;
+
+/**
+ * Append-only output buffer used by the export worker. Everything is written directly into a
+ * single pre-reserved QByteArray, so formatting a row does not allocate.
+ */
+class RowBuffer {
+public:
+    RowBuffer() { buf.reserve(FlushSize + 4096); }
+
+    const QByteArray& bytes() const { return buf; }
+    int  size() const               { return buf.size(); }
+    void reset()                    { buf.resize(0); }     // Keeps the reserved capacity
+
+    void put(char c)                { buf.append(c); }
+    void put(const char* s)         { buf.append(s, (int)strlen(s)); }
+
+    void putInt(qint64 v) {
+        char tmp[24];
+        int  n = 0;
+        quint64 u = v < 0 ? (quint64)(-(v + 1)) + 1 : (quint64)v;
+        do {
+            tmp[n++] = (char)('0' + (u % 10));
+            u /= 10;
+        } while (u > 0);
+        if (v < 0)
+            buf.append('-');
+        while (n > 0)
+            buf.append(tmp[--n]);
+    }
+
+    void putAmount(Amount amt) {
+        char tmp[Amount::MaxChars];
+        buf.append(tmp, amt.format(tmp));
+    }
+
+    // Local date/time as "yyyy-MM-dd hh:mm:ss"
+    void putDateTime(qint64 secs) {
+        std::time_t t = (std::time_t)secs;
+        std::tm tm;
+#ifdef Q_OS_WIN
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        putPadded(tm.tm_year + 1900, 4); buf.append('-');
+        putPadded(tm.tm_mon + 1, 2);     buf.append('-');
+        putPadded(tm.tm_mday, 2);        buf.append(' ');
+        putPadded(tm.tm_hour, 2);        buf.append(':');
+        putPadded(tm.tm_min, 2);         buf.append(':');
+        putPadded(tm.tm_sec, 2);
+    }
+
+    // A quoted CSV field. Embedded quotes are doubled.
+    void putCsvField(const QString& s) {
+        buf.append('"');
+        putUtf8(s, [this] (char c) {
+            if (c == '"')
+                buf.append('"');
+            buf.append(c);
+        });
+        buf.append('"');
+    }
+
+    // A quoted JSON string with the required escapes
+    void putJsonString(const QString& s) {
+        buf.append('"');
+        putUtf8(s, [this] (char c) {
+            switch (c) {
+            case '"':  buf.append("\\\"", 2); return;
+            case '\\': buf.append("\\\\", 2); return;
+            case '\n': buf.append("\\n", 2);  return;
+            case '\r': buf.append("\\r", 2);  return;
+            case '\t': buf.append("\\t", 2);  return;
+            }
+            if ((unsigned char)c < 0x20) {
+                static const char hex[] = "0123456789abcdef";
+                char esc[6] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0xF], hex[c & 0xF] };
+                buf.append(esc, 6);
+            } else {
+                buf.append(c);
+            }
+        });
+        buf.append('"');
+    }
+
+private:
+    void putPadded(int v, int width) {
+        char tmp[8];
+        for (int i = width - 1; i >= 0; i--) {
+            tmp[i] = (char)('0' + (v % 10));
+            v /= 10;
+        }
+        buf.append(tmp, width);
+    }
+
+    // Encode UTF-16 to UTF-8 one byte at a time, passing each byte through the escaper
+    template<typename Escaper>
+    void putUtf8(const QString& s, Escaper out) {
+        const QChar* p   = s.constData();
+        const QChar* end = p + s.size();
+        for (; p < end; p++) {
+            uint cp = p->unicode();
+            if (p->isHighSurrogate() && p + 1 < end && (p + 1)->isLowSurrogate()) {
+                cp = QChar::surrogateToUcs4(*p, *(p + 1));
+                p++;
+            }
+
+            if (cp < 0x80) {
+                out((char)cp);
+            } else if (cp < 0x800) {
+                buf.append((char)(0xC0 | (cp >> 6)));
+                buf.append((char)(0x80 | (cp & 0x3F)));
+            } else if (cp < 0x10000) {
+                buf.append((char)(0xE0 | (cp >> 12)));
+                buf.append((char)(0x80 | ((cp >> 6) & 0x3F)));
+                buf.append((char)(0x80 | (cp & 0x3F)));
+            } else {
+                buf.append((char)(0xF0 | (cp >> 18)));
+                buf.append((char)(0x80 | ((cp >> 12) & 0x3F)));
+                buf.append((char)(0x80 | ((cp >> 6) & 0x3F)));
+                buf.append((char)(0x80 | (cp & 0x3F)));
+            }
+        }
+    }
+
+    QByteArray buf;
+};
+
+}
+
+TxExporter::TxExporter(TxExportOptions opts, QObject* parent) : QThread(parent), options(opts) {
+    cancelled = false;
+}
+
+TxExporter::~TxExporter() {
+    cancel();
+    wait();
+}
+
+TxExportFormat TxExporter::formatForFile(const QString& fileName) {
+    if (fileName.endsWith(".jsonl", Qt::CaseInsensitive) || fileName.endsWith(".json", Qt::CaseInsensitive))
+        return TxExportFormat::JSONLines;
+
+    return TxExportFormat::CSV;
+}
+
+void TxExporter::addRows(const QList<TransactionItem>& rows) {
+    if (rows.isEmpty())
+        return;
+
+    QMutexLocker locker(&mutex);
+    pending.enqueue(rows);      // Implicitly shared, so this doesn't copy the rows
+    hasWork.wakeOne();
+}
+
+void TxExporter::endOfInput() {
+    QMutexLocker locker(&mutex);
+    inputDone = true;
+    hasWork.wakeOne();
+}
+
+void TxExporter::cancel() {
+    QMutexLocker locker(&mutex);
+    cancelled = true;
+    hasWork.wakeOne();
+}
+
+bool TxExporter::accept(const TransactionItem& row) const {
+    if (options.fromTime > 0 && row.datetime < options.fromTime)
+        return false;
+
+    if (options.toTime > 0 && row.datetime > options.toTime)
+        return false;
+
+    // Sent z-txs to multiple recipients store all the recipients in the address field, so
+    // look for the address inside it instead of comparing the whole field.
+    if (!options.address.isEmpty() &&
+            row.fromAddr != options.address && !row.address.contains(options.address))
+        return false;
+
+    return true;
+}
+
+void TxExporter::run() {
+    QFile file(options.fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        emit done(false, file.errorString());
+        return;
+    }
+
+    RowBuffer out;
+    bool      csv     = options.format == TxExportFormat::CSV;
+    qint64    written = 0;
+    QString   error;
+
+    auto fnFlush = [&] () {
+        if (out.size() == 0)
+            return true;
+
+        if (file.write(out.bytes()) != out.size()) {
+            error = file.errorString();
+            return false;
+        }
+        out.reset();
+        return true;
+    };
+
+    if (csv)
+        out.put("\"Type\",\"Address\",\"Date/Time\",\"Amount\",\"Memo\",\"Txid\"\n");
+
+    while (error.isEmpty()) {
+        QList<TransactionItem> chunk;
+        {
+            QMutexLocker locker(&mutex);
+            while (pending.isEmpty() && !inputDone && !cancelled)
+                hasWork.wait(&mutex);
+
+            if (cancelled || pending.isEmpty())
+                break;
+
+            chunk = pending.dequeue();
+        }
+
+        for (const TransactionItem& row : chunk) {
+            if (cancelled)
+                break;
+
+            if (!accept(row))
+                continue;
+
+            const QString& addr = row.address.trimmed().isEmpty() ? QStringLiteral("(Shielded)") : row.address;
+            if (csv) {
+                out.putCsvField(row.type);      out.put(',');
+                out.putCsvField(addr);          out.put(',');
+                out.put('"'); out.putDateTime(row.datetime); out.put("\",\"");
+                out.putAmount(row.amount);      out.put("\",");
+                out.putCsvField(row.memo);      out.put(',');
+                out.putCsvField(row.txid);
+                out.put('\n');
+            } else {
+                out.put("{\"type\":");           out.putJsonString(row.type);
+                out.put(",\"address\":");        out.putJsonString(addr);
+                out.put(",\"datetime\":");       out.putInt(row.datetime);
+                out.put(",\"amount\":\"");       out.putAmount(row.amount);
+                out.put("\",\"txid\":");         out.putJsonString(row.txid);
+                out.put(",\"confirmations\":");  out.putInt((qint64)row.confirmations);
+                out.put(",\"memo\":");           out.putJsonString(row.memo);
+                out.put("}\n");
+            }
+            written++;
+
+            if (out.size() >= FlushSize && !fnFlush())
+                break;
+        }
+
+        emit progress(written);
+    }
+
+    if (error.isEmpty() && !cancelled)
+        fnFlush();
+
+    file.close();
+
+    if (cancelled || !error.isEmpty()) {
+        file.remove();
+        emit done(false, error);
+        return;
+    }
+
+    emit done(true, QString());
+}
@@ -0,0 +1,68 @@
+#ifndef TXEXPORTER_H
+#define TXEXPORTER_H
+
+#include "precompiled.h"
+
+struct TransactionItem;
+
+enum class TxExportFormat {
+    CSV = 1,
+    JSONLines
+};
+
+struct TxExportOptions {
+    QString         fileName;
+    TxExportFormat  format      = TxExportFormat::CSV;
+
+    // Date filter, in seconds since epoch, both inclusive. 0 means "no bound"
+    qint64          fromTime    = 0;
+    qint64          toTime      = 0;
+
+    // If set, only rows that were sent to or received at this address are exported
+    QString         address;
+};
+
+/**
+ * Writes the transaction history to disk on a worker thread.
+ *
+ * Rows are pushed in chunks with addRows() from any thread (typically the UI thread as RPC pages
+ * arrive), and the worker formats and streams them out as they come in. Call endOfInput() once
+ * all rows have been queued. The exporter can be cancelled at any point, in which case the
+ * partial file is removed.
+ */
+class TxExporter : public QThread
+{
+    Q_OBJECT
+public:
+    explicit TxExporter(TxExportOptions options, QObject* parent = nullptr);
+    ~TxExporter();
+
+    void    addRows(const QList<TransactionItem>& rows);
+    void    endOfInput();
+    void    cancel();
+
+    bool    isCancelled() const { return cancelled.load(); }
+
+    static  TxExportFormat formatForFile(const QString& fileName);
+
+signals:
+    void    progress(qint64 rowsWritten);
+    void    done(bool success, QString error);
+
+protected:
+    void    run() override;
+
+private:
+    bool    accept(const TransactionItem& row) const;
+
+    TxExportOptions                 options;
+
+    QMutex                          mutex;
+    QWaitCondition                  hasWork;
+    QQueue<QList<TransactionItem>>  pending;
+    bool                            inputDone   = false;
+
+    std::atomic<bool>               cancelled;
+};
+
+#endif // TXEXPORTER_H
@@ -0,0 +1,231 @@
+#include "txstore.h"
+#include "rpc.h"
+
+TxStore::TxStore() {
+    // The type table always starts with the known categories, in TxType order
+    typeNames << "send" << "receive" << "generate" << "immature" << "orphan" << "other";
+}
+
+void TxStore::reserve(int rows) {
+    types.reserve(rows);
+    datetimes.reserve(rows);
+    addrs.reserve(rows);
+    fromAddrs.reserve(rows);
+    txids.reserve(rows);
+    hasTxids.reserve(rows);
+    amounts.reserve(rows);
+    confs.reserve(rows);
+    memoOffsets.reserve(rows);
+    memoLens.reserve(rows);
+}
+
+void TxStore::clear() {
+    *this = TxStore();
+}
+
+quint8 TxStore::internType(const QString& name) {
+    int idx = typeNames.indexOf(name);
+    if (idx >= 0)
+        return (quint8)idx;
+
+    // There are only a handful of categories, but make sure a misbehaving node can't overflow the byte
+    if (typeNames.size() >= 255)
+        return (quint8)TxType::Other;
+
+    typeNames.push_back(name);
+    return (quint8)(typeNames.size() - 1);
+}
+
+bool TxStore::parseTxid(const QString& hex, TxIdBytes& out) {
+    if (hex.size() != 64)
+        return false;
+
+    auto nibble = [] (ushort c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+
+    const QChar* p = hex.constData();
+    for (int i = 0; i < 32; i++) {
+        int hi = nibble(p[2*i].unicode());
+        int lo = nibble(p[2*i + 1].unicode());
+        if (hi < 0 || lo < 0)
+            return false;
+        out[i] = (quint8)((hi << 4) | lo);
+    }
+
+    return true;
+}
+
+void TxStore::appendRow(quint8 type, qint64 datetime, AddressId addr, AddressId fromAddr, const TxIdBytes& txid,
+                        bool hasTxid, qint64 amount, quint32 confirmations, const QChar* memo, int memoLen) {
+    rowIndexValid = false;
+
+    types.push_back(type);
+    datetimes.push_back(datetime);
+    addrs.push_back(addr);
+    fromAddrs.push_back(fromAddr);
+    txids.push_back(txid);
+    hasTxids.push_back(hasTxid);
+    amounts.push_back(amount);
+    confs.push_back(confirmations);
+
+    memoOffsets.push_back((quint32)memoArena.size());
+    memoLens.push_back((quint32)memoLen);
+    if (memoLen > 0)
+        memoArena.append(memo, memoLen);
+}
+
+void TxStore::append(const TransactionItem& item) {
+    TxIdBytes txid;
+    bool hasTxid = parseTxid(item.txid, txid);
+    if (!hasTxid)
+        txid.fill(0);
+
+    auto registry = AddressRegistry::getInstance();
+    appendRow(internType(item.type), item.datetime, registry->intern(item.address), registry->intern(item.fromAddr),
+              txid, hasTxid, item.amount.toZats(), (quint32)item.confirmations,
+              item.memo.constData(), item.memo.size());
+}
+
+void TxStore::append(const QList<TransactionItem>& items) {
+    reserve(size() + items.size());
+    for (const auto& item : items) {
+        append(item);
+    }
+}
+
+void TxStore::append(const TxStore& other) {
+    reserve(size() + other.size());
+
+    // Map the other store's type ids into this store's table once, instead of per row. Address ids are
+    // process wide, so they can be copied as is.
+    QVector<quint8> typeMap(other.typeNames.size());
+    for (int i = 0; i < other.typeNames.size(); i++) {
+        typeMap[i] = internType(other.typeNames[i]);
+    }
+
+    memoArena.reserve(memoArena.size() + other.memoArena.size());
+    const QChar* otherMemos = other.memoArena.constData();
+
+    for (int row = 0; row < other.size(); row++) {
+        appendRow(typeMap[other.types[row]], other.datetimes[row], other.addrs[row],
+                  other.fromAddrs[row], other.txids[row], other.hasTxids[row], other.amounts[row],
+                  other.confs[row], otherMemos + other.memoOffsets[row], (int)other.memoLens[row]);
+    }
+}
+
+void TxStore::sortByDateDescending() {
+    rowIndexValid = false;
+
+    QVector<int> order(size());
+    std::iota(order.begin(), order.end(), 0);
+
+    // Only the date column is touched while sorting
+    std::stable_sort(order.begin(), order.end(), [this] (int a, int b) {
+        return datetimes[a] > datetimes[b];
+    });
+
+    // Then gather every column into the new order. The memo arena doesn't move, only the offsets into it.
+    auto fnPermute = [&order] (auto& column) {
+        auto sorted = column;
+        for (int i = 0; i < order.size(); i++) {
+            sorted[i] = column[order[i]];
+        }
+        column.swap(sorted);
+    };
+
+    fnPermute(types);
+    fnPermute(datetimes);
+    fnPermute(addrs);
+    fnPermute(fromAddrs);
+    fnPermute(txids);
+    fnPermute(hasTxids);
+    fnPermute(amounts);
+    fnPermute(confs);
+    fnPermute(memoOffsets);
+    fnPermute(memoLens);
+}
+
+QByteArray TxStore::rowKey(quint8 type, AddressId addr, const TxIdBytes& txid, qint64 amount) {
+    QByteArray key(32 + 4 + 1 + 8, Qt::Uninitialized);
+    char* p = key.data();
+
+    memcpy(p, txid.data(), 32);
+    qToLittleEndian<quint32>(addr.id, p + 32);
+    p[36] = (char)type;
+    qToLittleEndian<qint64>(amount, p + 37);
+
+    return key;
+}
+
+int TxStore::findRow(const QString& txid, const QString& address, const QString& type, Amount amount) const {
+    TxIdBytes bytes;
+    int typeIdx = typeNames.indexOf(type);
+    AddressId addr = AddressRegistry::getInstance()->find(address);
+    if (!parseTxid(txid, bytes) || typeIdx < 0 || (addr.isEmpty() && !address.isEmpty()))
+        return -1;
+
+    if (!rowIndexValid) {
+        rowIndex.clear();
+        rowIndex.reserve(size());
+        for (int row = 0; row < size(); row++) {
+            if (hasTxids[row])
+                rowIndex.insert(rowKey(types[row], addrs[row], txids[row], amounts[row]), row);
+        }
+        rowIndexValid = true;
+    }
+
+    return rowIndex.value(rowKey((quint8)typeIdx, addr, bytes, amount.toZats()), -1);
+}
+
+TxType TxStore::type(int row) const {
+    quint8 t = types.at(row);
+    return t < (quint8)TxType::Other ? (TxType)t : TxType::Other;
+}
+
+QString TxStore::txid(int row) const {
+    if (!hasTxids.at(row))
+        return QString();
+
+    static const char hex[] = "0123456789abcdef";
+    const TxIdBytes& bytes = txids.at(row);
+
+    QString s(64, Qt::Uninitialized);
+    QChar* p = s.data();
+    for (int i = 0; i < 32; i++) {
+        p[2*i]     = QLatin1Char(hex[bytes[i] >> 4]);
+        p[2*i + 1] = QLatin1Char(hex[bytes[i] & 0xF]);
+    }
+
+    return s;
+}
+
+QStringRef TxStore::memo(int row) const {
+    return QStringRef(&memoArena, (int)memoOffsets.at(row), (int)memoLens.at(row));
+}
+
+TransactionItem TxStore::item(int row) const {
+    return TransactionItem{
+        typeName(row),
+        datetime(row),
+        address(row),
+        txid(row),
+        amount(row),
+        (unsigned long)confirmations(row),
+        fromAddress(row),
+        memo(row).toString()
+    };
+}
+
+QList<TransactionItem> TxStore::toList() const {
+    QList<TransactionItem> items;
+    items.reserve(size());
+    for (int row = 0; row < size(); row++) {
+        items.push_back(item(row));
+    }
+
+    return items;
+}
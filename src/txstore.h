@@ -0,0 +1,103 @@
+#ifndef TXSTORE_H
+#define TXSTORE_H
+
+#include "precompiled.h"
+#include "addressregistry.h"
+#include "amount.h"
+
+struct TransactionItem;
+
+// The transaction categories komodod reports. Any other category gets its own entry in the store's
+// type table, after these. Other is only used if that table is full, and shows as "other".
+enum class TxType : quint8 {
+    Send = 0,
+    Receive,
+    Generate,
+    Immature,
+    Orphan,
+    Other
+};
+
+typedef std::array<quint8, 32> TxIdBytes;
+
+/**
+ * Compact, column oriented storage for a list of transactions.
+ *
+ * A TransactionItem holds 5 QStrings and costs several hundred bytes per row once the string
+ * headers are counted. Here each field lives in its own array instead: the type is a single byte,
+ * the txid is stored as its 32 raw bytes, addresses are AddressRegistry ids, the amount is an
+ * integer number of zats and all memos share one string arena. A row is about 70 bytes, and scanning a single column (eg. sorting by date) only touches that column's memory.
+ */
+class TxStore
+{
+public:
+    TxStore();
+
+    void    reserve(int rows);
+    void    clear();
+
+    void    append(const TransactionItem& item);
+    void    append(const QList<TransactionItem>& items);
+    void    append(const TxStore& other);
+
+    // Reorder all the rows so that the newest is first
+    void    sortByDateDescending();
+
+    int     size() const    { return datetimes.size(); }
+    bool    isEmpty() const { return datetimes.isEmpty(); }
+
+    TxType          type(int row) const;
+    QString         typeName(int row) const     { return typeNames.at(types.at(row)); }
+    qint64          datetime(int row) const     { return datetimes.at(row); }
+    AddressId       addressId(int row) const    { return addrs.at(row); }
+    QString         address(int row) const      { return addrs.at(row).toString(); }
+    QString         fromAddress(int row) const  { return fromAddrs.at(row).toString(); }
+    const TxIdBytes& txidBytes(int row) const   { return txids.at(row); }
+    QString         txid(int row) const;
+    qint64          amountZats(int row) const   { return amounts.at(row); }
+    Amount          amount(int row) const       { return Amount::fromZats(amounts.at(row)); }
+    quint32         confirmations(int row) const { return confs.at(row); }
+    void            setConfirmations(int row, quint32 c) { confs[row] = c; }
+
+    // The memo is returned as a reference into the memo arena, so it isn't copied. It is only valid
+    // until the store is next modified.
+    bool            hasMemo(int row) const      { return memoLens.at(row) > 0; }
+    QStringRef      memo(int row) const;
+
+    // Find the row for a transaction by its txid, address, type and amount, or -1. The index for this is
+    // built on the first lookup after the rows change.
+    int             findRow(const QString& txid, const QString& address, const QString& type, Amount amount) const;
+
+    // Expand a row back into a full TransactionItem
+    TransactionItem item(int row) const;
+    QList<TransactionItem> toList() const;
+
+    static bool     parseTxid(const QString& hex, TxIdBytes& out);
+
+private:
+    quint8  internType(const QString& name);
+    static QByteArray rowKey(quint8 type, AddressId addr, const TxIdBytes& txid, qint64 amount);
+    void    appendRow(quint8 type, qint64 datetime, AddressId addr, AddressId fromAddr, const TxIdBytes& txid,
+                      bool hasTxid, qint64 amount, quint32 confirmations, const QChar* memo, int memoLen);
+
+    // Columns, one entry per row
+    QVector<quint8>     types;
+    QVector<qint64>     datetimes;
+    QVector<AddressId>  addrs;
+    QVector<AddressId>  fromAddrs;
+    QVector<TxIdBytes>  txids;
+    QVector<bool>       hasTxids;
+    QVector<qint64>     amounts;
+    QVector<quint32>    confs;
+    QVector<quint32>    memoOffsets;
+    QVector<quint32>    memoLens;
+
+    // Shared data the columns point into
+    QVector<QString>            typeNames;
+    QString                     memoArena;
+
+    mutable QHash<QByteArray, int>  rowIndex;
+    mutable bool                    rowIndexValid   = false;
+};
+
+#endif // TXSTORE_H
@@ -16,71 +16,150 @@ TxTableModel::~TxTableModel() {
 
 void TxTableModel::addZSentData(const QList<TransactionItem>& data) {
     delete zsTrans;
-    zsTrans = new QList<TransactionItem>();
-    std::copy(data.begin(), data.end(), std::back_inserter(*zsTrans));
+    zsTrans = new TxStore();
+    zsTrans->append(data);
 
+    live[(int)WalletTxList::ZSent] = false;
     updateAllData();
 }
 
 void TxTableModel::addZRecvData(const QList<TransactionItem>& data) {
     delete zrTrans;
-    zrTrans = new QList<TransactionItem>();
-    std::copy(data.begin(), data.end(), std::back_inserter(*zrTrans));
+    zrTrans = new TxStore();
+    zrTrans->append(data);
 
+    live[(int)WalletTxList::ZReceived] = false;
     updateAllData();
 }
 
 
 void TxTableModel::addTData(const QList<TransactionItem>& data) {
     delete tTrans;
-    tTrans = new QList<TransactionItem>();
-    std::copy(data.begin(), data.end(), std::back_inserter(*tTrans));
+    tTrans = new TxStore();
+    tTrans->append(data);
 
+    live[(int)WalletTxList::Transparent] = false;
     updateAllData();
 }
 
-bool TxTableModel::exportToCsv(QString fileName) const {
-    if (!modeldata)
-        return false;
+TxStore*& TxTableModel::source(WalletTxList list) {
+    switch (list) {
+    case WalletTxList::ZSent:       return zsTrans;
+    case WalletTxList::ZReceived:   return zrTrans;
+    default:                        return tTrans;
+    }
+}
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
-        return false;
+void TxTableModel::applyChanges(const WalletChangeSet& changes) {
+    TraceSpan span("TxTableModel::applyChanges", "model");
+    span.arg("deltas", changes.deltas.size());
+
+    // The deltas only apply to rows that are what they start from. A missed change set, or a list that was
+    // set directly, means the lists are loaded as they are now.
+    bool inSync = synced == changes.from;
+    synced = changes.to;
+
+    // Adding or removing rows means the lists have to be merged and sorted again, so those are reloaded
+    bool rebuild = false;
+    QSet<int> reloaded;
+    auto fnReload = [&] (WalletTxList list) {
+        auto& store = source(list);
+        delete store;
+        store = new TxStore();
+        store->append(changes.to->txs(list));
+
+        live[(int)list] = true;
+        reloaded.insert((int)list);
+        rebuild = true;
+    };
+
+    for (auto list : { WalletTxList::Transparent, WalletTxList::ZSent, WalletTxList::ZReceived }) {
+        // Not loaded from the node yet, so whatever is showing stays
+        if (!changes.to->hasTxs(list))
+            continue;
+
+        if (!inSync || !live[(int)list] ||
+            changes.has(WalletDelta::TxInserted, list) || changes.has(WalletDelta::TxRemoved, list))
+            fnReload(list);
+    }
 
-    QTextStream out(&file);   // we will serialize the data into the file
+    // A new block only moves the confirmation counts, which are updated where they are
+    for (const auto& d : changes.deltas) {
+        if (d.type != WalletDelta::ConfirmationsAdvanced || reloaded.contains((int)d.list))
+            continue;
+
+        auto store = source(d.list);
+        int  row   = store != nullptr ? store->findRow(d.txid, d.address, d.txType, d.newAmount) : -1;
+        if (row < 0) {
+            // Not what we have loaded (eg. still the saved state), so load the list as it is now
+            fnReload(d.list);
+            continue;
+        }
+        store->setConfirmations(row, (quint32)d.newConfirmations);
 
-    // Write headers
-    for (int i = 0; i < headers.length(); i++) {
-        out << "\"" << headers[i] << "\",";
-    }
-    out << "\"Memo\"";
-    out << endl;
-    
-    // Write out each row
-    for (int row = 0; row < modeldata->length(); row++) {
-        for (int col = 0; col < headers.length(); col++) {
-            out << "\"" << data(index(row, col), Qt::DisplayRole).toString() << "\",";
+        if (rebuild || modeldata == nullptr)
+            continue;
+
+        int modelRow = modeldata->findRow(d.txid, d.address, d.txType, d.newAmount);
+        if (modelRow < 0) {
+            rebuild = true;
+            continue;
         }
-        // Memo
-        out << "\"" << modeldata->at(row).memo << "\"";
-        out << endl;
+        modeldata->setConfirmations(modelRow, (quint32)d.newConfirmations);
+
+        // Only the first confirmation changes how the row looks
+        if (d.oldConfirmations == 0)
+            dataChanged(index(modelRow, 0), index(modelRow, columnCount(index(0,0))-1));
     }
 
-    file.close();
-    return true;
+    if (rebuild)
+        updateAllData();
+}
+
+// All the z-transactions currently loaded. These are only known to the wallet, so unlike the t-transactions
+// they can't be paged from komodod.
+QList<TransactionItem> TxTableModel::getShieldedRows() const {
+    QList<TransactionItem> rows;
+    rows.append(getZSentRows());
+    rows.append(getZRecvRows());
+
+    return rows;
+}
+
+QList<TransactionItem> TxTableModel::getTRows() const {
+    return tTrans != nullptr ? tTrans->toList() : QList<TransactionItem>();
+}
+
+QList<TransactionItem> TxTableModel::getZSentRows() const {
+    return zsTrans != nullptr ? zsTrans->toList() : QList<TransactionItem>();
+}
+
+QList<TransactionItem> TxTableModel::getZRecvRows() const {
+    return zrTrans != nullptr ? zrTrans->toList() : QList<TransactionItem>();
+}
+
+void TxTableModel::setStale(bool s) {
+    if (stale == s)
+        return;
+
+    stale = s;
+    dataChanged(index(0, 0), index(rowCount(QModelIndex())-1, columnCount(index(0,0))-1));
 }
 
 void TxTableModel::updateAllData() {    
-    auto newmodeldata = new QList<TransactionItem>();
+    TRACE_SPAN("TxTableModel::updateAllData", "model");
+
+    auto newmodeldata = new TxStore();
+    newmodeldata->reserve((tTrans  != nullptr ? tTrans->size()  : 0) +
+                          (zsTrans != nullptr ? zsTrans->size() : 0) +
+                          (zrTrans != nullptr ? zrTrans->size() : 0));
 
-    if (tTrans  != nullptr) std::copy( tTrans->begin(),  tTrans->end(), std::back_inserter(*newmodeldata));
-    if (zsTrans != nullptr) std::copy(zsTrans->begin(), zsTrans->end(), std::back_inserter(*newmodeldata));
-    if (zrTrans != nullptr) std::copy(zrTrans->begin(), zrTrans->end(), std::back_inserter(*newmodeldata));
+    if (tTrans  != nullptr) newmodeldata->append(*tTrans);
+    if (zsTrans != nullptr) newmodeldata->append(*zsTrans);
+    if (zrTrans != nullptr) newmodeldata->append(*zrTrans);
 
     // Sort by reverse time
-    std::sort(newmodeldata->begin(), newmodeldata->end(), [=] (auto a, auto b) {
-        return a.datetime > b.datetime; // reverse sort
-    });
+    newmodeldata->sortByDateDescending();
 
     // And then swap out the modeldata with the new one.
     delete modeldata;
@@ -108,7 +187,13 @@ void TxTableModel::updateAllData() {
     if (role == Qt::TextAlignmentRole && index.column() == 3) return QVariant(Qt::AlignRight | Qt::AlignVCenter);
     
     if (role == Qt::ForegroundRole) {
-        if (modeldata->at(index.row()).confirmations == 0) {
+        if (stale) {
+            QBrush b;
+            b.setColor(Qt::gray);
+            return b;
+        }
+
+        if (modeldata->confirmations(index.row()) == 0) {
             QBrush b;
             b.setColor(Qt::red);
             return b;
@@ -120,48 +205,49 @@ void TxTableModel::updateAllData() {
         return b;        
     }
 
-    auto dat = modeldata->at(index.row());
+    int row = index.row();
     if (role == Qt::DisplayRole) {
         switch (index.column()) {
-        case 0: return dat.type;
+        case 0: return modeldata->typeName(row);
         case 1: { 
-                    auto addr = modeldata->at(index.row()).address;
+                    auto addr = modeldata->address(row);
                     if (addr.trimmed().isEmpty()) 
                         return "(Shielded)";
                     else 
                         return addr;
                 }
-        case 2: return QDateTime::fromMSecsSinceEpoch(modeldata->at(index.row()).datetime *  (qint64)1000).toLocalTime().toString();
-        case 3: return Settings::getZECDisplayFormat(modeldata->at(index.row()).amount);
+        case 2: return QDateTime::fromMSecsSinceEpoch(modeldata->datetime(row) *  (qint64)1000).toLocalTime().toString();
+        case 3: return Settings::getZECDisplayFormat(modeldata->amount(row));
         }
     } 
 
     if (role == Qt::ToolTipRole) {
         switch (index.column()) {
         case 0: { 
-                    if (dat.memo.startsWith("thc:")) {
-                        return Settings::paymentURIPretty(Settings::parseURI(dat.memo));
+                    auto memo = modeldata->memo(row);
+                    if (memo.startsWith("thc:")) {
+                        return Settings::paymentURIPretty(Settings::parseURI(memo.toString()));
                     } else {
-                        return modeldata->at(index.row()).type + 
-                        (dat.memo.isEmpty() ? "" : " tx memo: \"" + dat.memo + "\"");
+                        return modeldata->typeName(row) + 
+                        (memo.isEmpty() ? QString() : QString(" tx memo: \"" % memo % "\""));
                     }
                 }
         case 1: { 
-                    auto addr = modeldata->at(index.row()).address;
+                    auto addr = modeldata->address(row);
                     if (addr.trimmed().isEmpty()) 
                         return "(Shielded)";
                     else 
                         return addr;
                 }
-        case 2: return QDateTime::fromMSecsSinceEpoch(modeldata->at(index.row()).datetime * (qint64)1000).toLocalTime().toString();
-        case 3: return Settings::getInstance()->getUSDFormat(modeldata->at(index.row()).amount);
+        case 2: return QDateTime::fromMSecsSinceEpoch(modeldata->datetime(row) * (qint64)1000).toLocalTime().toString();
+        case 3: return Settings::getInstance()->getUSDFormat(modeldata->amount(row));
         }    
     }
 
     if (role == Qt::DecorationRole && index.column() == 0) {
-        if (!dat.memo.isEmpty()) {
+        if (modeldata->hasMemo(row)) {
             // If the memo is a Payment URI, then show a payment request icon
-            if (dat.memo.startsWith("thc:")) {
+            if (modeldata->memo(row).startsWith("thc:")) {
                 QIcon icon(":/icons/res/paymentreq.gif");
                 return QVariant(icon.pixmap(16, 16));
             } else {
@@ -199,29 +285,29 @@ void TxTableModel::updateAllData() {
  }
 
 QString TxTableModel::getTxId(int row) const {
-    return modeldata->at(row).txid;
+    return modeldata->txid(row);
 }
 
 QString TxTableModel::getMemo(int row) const {
-    return modeldata->at(row).memo;
+    return modeldata->memo(row).toString();
 }
 
 qint64 TxTableModel::getConfirmations(int row) const {
-    return modeldata->at(row).confirmations;
+    return modeldata->confirmations(row);
 }
 
 QString TxTableModel::getAddr(int row) const {
-    return modeldata->at(row).address.trimmed();
+    return modeldata->address(row).trimmed();
 }
 
 qint64 TxTableModel::getDate(int row) const {
-    return modeldata->at(row).datetime;
+    return modeldata->datetime(row);
 }
 
 QString TxTableModel::getType(int row) const {
-    return modeldata->at(row).type;
+    return modeldata->typeName(row);
 }
 
 QString TxTableModel::getAmt(int row) const {
-    return Settings::getDecimalString(modeldata->at(row).amount);
+    return Settings::getDecimalString(modeldata->amount(row));
 }
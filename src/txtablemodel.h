@@ -2,8 +2,8 @@
 #define STRINGSTABLEMODEL_H
 
 #include "precompiled.h"
-
-struct TransactionItem;
+#include "txstore.h"
+#include "walletdiff.h"
 
 class TxTableModel: public QAbstractTableModel
 {
@@ -15,6 +15,11 @@ public:
     void addZSentData(const QList<TransactionItem>& data);
     void addZRecvData(const QList<TransactionItem>& data);     
 
+    // Update from the deltas of a new wallet snapshot. A list that had transactions added or removed
+    // is reloaded, otherwise only the confirmation counts are changed in place. If the model isn't
+    // showing the snapshot the deltas start from, every loaded list is reloaded instead.
+    void applyChanges(const WalletChangeSet& changes);
+
     QString  getTxId(int row) const;
     QString  getMemo(int row) const;
     QString  getAddr(int row) const;
@@ -23,7 +28,15 @@ public:
     qint64   getConfirmations(int row) const;
     QString  getAmt (int row) const;
 
-    bool     exportToCsv(QString fileName) const;
+    QList<TransactionItem> getShieldedRows() const;
+
+    // The rows from each source, as they were last set
+    QList<TransactionItem> getTRows() const;
+    QList<TransactionItem> getZSentRows() const;
+    QList<TransactionItem> getZRecvRows() const;
+
+    // Stale data is the saved state from the last run, shown greyed out until the node is up
+    void     setStale(bool s);
 
     int      rowCount(const QModelIndex &parent) const;
     int      columnCount(const QModelIndex &parent) const;
@@ -33,13 +46,22 @@ public:
 private:
     void updateAllData();
 
-    QList<TransactionItem>*  tTrans      = nullptr;
-    QList<TransactionItem>*  zrTrans     = nullptr;     // Z received
-    QList<TransactionItem>*  zsTrans     = nullptr;     // Z sent
+    TxStore*& source(WalletTxList list);
 
-    QList<TransactionItem>* modeldata    = nullptr;
+    TxStore*                 tTrans      = nullptr;
+    TxStore*                 zrTrans     = nullptr;     // Z received
+    TxStore*                 zsTrans     = nullptr;     // Z sent
+
+    TxStore*                 modeldata   = nullptr;
+
+    // The snapshot the lists were last loaded or updated from, and which lists came from the snapshots at
+    // all. A list that was set directly (eg. the saved state) is kept until the snapshots have it.
+    WalletSnapshotPtr        synced;
+    bool                     live[3]     = {};
 
     QList<QString>           headers;
+
+    bool                     stale       = false;
 };
 
 
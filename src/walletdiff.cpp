@@ -0,0 +1,209 @@
+#include "walletdiff.h"
+#include "trace.h"
+
+WalletDiff* WalletDiff::instance = nullptr;
+
+WalletDiff* WalletDiff::getInstance() {
+    if (instance == nullptr)
+        instance = new WalletDiff();
+
+    return instance;
+}
+
+WalletDiff::WalletDiff() {
+    qRegisterMetaType<WalletChangeSet>("WalletChangeSet");
+
+    auto snapshots = WalletSnapshots::getInstance();
+    previous = snapshots->current();
+
+    // Snapshots are published on the UI thread, so this runs right away, before update() returns
+    QObject::connect(snapshots, &WalletSnapshots::published, this, &WalletDiff::onPublished);
+}
+
+void WalletDiff::onPublished(WalletSnapshotPtr snapshot) {
+    auto changes = compute(previous, snapshot);
+    previous = snapshot;
+
+    emit changed(changes);
+}
+
+bool WalletChangeSet::has(WalletDelta::Type type) const {
+    for (const auto& d : deltas) {
+        if (d.type == type)
+            return true;
+    }
+    return false;
+}
+
+bool WalletChangeSet::has(WalletDelta::Type type, WalletTxList list) const {
+    for (const auto& d : deltas) {
+        if (d.type == type && d.list == list)
+            return true;
+    }
+    return false;
+}
+
+namespace {
+
+void diffAddresses(const QList<QString>& from, const QList<QString>& to, QList<WalletDelta>& out) {
+    if (from.isSharedWith(to))
+        return;
+
+    QSet<QString> known;
+    known.reserve(from.size());
+    for (const auto& addr : from)
+        known.insert(addr);
+
+    QSet<QString> current;
+    current.reserve(to.size());
+    for (const auto& addr : to) {
+        current.insert(addr);
+        if (!known.contains(addr)) {
+            WalletDelta d;
+            d.type      = WalletDelta::AddressAdded;
+            d.address   = addr;
+            out.push_back(d);
+        }
+    }
+
+    for (const auto& addr : from) {
+        if (!current.contains(addr)) {
+            WalletDelta d;
+            d.type      = WalletDelta::AddressRemoved;
+            d.address   = addr;
+            out.push_back(d);
+        }
+    }
+}
+
+void diffBalances(const AddressMap<Amount>& from, const AddressMap<Amount>& to, QList<WalletDelta>& out) {
+    if (from.isSharedWith(to))
+        return;
+
+    // Both maps are keyed by AddressId, so this only hashes integers
+    for (auto it = to.constBegin(); it != to.constEnd(); ++it) {
+        auto old = from.value(it.id());
+        if (old != it.value()) {
+            WalletDelta d;
+            d.type      = WalletDelta::BalanceChanged;
+            d.address   = it.key();
+            d.oldAmount = old;
+            d.newAmount = it.value();
+            out.push_back(d);
+        }
+    }
+
+    for (auto it = from.constBegin(); it != from.constEnd(); ++it) {
+        if (!to.contains(it.id())) {
+            WalletDelta d;
+            d.type      = WalletDelta::BalanceChanged;
+            d.address   = it.key();
+            d.oldAmount = it.value();
+            out.push_back(d);
+        }
+    }
+}
+
+void diffUtxos(const QList<UnspentOutput>& from, const QList<UnspentOutput>& to, QList<WalletDelta>& out) {
+    if (from.isSharedWith(to))
+        return;
+
+    // Only the unconfirmed outputs can become confirmed, and there are only ever a few of those
+    auto key = [] (const UnspentOutput& u) {
+        return u.txid % QLatin1Char('|') % QString::number(u.vout) % QLatin1Char('|') % u.address;
+    };
+
+    QSet<QString> unconfirmed;
+    for (const auto& u : from) {
+        if (u.confirmations == 0)
+            unconfirmed.insert(key(u));
+    }
+    if (unconfirmed.isEmpty())
+        return;
+
+    for (const auto& u : to) {
+        if (u.confirmations > 0 && unconfirmed.contains(key(u))) {
+            WalletDelta d;
+            d.type      = WalletDelta::UtxoConfirmed;
+            d.address   = u.address;
+            d.txid      = u.txid;
+            d.vout      = u.vout;
+            d.newAmount = u.amount;
+            out.push_back(d);
+        }
+    }
+}
+
+// The same txid shows up once per output, or once per address, type and amount where the list doesn't
+// say which output, eg. a send to two addresses
+QString txKey(const TransactionItem& tx) {
+    return tx.txid % QLatin1Char('|') % QString::number(tx.vout) % QLatin1Char('|') % tx.address %
+           QLatin1Char('|') % tx.type % QLatin1Char('|') % QString::number(tx.amount.toZats());
+}
+
+WalletDelta txDelta(WalletDelta::Type type, WalletTxList list, const TransactionItem& tx) {
+    WalletDelta d;
+    d.type              = type;
+    d.list              = list;
+    d.address           = tx.address;
+    d.txid              = tx.txid;
+    d.vout              = tx.vout;
+    d.txType            = tx.type;
+    d.newAmount         = tx.amount;
+    d.newConfirmations  = tx.confirmations;
+    d.datetime          = tx.datetime;
+    return d;
+}
+
+void diffTxs(WalletTxList list, const QList<TransactionItem>& from, const QList<TransactionItem>& to,
+             QList<WalletDelta>& out) {
+    if (from.isSharedWith(to))
+        return;
+
+    QHash<QString, int> old;
+    old.reserve(from.size());
+    for (int i = 0; i < from.size(); i++)
+        old.insert(txKey(from.at(i)), i);
+
+    QSet<QString> seen;
+    seen.reserve(to.size());
+    for (const auto& tx : to) {
+        auto key = txKey(tx);
+        seen.insert(key);
+
+        auto it = old.constFind(key);
+        if (it == old.constEnd()) {
+            out.push_back(txDelta(WalletDelta::TxInserted, list, tx));
+        } else if (from.at(it.value()).confirmations != tx.confirmations) {
+            auto d = txDelta(WalletDelta::ConfirmationsAdvanced, list, tx);
+            d.oldConfirmations = from.at(it.value()).confirmations;
+            out.push_back(d);
+        }
+    }
+
+    for (auto it = old.constBegin(); it != old.constEnd(); ++it) {
+        if (!seen.contains(it.key()))
+            out.push_back(txDelta(WalletDelta::TxRemoved, list, from.at(it.value())));
+    }
+}
+
+}
+
+WalletChangeSet WalletDiff::compute(const WalletSnapshotPtr& from, const WalletSnapshotPtr& to) {
+    TraceSpan span("WalletDiff::compute", "model");
+
+    WalletChangeSet changes;
+    changes.from = from;
+    changes.to   = to;
+
+    diffAddresses(from->zaddresses, to->zaddresses, changes.deltas);
+    diffAddresses(from->taddresses, to->taddresses, changes.deltas);
+    diffBalances (from->balances,   to->balances,   changes.deltas);
+    diffUtxos    (from->utxos,      to->utxos,      changes.deltas);
+
+    for (auto list : { WalletTxList::Transparent, WalletTxList::ZSent, WalletTxList::ZReceived })
+        diffTxs(list, from->txs(list), to->txs(list), changes.deltas);
+
+    span.arg("deltas", changes.deltas.size());
+    return changes;
+}
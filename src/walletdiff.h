@@ -0,0 +1,72 @@
+#ifndef WALLETDIFF_H
+#define WALLETDIFF_H
+
+#include "precompiled.h"
+#include "walletsnapshot.h"
+
+// One change between two consecutive wallet snapshots
+struct WalletDelta {
+    enum Type {
+        AddressAdded,           // address
+        AddressRemoved,         // address
+        BalanceChanged,         // address, oldAmount -> newAmount. A balance that went away changes to 0.
+        UtxoConfirmed,          // address, txid, vout, newAmount
+        TxInserted,             // list, address, txid, vout, newAmount, newConfirmations, datetime
+        TxRemoved,              // list, address, txid, vout, newAmount, datetime
+        ConfirmationsAdvanced   // list, address, txid, vout, oldConfirmations -> newConfirmations, datetime
+    };
+
+    Type            type;
+    QString         address;
+    QString         txid;
+    int             vout                = -1;
+    QString         txType;
+    WalletTxList    list                = WalletTxList::Transparent;
+    Amount          oldAmount;
+    Amount          newAmount;
+    qint64          oldConfirmations    = 0;
+    qint64          newConfirmations    = 0;
+    qint64          datetime            = 0;    // The tx's own time, secs since epoch
+};
+
+struct WalletChangeSet {
+    WalletSnapshotPtr   from;
+    WalletSnapshotPtr   to;
+    QList<WalletDelta>  deltas;
+
+    bool isEmpty() const    { return deltas.isEmpty(); }
+    bool has(WalletDelta::Type type) const;
+    bool has(WalletDelta::Type type, WalletTxList list) const;
+};
+
+Q_DECLARE_METATYPE(WalletChangeSet)
+
+/**
+ * Turns each newly published snapshot into the list of what changed since the one before it.
+ *
+ * Subscribers to changed() get typed deltas, so they can update just the affected rows instead of
+ * reloading everything on every refresh. The parts of a snapshot that weren't touched are still
+ * shared with the previous one, and those are skipped without being compared.
+ */
+class WalletDiff : public QObject
+{
+    Q_OBJECT
+public:
+    static WalletDiff* getInstance();
+
+    static WalletChangeSet compute(const WalletSnapshotPtr& from, const WalletSnapshotPtr& to);
+
+signals:
+    void changed(const WalletChangeSet& changes);
+
+private:
+    WalletDiff();
+
+    void onPublished(WalletSnapshotPtr snapshot);
+
+    WalletSnapshotPtr       previous;
+
+    static WalletDiff*      instance;
+};
+
+#endif // WALLETDIFF_H
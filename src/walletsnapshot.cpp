@@ -0,0 +1,38 @@
+#include "walletsnapshot.h"
+#include "settings.h"
+
+WalletSnapshots* WalletSnapshots::instance = nullptr;
+
+WalletSnapshots* WalletSnapshots::getInstance() {
+    if (instance == nullptr)
+        instance = new WalletSnapshots();
+
+    return instance;
+}
+
+WalletSnapshots::WalletSnapshots() {
+    qRegisterMetaType<WalletSnapshotPtr>("WalletSnapshotPtr");
+
+    snapshot = std::make_shared<const WalletSnapshot>();
+}
+
+WalletSnapshotPtr WalletSnapshots::current() const {
+    return std::atomic_load(&snapshot);
+}
+
+WalletSnapshotPtr WalletSnapshots::update(const std::function<void(WalletSnapshot&)>& change) {
+    // There is only one writer, so nothing can be published between the load and the store
+    auto prev = current();
+    auto next = std::make_shared<WalletSnapshot>(*prev);
+    change(*next);
+
+    // The change may have started over from an empty snapshot, so the version is taken from before it
+    next->version     = prev->version + 1;
+    next->blockNumber = Settings::getInstance()->getBlockNumber();
+
+    WalletSnapshotPtr ptr = next;
+    std::atomic_store(&snapshot, ptr);
+
+    emit published(ptr);
+    return ptr;
+}
@@ -0,0 +1,119 @@
+#ifndef WALLETSNAPSHOT_H
+#define WALLETSNAPSHOT_H
+
+#include "precompiled.h"
+#include "addressregistry.h"
+#include "amount.h"
+
+struct UnspentOutput {
+    QString address;
+    QString txid;
+    Amount  amount;
+    int     confirmations;
+    bool    spendable;
+    int     vout            = -1;   // Index of the output in its tx
+};
+
+struct TransactionItem {
+    QString         type;
+    qint64            datetime;
+    QString         address;
+    QString         txid;
+    Amount          amount;
+    unsigned long   confirmations;
+    QString         fromAddr;
+    QString         memo;
+    int             vout        = -1;   // The output this row is for, -1 if it isn't about a single output
+};
+
+// The separate lists of transactions the wallet tracks, one per RPC source
+enum class WalletTxList : quint8 {
+    Transparent = 0,
+    ZSent,
+    ZReceived
+};
+
+/**
+ * One consistent view of the wallet's addresses, balances, UTXOs and transactions.
+ *
+ * A snapshot is never changed after it is published. Each refresh builds a new one from the
+ * previous one (the Qt containers are implicitly shared, so the parts that didn't change are not
+ * copied) and publishes it in one atomic pointer swap. Readers keep the shared_ptr they got for as
+ * long as they need it, and see all the parts from the same refresh, on any thread.
+ */
+struct WalletSnapshot {
+    quint64                 version         = 0;
+    int                     blockNumber     = 0;
+
+    Amount                  balT;
+    Amount                  balZ;
+
+    AddressMap<Amount>      balances;
+    QList<UnspentOutput>    utxos;
+    int                     utxosBlock      = 0;    // The block number when the UTXOs were fetched
+    QList<QString>          zaddresses;
+    QList<QString>          taddresses;
+
+    QList<TransactionItem>  tTxs;
+    QList<TransactionItem>  zSentTxs;
+    QList<TransactionItem>  zRecvTxs;
+
+    // The parts come in from separate RPC calls, so each one says whether it has been loaded yet
+    bool                    hasBalances     = false;
+    bool                    hasZAddresses   = false;
+    bool                    hasTAddresses   = false;
+    bool                    hasTTxs         = false;
+    bool                    hasZSentTxs     = false;
+    bool                    hasZRecvTxs     = false;
+
+    const QList<TransactionItem>& txs(WalletTxList list) const {
+        switch (list) {
+        case WalletTxList::ZSent:       return zSentTxs;
+        case WalletTxList::ZReceived:   return zRecvTxs;
+        default:                        return tTxs;
+        }
+    }
+
+    bool hasTxs(WalletTxList list) const {
+        switch (list) {
+        case WalletTxList::ZSent:       return hasZSentTxs;
+        case WalletTxList::ZReceived:   return hasZRecvTxs;
+        default:                        return hasTTxs;
+        }
+    }
+};
+
+typedef std::shared_ptr<const WalletSnapshot> WalletSnapshotPtr;
+
+Q_DECLARE_METATYPE(WalletSnapshotPtr)
+
+/**
+ * Publishes the current WalletSnapshot.
+ *
+ * current() can be called from any thread and never blocks. update() is only called from the UI
+ * thread, where all the RPC replies are handled, so there is a single writer.
+ */
+class WalletSnapshots : public QObject
+{
+    Q_OBJECT
+public:
+    static WalletSnapshots* getInstance();
+
+    WalletSnapshotPtr current() const;
+    quint64           version() const   { return current()->version; }
+
+    // Make the next snapshot from a copy of the current one, and publish it
+    WalletSnapshotPtr update(const std::function<void(WalletSnapshot&)>& change);
+
+signals:
+    void published(WalletSnapshotPtr snapshot);
+
+private:
+    WalletSnapshots();
+
+    WalletSnapshotPtr           snapshot;
+
+    static WalletSnapshots*     instance;
+};
+
+#endif // WALLETSNAPSHOT_H
@@ -0,0 +1,179 @@
+#include "walletstate.h"
+#include "recordlog.h"
+
+// These have to be outside the anonymous namespace, so the QList stream operators can find them
+static QDataStream& operator<<(QDataStream& ds, const TransactionItem& t) {
+    return ds << t.type << t.datetime << t.address << t.txid << t.amount.toZats()
+              << (quint64)t.confirmations << t.fromAddr << t.memo << (qint32)t.vout;
+}
+
+static QDataStream& operator>>(QDataStream& ds, TransactionItem& t) {
+    qint64  zats;
+    quint64 confirmations;
+    qint32  vout;
+    ds >> t.type >> t.datetime >> t.address >> t.txid >> zats >> confirmations >> t.fromAddr >> t.memo >> vout;
+    t.amount        = Amount::fromZats(zats);
+    t.confirmations = (unsigned long)confirmations;
+    t.vout          = vout;
+    return ds;
+}
+
+static QDataStream& operator<<(QDataStream& ds, const UnspentOutput& u) {
+    return ds << u.address << u.txid << u.amount.toZats() << (qint32)u.confirmations << u.spendable << (qint32)u.vout;
+}
+
+static QDataStream& operator>>(QDataStream& ds, UnspentOutput& u) {
+    qint64 zats;
+    qint32 confirmations, vout;
+    ds >> u.address >> u.txid >> zats >> confirmations >> u.spendable >> vout;
+    u.amount        = Amount::fromZats(zats);
+    u.confirmations = confirmations;
+    u.vout          = vout;
+    return ds;
+}
+
+namespace {
+
+const quint32 Magic = 0x48505753;     // "HPWS"
+
+// Saves come at most every few seconds, but don't let two of them write the temp file at once, or one
+// write a file that was just removed
+QMutex  writeMutex;
+quint64 generation = 0;
+
+/**
+ * Writes the serialized state to a temp file and swaps it in, so a crash never leaves half a file.
+ */
+class WalletStateWriter : public QRunnable {
+public:
+    WalletStateWriter(QString name, QByteArray bytes, quint64 gen) : fileName(name), data(bytes), startedAt(gen) {}
+
+    void run() override {
+        QMutexLocker locker(&writeMutex);
+        if (startedAt != generation)
+            return;
+
+        QString tmp = fileName % ".tmp";
+        QFile   out(tmp);
+        bool ok = out.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+                  out.write(data) == data.size() &&
+                  RecordLog::syncToDisk(out);
+        out.close();
+
+        if (!ok || !RecordLog::replaceFile(tmp, fileName)) {
+            qDebug() << "Couldn't save the wallet state to" << fileName;
+            QFile::remove(tmp);
+        }
+    }
+
+private:
+    QString     fileName;
+    QByteArray  data;
+    quint64     startedAt;
+};
+
+}
+
+QString WalletStateFile::fileName(bool testnet) {
+    auto dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    if (!dir.exists())
+        QDir().mkpath(dir.absolutePath());
+
+    return dir.filePath(testnet ? QStringLiteral("testnet-walletstate.snapshot") : QStringLiteral("walletstate.snapshot"));
+}
+
+void WalletStateFile::remove() {
+    QMutexLocker locker(&writeMutex);
+    generation++;
+
+    for (bool testnet : { false, true }) {
+        QFile::remove(fileName(testnet));
+        QFile::remove(fileName(testnet) % ".tmp");
+    }
+}
+
+void WalletStateFile::save(const WalletState& state) {
+    QByteArray  data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+
+    out << Magic << version;
+    out << (qint32)state.blockNumber << state.testnet << state.savedAt
+        << state.balT.toZats() << state.balZ.toZats();
+
+    out << (quint32)state.balances.size();
+    for (auto it = state.balances.constBegin(); it != state.balances.constEnd(); ++it) {
+        out << it.key() << it.value().toZats();
+    }
+
+    out << state.utxos << state.zaddresses << state.taddresses
+        << state.tTxs << state.zSentTxs << state.zRecvTxs;
+
+    quint64 gen;
+    {
+        QMutexLocker locker(&writeMutex);
+        gen = generation;
+    }
+
+    auto writer = new WalletStateWriter(fileName(state.testnet), data, gen);
+    writer->setAutoDelete(true);
+    QThreadPool::globalInstance()->start(writer);
+}
+
+bool WalletStateFile::load(WalletState& state) {
+    QFileInfo mainnet(fileName(false));
+    QFileInfo testnet(fileName(true));
+    if (!mainnet.exists() && !testnet.exists())
+        return false;
+
+    bool useTestnet = testnet.exists() && (!mainnet.exists() || testnet.lastModified() > mainnet.lastModified());
+    if (!load(fileName(useTestnet), state))
+        return false;
+
+    // A file that doesn't hold the network its name says is not trusted
+    return state.testnet == useTestnet;
+}
+
+bool WalletStateFile::load(const QString& fileName, WalletState& state) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 size   = file.size();
+    uchar* mapped = size > 0 ? file.map(0, size) : nullptr;
+    if (mapped == nullptr)
+        return false;
+
+    // Parse straight out of the mapping, without copying the file
+    QByteArray  raw = QByteArray::fromRawData((const char*)mapped, (int)size);
+    QDataStream in(raw);
+
+    quint32 magic, fileVersion;
+    in >> magic >> fileVersion;
+    if (magic != Magic || fileVersion != version) {
+        file.unmap(mapped);
+        return false;
+    }
+
+    qint32  blockNumber;
+    qint64  balT, balZ;
+    quint32 count;
+    in >> blockNumber >> state.testnet >> state.savedAt >> balT >> balZ >> count;
+    state.blockNumber = blockNumber;
+    state.balT        = Amount::fromZats(balT);
+    state.balZ        = Amount::fromZats(balZ);
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        QString addr;
+        qint64  zats;
+        in >> addr >> zats;
+        state.balances.insert(addr, Amount::fromZats(zats));
+    }
+
+    in >> state.utxos >> state.zaddresses >> state.taddresses
+       >> state.tTxs >> state.zSentTxs >> state.zRecvTxs;
+
+    bool ok = in.status() == QDataStream::Ok;
+    file.unmap(mapped);
+
+    return ok;
+}
@@ -0,0 +1,55 @@
+#ifndef WALLETSTATE_H
+#define WALLETSTATE_H
+
+#include "precompiled.h"
+#include "rpc.h"
+
+/**
+ * What the wallet knew about the node after its last refresh.
+ */
+struct WalletState {
+    int                     blockNumber     = 0;
+    bool                    testnet         = false;
+    qint64                  savedAt         = 0;        // Seconds since epoch
+
+    Amount                  balT;
+    Amount                  balZ;
+
+    AddressMap<Amount>      balances;
+    QList<UnspentOutput>    utxos;
+    QList<QString>          zaddresses;
+    QList<QString>          taddresses;
+
+    QList<TransactionItem>  tTxs;
+    QList<TransactionItem>  zSentTxs;
+    QList<TransactionItem>  zRecvTxs;
+};
+
+/**
+ * The last WalletState is saved after every refresh, so the next start can show it right away (marked
+ * as stale) instead of an empty window while the node starts up.
+ *
+ * Mainnet and testnet each have their own file. The file is read through a memory map. It is versioned,
+ * and a file with a different version is simply ignored, since the next refresh will write a new one anyway.
+ */
+class WalletStateFile
+{
+public:
+    // The network isn't known until we're connected, so this loads the state of whichever network was
+    // saved last. The caller has to check state.testnet once the network is known.
+    static bool     load(WalletState& state);
+
+    // The state is serialized right away, and written to disk on a worker thread
+    static void     save(const WalletState& state);
+
+    // Delete the saved state of both networks, including a save that hasn't been written yet
+    static void     remove();
+
+    static const quint32 version = 2;
+
+private:
+    static QString  fileName(bool testnet);
+    static bool     load(const QString& fileName, WalletState& state);
+};
+
+#endif // WALLETSTATE_H
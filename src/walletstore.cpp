@@ -0,0 +1,158 @@
+#include "walletstore.h"
+#include "settings.h"
+
+WalletTable::WalletTable(const QString& fileName) {
+    QList<QByteArray> records;
+    if (!log.open(fileName, &records)) {
+        qDebug() << "Couldn't open" << fileName;
+        return;
+    }
+
+    for (const auto& record : records) {
+        replay(record);
+    }
+}
+
+WalletTable::~WalletTable() {
+    batchDepth = 0;
+    commit();
+}
+
+// Each record is one commit: the number of changes, and then each change
+void WalletTable::replay(const QByteArray& record) {
+    QDataStream in(record);
+    quint32 count;
+    in >> count;
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        quint8      op;
+        QByteArray  key, value;
+        in >> op;
+
+        if (op == Put) {
+            in >> key >> value;
+            values.insert(key, value);
+        } else if (op == Remove) {
+            in >> key;
+            values.remove(key);
+        } else if (op == Clear) {
+            values.clear();
+        } else {
+            qDebug() << "Unknown table op" << op;
+            return;
+        }
+    }
+}
+
+void WalletTable::addOp(Op op, const QByteArray& key, const QByteArray& value) {
+    QDataStream out(&pending, QIODevice::WriteOnly | QIODevice::Append);
+    out << (quint8)op;
+    if (op == Put)
+        out << key << value;
+    else if (op == Remove)
+        out << key;
+
+    pendingOps++;
+
+    if (batchDepth == 0)
+        commit();
+}
+
+void WalletTable::put(const QByteArray& key, const QByteArray& v) {
+    values.insert(key, v);
+    addOp(Put, key, v);
+}
+
+void WalletTable::remove(const QByteArray& key) {
+    if (values.remove(key) > 0)
+        addOp(Remove, key, QByteArray());
+}
+
+void WalletTable::clear() {
+    values.clear();
+
+    // Nothing before a clear matters anymore
+    pending.clear();
+    pendingOps = 0;
+    addOp(Clear, QByteArray(), QByteArray());
+}
+
+bool WalletTable::commit() {
+    if (batchDepth > 0)
+        batchDepth--;
+    if (batchDepth > 0 || pendingOps == 0)
+        return true;
+
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out << (quint32)pendingOps;
+    record.append(pending);
+
+    bool ok = log.append(record);
+
+    pending.clear();
+    pendingOps = 0;
+
+    compactIfNeeded();
+    return ok;
+}
+
+// Rewrite the log with one record per live key, once most of it is overwritten values
+void WalletTable::compactIfNeeded() {
+    if (log.isCompacting() || log.recordCount() <= 2 * values.size() + 64)
+        return;
+
+    QList<QByteArray> records;
+    records.reserve(values.size());
+    for (auto it = values.constBegin(); it != values.constEnd(); it++) {
+        QByteArray record;
+        QDataStream out(&record, QIODevice::WriteOnly);
+        out << (quint32)1 << (quint8)Put << it.key() << it.value();
+        records.push_back(record);
+    }
+
+    log.compact(records);
+}
+
+//=============
+// WalletStore singleton class
+//=============
+WalletStore* WalletStore::instance = nullptr;
+
+WalletStore* WalletStore::getInstance() {
+    if (instance == nullptr)
+        instance = new WalletStore();
+
+    return instance;
+}
+
+WalletTable* WalletStore::table(const QString& name) {
+    auto fileName = writeableFile(name % ".db");
+
+    auto t = tables.value(fileName);
+    if (t == nullptr) {
+        t = new WalletTable(fileName);
+        tables.insert(fileName, t);
+    }
+
+    return t;
+}
+
+void WalletStore::sync() {
+    for (auto t : tables) {
+        t->sync();
+    }
+}
+
+/// Get the location of the app data file to be written. 
+QString WalletStore::writeableFile(const QString& filename) {
+    auto dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    if (!dir.exists())
+        QDir().mkpath(dir.absolutePath());
+
+    if (Settings::getInstance()->isTestnet()) {
+        return dir.filePath("testnet-" % filename);
+    } else {
+        return dir.filePath(filename);
+    }
+}
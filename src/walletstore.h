@@ -0,0 +1,84 @@
+#ifndef WALLETSTORE_H
+#define WALLETSTORE_H
+
+#include "precompiled.h"
+#include "recordlog.h"
+
+/**
+ * A key/value table kept in memory and persisted in a RecordLog.
+ *
+ * Every change is applied in memory right away. On disk, the changes made between beginBatch() and
+ * commit() go out as a single checksummed record, so after a crash either all of them are there or
+ * none are. Outside of a batch, every change is its own commit. The log is compacted in the background
+ * once it is mostly overwritten values.
+ */
+class WalletTable
+{
+public:
+    explicit WalletTable(const QString& fileName);
+    ~WalletTable();
+
+    bool        isOpen() const                          { return log.isOpen(); }
+
+    bool        contains(const QByteArray& key) const   { return values.contains(key); }
+    QByteArray  value(const QByteArray& key) const      { return values.value(key); }
+    int         size() const                            { return values.size(); }
+
+    const QHash<QByteArray, QByteArray>& all() const    { return values; }
+
+    void        put(const QByteArray& key, const QByteArray& value);
+    void        remove(const QByteArray& key);
+    void        clear();
+
+    // Batches can be nested, the outermost commit() writes them out. False if that write failed.
+    void        beginBatch()                            { batchDepth++; }
+    bool        commit();
+
+    // Force the committed changes to disk now
+    bool        sync()                                  { return log.sync(); }
+
+private:
+    enum Op : quint8 {
+        Put     = 1,
+        Remove  = 2,
+        Clear   = 3
+    };
+
+    void        addOp(Op op, const QByteArray& key, const QByteArray& value);
+    void        replay(const QByteArray& record);
+    void        compactIfNeeded();
+
+    RecordLog                       log;
+    QHash<QByteArray, QByteArray>   values;
+
+    int                             batchDepth  = 0;
+    int                             pendingOps  = 0;
+    QByteArray                      pending;
+};
+
+/**
+ * All the files the wallet keeps next to the node's data. Each table is stored separately for mainnet
+ * and testnet, and the one for the network we're on is opened the first time it's used.
+ */
+class WalletStore
+{
+public:
+    static WalletStore* getInstance();
+
+    WalletTable*    table(const QString& name);
+
+    // Write out everything that is still waiting for the sync timer. Called before exiting.
+    void            sync();
+
+    // Location of an app data file for the current network
+    static QString  writeableFile(const QString& filename);
+
+private:
+    WalletStore() = default;
+
+    QHash<QString, WalletTable*>    tables;     // By file name
+
+    static WalletStore*             instance;
+};
+
+#endif // WALLETSTORE_H
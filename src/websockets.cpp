@@ -1,6 +1,8 @@
 #include "websockets.h"
 
 #include "rpc.h"
+#include "addresspool.h"
+#include "invoicestore.h"
 #include "settings.h"
 #include "ui_mobileappconnector.h"
 #include "version.h"
@@ -627,6 +629,12 @@ void AppDataServer::processDecryptedMessage(QString message, MainWindow* mainWin
     else if (msg.object()["command"] == "sendTx") {
         processSendTx(msg.object()["tx"].toObject(), mainWindow, pClient);
     }
+    else if (msg.object()["command"] == "getInvoices") {
+        processGetInvoices(pClient);
+    }
+    else if (msg.object()["command"] == "createInvoice") {
+        processCreateInvoice(msg.object(), mainWindow, pClient);
+    }
     else {
         auto r = QJsonDocument(QJsonObject{
             {"errorCode", -1},
@@ -657,19 +665,27 @@ void AppDataServer::processSendTx(QJsonObject sendTx, MainWindow* mainwindow, st
     Tx tx;
     tx.fee = Settings::getMinerFee();
 
+    bool ok = true;
+    Amount amt = Amount::fromString(sendTx["amount"].toString(), &ok);
+    if (!ok) {
+        error(QObject::tr("Amount '%1' is invalid!").arg(sendTx["amount"].toString()));
+        return;
+    }
+
     // Find a from address that has at least the sending amout
-    double amt = sendTx["amount"].toString().toDouble();
-    auto allBalances = mainwindow->getRPC()->getAllBalances();
-    QList<QPair<QString, double>> bals;
-    for (auto i : allBalances->keys()) {
-        // Filter out sprout addresses
-        if (Settings::getInstance()->isSproutAddress(i))
-            continue;
+    auto snapshot = mainwindow->getRPC()->getSnapshot();
+    const auto* allBalances = &snapshot->balances;
+    QList<QPair<QString, Amount>> bals;
+    for (auto it = allBalances->constBegin(); it != allBalances->constEnd(); ++it) {
         // Filter out balances that don't have the requisite amount
-        if (allBalances->value(i) < amt)
+        if (it.value() < amt)
+            continue;
+        // Filter out sprout addresses
+        QString addr = it.key();
+        if (Settings::getInstance()->isSproutAddress(addr))
             continue;
 
-        bals.append(QPair<QString, double>(i, allBalances->value(i)));
+        bals.append(QPair<QString, Amount>(addr, it.value()));
     }
 
     if (bals.isEmpty()) {
@@ -677,7 +693,7 @@ void AppDataServer::processSendTx(QJsonObject sendTx, MainWindow* mainwindow, st
         return;
     }
 
-    std::sort(bals.begin(), bals.end(), [=](const QPair<QString, double>a, const QPair<QString, double> b) -> bool {
+    std::sort(bals.begin(), bals.end(), [=](const QPair<QString, Amount>a, const QPair<QString, Amount> b) -> bool {
         // Sort z addresses first
         return a.first > b.first;
     });
@@ -732,24 +748,25 @@ void AppDataServer::processSendTx(QJsonObject sendTx, MainWindow* mainwindow, st
 void AppDataServer::processGetInfo(QJsonObject jobj, MainWindow* mainWindow, std::shared_ptr<ClientWebSocket> pClient) {
     auto connectedName = jobj["name"].toString();
     
-    if (mainWindow == nullptr || mainWindow->getRPC() == nullptr ||
-            mainWindow->getRPC()->getAllBalances() == nullptr) {
+    // Everything below comes from this one snapshot, so the balances all agree with each other
+    auto snapshot = (mainWindow == nullptr || mainWindow->getRPC() == nullptr) ? 
+                        WalletSnapshotPtr() : mainWindow->getRPC()->getSnapshot();
+    if (snapshot == nullptr || !snapshot->hasBalances) {
         pClient->close(QWebSocketProtocol::CloseCodeNormal, "Not yet ready");
         return;
     }
 
-
     // Max spendable safely from a z address and from any address
-    double maxZSpendable = 0;
-    double maxSpendable = 0;
-    for (auto a : mainWindow->getRPC()->getAllBalances()->keys()) {
-        if (Settings::getInstance()->isSaplingAddress(a)) {
-            if (mainWindow->getRPC()->getAllBalances()->value(a) > maxZSpendable) {
-                maxZSpendable = mainWindow->getRPC()->getAllBalances()->value(a);
+    Amount maxZSpendable;
+    Amount maxSpendable;
+    for (auto it = snapshot->balances.constBegin(); it != snapshot->balances.constEnd(); ++it) {
+        if (Settings::getInstance()->isSaplingAddress(it.key())) {
+            if (it.value() > maxZSpendable) {
+                maxZSpendable = it.value();
             }
         }
-        if (mainWindow->getRPC()->getAllBalances()->value(a) > maxSpendable) {
-            maxSpendable = mainWindow->getRPC()->getAllBalances()->value(a);
+        if (it.value() > maxSpendable) {
+            maxSpendable = it.value();
         }
     }
 
@@ -760,9 +777,9 @@ void AppDataServer::processGetInfo(QJsonObject jobj, MainWindow* mainWindow, std
         {"command", "getInfo"},
         {"saplingAddress", mainWindow->getRPC()->getDefaultSaplingAddress()},
         {"tAddress", mainWindow->getRPC()->getDefaultTAddress()},
-        {"balance", AppDataModel::getInstance()->getTotalBalance()},
-        {"maxspendable", maxSpendable},
-        {"maxzspendable", maxZSpendable},
+        {"balance", (snapshot->balT + snapshot->balZ).toDouble()},
+        {"maxspendable", maxSpendable.toDouble()},
+        {"maxzspendable", maxZSpendable.toDouble()},
         {"tokenName", Settings::getTokenName()},
         {"zecprice", Settings::getInstance()->getZECPrice()},
         {"serverversion", QString(APP_VERSION)}
@@ -809,6 +826,80 @@ void AppDataServer::processGetTransactions(MainWindow* mainWindow, std::shared_p
     pClient->sendTextMessage(encryptOutgoing(r));
 }
 
+namespace {
+    QJsonObject invoiceJson(const Invoice& inv) {
+        return QJsonObject{
+            {"id", inv.id},
+            {"address", inv.address},
+            {"uri", inv.paymentURI()},
+            {"amount", Settings::getDecimalString(inv.amount)},
+            {"received", Settings::getDecimalString(inv.received())},
+            {"state", (int)inv.state},
+            {"status", InvoiceStore::stateName(inv.state)},
+            {"created", inv.created},
+            {"expires", inv.expires},
+            {"memo", inv.description},
+            {"label", inv.label},
+            {"confirmations", inv.minConfirmations}
+        };
+    }
+}
+
+// "getInvoices" command
+void AppDataServer::processGetInvoices(std::shared_ptr<ClientWebSocket> pClient) {
+    QJsonArray invoices;
+    for (const auto& inv : InvoiceStore::getInstance()->getAll())
+        invoices.append(invoiceJson(inv));
+
+    auto r = QJsonDocument(QJsonObject{
+            {"version", 1.0},
+            {"command", "getInvoices"},
+            {"invoices", invoices}
+        }).toJson();
+    pClient->sendTextMessage(encryptOutgoing(r));
+}
+
+// "createInvoice" command. The invoice gets a fresh address from the pool, so this answers right away
+// unless the pool has run dry.
+void AppDataServer::processCreateInvoice(QJsonObject jobj, MainWindow* mainWindow, std::shared_ptr<ClientWebSocket> pClient) {
+    bool ok = true;
+    Amount amount = jobj["amount"].toString().isEmpty() ? Amount() : Amount::fromString(jobj["amount"].toString(), &ok);
+    bool validAmount = ok && !amount.isNegative();
+    if (!validAmount || mainWindow->getRPC()->getConnection() == nullptr) {
+        auto r = QJsonDocument(QJsonObject{
+            {"errorCode", -1},
+            {"errorMessage", "Couldn't create invoice:" + QString(validAmount ? "Not connected" : "Invalid amount")}
+        }).toJson();
+        pClient->sendTextMessage(encryptOutgoing(r));
+        return;
+    }
+
+    qint64  expiresIn     = (qint64)jobj["expiresIn"].toDouble();
+    QString memo          = jobj["memo"].toString();
+    QString label         = jobj["label"].toString();
+    int     confirmations = jobj["confirmations"].toInt(InvoiceStore::defaultConfirmations);
+
+    mainWindow->getRPC()->getAddressPool()->take(AddressPool::Sapling, [=] (QString addr) {
+        if (addr.isEmpty()) {
+            auto r = QJsonDocument(QJsonObject{
+                {"errorCode", -1},
+                {"errorMessage", "Couldn't create invoice:Couldn't create a new address"}
+            }).toJson();
+            pClient->sendTextMessage(encryptOutgoing(r));
+            return;
+        }
+
+        auto inv = InvoiceStore::getInstance()->create(addr, amount, expiresIn, memo, label, confirmations);
+
+        auto r = QJsonDocument(QJsonObject{
+                {"version", 1.0},
+                {"command", "createInvoice"},
+                {"invoice", invoiceJson(inv)}
+            }).toJson();
+        pClient->sendTextMessage(encryptOutgoing(r));
+    });
+}
+
 // ==============================
 // AppDataModel
 // ==============================
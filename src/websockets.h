@@ -104,6 +104,8 @@ public:
     void          processGetInfo(QJsonObject jobj, MainWindow* mainWindow, std::shared_ptr<ClientWebSocket> pClient);
     void          processDecryptedMessage(QString message, MainWindow* mainWindow, std::shared_ptr<ClientWebSocket> pClient);
     void          processGetTransactions(MainWindow* mainWindow, std::shared_ptr<ClientWebSocket> pClient);
+    void          processGetInvoices(std::shared_ptr<ClientWebSocket> pClient);
+    void          processCreateInvoice(QJsonObject jobj, MainWindow* mainWindow, std::shared_ptr<ClientWebSocket> pClient);
 
     QString       decryptMessage(QJsonDocument msg, QString secretHex, QString lastRemoteNonceHex);
     QString       encryptOutgoing(QString msg);
@@ -151,11 +153,11 @@ public:
         return instance;
     }
 
-    double getTBalance()     { return balTransparent;  }
-    double getZBalance()     { return balShielded; }
-    double getTotalBalance() { return balTotal; }
+    Amount getTBalance()     { return balTransparent;  }
+    Amount getZBalance()     { return balShielded; }
+    Amount getTotalBalance() { return balTotal; }
 
-    void   setBalances(double transparent, double shielded) {
+    void   setBalances(Amount transparent, Amount shielded) {
         balTransparent = transparent;
         balShielded = shielded;
         balTotal = balTransparent + balShielded;
@@ -164,9 +166,9 @@ public:
 private:
     AppDataModel() = default;   // Private, for singleton
 
-    double balTransparent;
-    double balShielded;
-    double balTotal;
+    Amount balTransparent;
+    Amount balShielded;
+    Amount balTotal;
 
     QString saplingAddress;
 